@@ -26,14 +26,34 @@ extern "C" {
 #define STARTREF_MIN      1
 #define STARTREF_MAX      65536
 #define NUMOFVALUES_MIN   1
-#define NUMOFVALUES_MAX   125
-#define POLLRATE_MIN      100
+#define NUMOFVALUES_MAX   STARTREF_MAX
+#define POLLRATE_MIN      1
 #define TIMEOUT_MIN       0.01
 #define TIMEOUT_MAX       10.0
 #define TCP_PORT_MIN      1
 #define TCP_PORT_MAX      65535
 #define RTU_BAUDRATE_MIN  1200
 #define RTU_BAUDRATE_MAX  921600
+#define WORKERS_MIN       1
+#define WORKERS_MAX       64
+#define PIPELINE_MIN      1
+#define PIPELINE_MAX      32
+#define COALESCE_GAP_MIN  0
+#define COALESCE_GAP_MAX  125
+#define EVERY_MIN         1
+#define EVERY_MAX         100000
+#define DOWN_AFTER_MIN    1
+#define DOWN_AFTER_MAX    1000
+#define DOWN_BACKOFF_MAX  64
+#define RECONNECT_DELAY_MIN 100
+#define RECONNECT_DELAY_MAX 10000
+#define REPORT_PERIOD_MIN 1
+#define REPORT_PERIOD_MAX 86400
+#define QUEUE_SIZE_MIN    2
+#define QUEUE_SIZE_MAX    4096
+#define BUS_MAX           WORKERS_MAX
+#define RTU_GAP_MIN       1
+#define RTU_GAP_MAX       100
 #define CHIPIO_SLAVEADDR_MIN 0x03
 #define CHIPIO_SLAVEADDR_MAX 0x77
 
@@ -45,11 +65,15 @@ extern "C" {
 #define DEFAULT_NUMOFVALUES   1
 #define DEFAULT_POLLRATE      1000
 #define DEFAULT_TIMEOUT       1.0
+#define DEFAULT_RTO_MIN       0.02
 #define DEFAULT_TCP_PORT      "502"
+#define DEFAULT_WORKERS       1
+#define DEFAULT_COALESCE_GAP  10
 #define DEFAULT_RTU_BAUDRATE  19200
 #define DEFAULT_RTU_DATABITS  SERIAL_DATABIT_8
 #define DEFAULT_RTU_STOPBITS  SERIAL_STOPBIT_ONE
 #define DEFAULT_RTU_PARITY    SERIAL_PARITY_EVEN
+#define DEFAULT_RTU_GAP       4
 #define DEFAULT_CHIPIO_SLAVEADDR  0x46
 #define DEFAULT_CHIPIO_IRQPIN     GPIO_GEN6
 
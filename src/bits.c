@@ -0,0 +1,161 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "bits.h"
+
+/* macros =================================================================== */
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+// Lecture de n bits (n <= 8) à partir du rang iBit, sans déborder du tableau
+static uint8_t
+ucBitsFetch (const uint8_t * pucSrc, int iBit, int n) {
+  int s = iBit & 7;
+  unsigned v;
+
+  pucSrc += iBit >> 3;
+  v = pucSrc[0] >> s;
+  if (s + n > 8) {
+
+    v |= pucSrc[1] << (8 - s);
+  }
+  return v & ( (1U << n) - 1);
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture de n bits (n <= 8 - iBit % 8) dans un seul octet
+static void
+vBitsStore (uint8_t * pucDst, int iBit, uint8_t v, int n) {
+  int d = iBit & 7;
+  unsigned m = ( (1U << n) - 1) << d;
+
+  pucDst += iBit >> 3;
+  *pucDst = (*pucDst & ~m) | ( (v << d) & m);
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vBitsCopy (uint8_t * pucDst, int iDstBit,
+           const uint8_t * pucSrc, int iSrcBit, int iCount) {
+
+  if ( ( (iDstBit | iSrcBit) & 7) == 0) {
+    int iBytes = iCount / 8;
+
+    // cas le plus fréquent, les deux plages commencent sur un octet
+    memcpy (pucDst + iDstBit / 8, pucSrc + iSrcBit / 8, iBytes);
+    iDstBit += iBytes * 8;
+    iSrcBit += iBytes * 8;
+    iCount -= iBytes * 8;
+  }
+
+  while (iCount > 0) {
+    int n = MIN (8 - (iDstBit & 7), iCount);
+
+    vBitsStore (pucDst, iDstBit, ucBitsFetch (pucSrc, iSrcBit, n), n);
+    iDstBit += n;
+    iSrcBit += n;
+    iCount -= n;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vBitsPack (uint8_t * pucDst, int iDstBit,
+           const uint8_t * pucSrc, int iCount) {
+
+  while (iCount > 0) {
+    int i, n = MIN (8 - (iDstBit & 7), iCount);
+    uint8_t v = 0;
+
+    for (i = 0; i < n; i++) {
+
+      v |= (pucSrc[i] != 0) << i;
+    }
+    vBitsStore (pucDst, iDstBit, v, n);
+    pucSrc += n;
+    iDstBit += n;
+    iCount -= n;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vBitsUnpack (uint8_t * pucDst,
+             const uint8_t * pucSrc, int iSrcBit, int iCount) {
+  int i;
+
+  for (i = 0; i < iCount; i++) {
+
+    pucDst[i] = bBitsGet (pucSrc, iSrcBit + i);
+  }
+}
+
+// -----------------------------------------------------------------------------
+uint16_t
+usBitsWord (const uint8_t * pucBits, int iBit, int iCount) {
+  uint16_t usWord = ucBitsFetch (pucBits, iBit, MIN (iCount, 8));
+
+  if (iCount > 8) {
+
+    usWord |= ucBitsFetch (pucBits, iBit + 8, iCount - 8) << 8;
+  }
+  return usWord;
+}
+
+// -----------------------------------------------------------------------------
+int
+iBitsDiff (const uint8_t * pucA, const uint8_t * pucB, int iCount) {
+  int i = 0;
+
+  // recherche rapide du premier bloc de 64 bits différent
+  for (; i + 64 <= iCount; i += 64) {
+    uint64_t a, b;
+
+    memcpy (&a, pucA + i / 8, sizeof (a));
+    memcpy (&b, pucB + i / 8, sizeof (b));
+    if (a != b) {
+      break;
+    }
+  }
+
+  // puis du premier bit différent, octet par octet
+  for (; i < iCount; i += 8) {
+    unsigned x = pucA[i / 8] ^ pucB[i / 8];
+
+    if (iCount - i < 8) {
+
+      x &= (1U << (iCount - i)) - 1;
+    }
+    if (x) {
+      int j = 0;
+
+      while ( (x & 1) == 0) {
+        x >>= 1;
+        j++;
+      }
+      return i + j;
+    }
+  }
+  return -1;
+}
+
+/* ========================================================================== */
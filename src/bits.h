@@ -0,0 +1,93 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_BITS_H_
+#define _MBPOLL_BITS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Tableaux de bits compactés, dans l'ordre des trames ModBus : le bit de
+ * rang i est le bit (i % 8) de l'octet i / 8, le poids faible en premier.
+ */
+
+/* macros =================================================================== */
+/**
+ * Nombre d'octets nécessaires pour stocker n bits
+ */
+#define BITS_SIZE(n) (((n) + 7) / 8)
+
+/* internal public functions ================================================ */
+
+/**
+ * Lecture du bit de rang iBit
+ */
+static inline bool
+bBitsGet (const uint8_t * pucBits, int iBit) {
+
+  return (pucBits[iBit >> 3] >> (iBit & 7)) & 1;
+}
+
+/**
+ * Modification du bit de rang iBit
+ */
+static inline void
+vBitsSet (uint8_t * pucBits, int iBit, bool bValue) {
+
+  if (bValue) {
+    pucBits[iBit >> 3] |= 1 << (iBit & 7);
+  }
+  else {
+    pucBits[iBit >> 3] &= ~ (1 << (iBit & 7));
+  }
+}
+
+/**
+ * Copie de iCount bits d'un tableau compacté vers un autre
+ *
+ * Les bits de destination situés hors de la plage copiée ne sont pas
+ * modifiés.
+ */
+void vBitsCopy (uint8_t * pucDst, int iDstBit,
+                const uint8_t * pucSrc, int iSrcBit, int iCount);
+
+/**
+ * Compactage de iCount bits stockés un par octet (format libmodbus)
+ */
+void vBitsPack (uint8_t * pucDst, int iDstBit,
+                const uint8_t * pucSrc, int iCount);
+
+/**
+ * Décompactage de iCount bits, un par octet (format libmodbus)
+ */
+void vBitsUnpack (uint8_t * pucDst,
+                  const uint8_t * pucSrc, int iSrcBit, int iCount);
+
+/**
+ * Extraction d'au plus 16 bits consécutifs dans un mot, le bit de rang
+ * iBit devient le bit de poids faible
+ */
+uint16_t usBitsWord (const uint8_t * pucBits, int iBit, int iCount);
+
+/**
+ * Comparaison de deux tableaux de iCount bits, 64 bits à la fois
+ *
+ * @return le rang du premier bit différent, -1 si les tableaux sont égaux
+ */
+int iBitsDiff (const uint8_t * pucA, const uint8_t * pucB, int iCount);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_BITS_H_ */
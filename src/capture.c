@@ -0,0 +1,611 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include "capture.h"
+#include "outbuf.h"
+#include "bits.h"
+
+/* constants ================================================================ */
+// signature et version du format
+static const char sMagic[] = "MBPCAP";
+#define CAPTURE_VERSION 1
+
+// taille du tampon de lecture
+#define CAPTURE_CHUNK 65536
+
+// nombre d'octets maximal d'un varint de 64 bits
+#define VARINT_MAX 10
+
+// bornes de l'entête, protègent des fichiers corrompus
+#define CAPTURE_LIST_MAX 65536
+#define CAPTURE_DEVICE_MAX 4096
+
+/* structures =============================================================== */
+struct xCapture {
+  FILE * xFile;
+  bool bIsWriting;
+  xOutBuf xOut; // enregistrements pas encore écrits
+  uint8_t * pucIn; // tampon de lecture
+  size_t ulInPos;
+  size_t ulInLen;
+  int iElemBits;
+  int iBlockSize;
+  size_t ulBlockBytes;
+  int iRefCount;
+  uint8_t * pucLast; // dernier bloc réussi de chaque esclave et référence
+  int iCycle; // numéro du dernier cycle
+  uint64_t ullTime; // dernière heure enregistrée, en µs
+};
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static void
+vPutVarint (xOutBuf * b, uint64_t v) {
+  uint8_t * p = (uint8_t *) pcOutBufReserve (b, VARINT_MAX);
+  size_t n = 0;
+
+  if (p) {
+
+    while (v >= 0x80) {
+      p[n++] = (uint8_t) v | 0x80;
+      v >>= 7;
+    }
+    p[n++] = (uint8_t) v;
+    vOutBufCommit (b, n);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Les entiers signés sont codés en zigzag : 0, -1, 1, -2... donnent 0, 1, 2,
+// 3... pour que les petits écarts négatifs tiennent dans peu d'octets
+static inline uint64_t
+ullZigzag (int64_t v) {
+
+  return ( (uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+// -----------------------------------------------------------------------------
+static inline int64_t
+llUnzigzag (uint64_t v) {
+
+  return (int64_t) (v >> 1) ^ - (int64_t) (v & 1);
+}
+
+// -----------------------------------------------------------------------------
+// Remplissage du tampon de lecture s'il est vide
+// @return le nombre d'octets disponibles, 0 à la fin du fichier ou si erreur
+static size_t
+ulFill (xCapture * x) {
+
+  if (x->ulInPos == x->ulInLen) {
+
+    x->ulInLen = fread (x->pucIn, 1, CAPTURE_CHUNK, x->xFile);
+    x->ulInPos = 0;
+  }
+  return x->ulInLen - x->ulInPos;
+}
+
+// -----------------------------------------------------------------------------
+// Lecture d'un varint, une fin de fichier est une erreur
+static int
+iGetVarint (xCapture * x, uint64_t * pullValue) {
+  uint64_t v = 0;
+  int iShift;
+
+  for (iShift = 0; iShift < VARINT_MAX * 7; iShift += 7) {
+    uint8_t c;
+
+    if (ulFill (x) == 0) {
+      break;
+    }
+    c = x->pucIn[x->ulInPos++];
+    v |= (uint64_t) (c & 0x7F) << iShift;
+    if ( (c & 0x80) == 0) {
+
+      *pullValue = v;
+      return 0;
+    }
+  }
+  // fichier tronqué ou corrompu, sauf erreur de lecture
+  if (!ferror (x->xFile)) {
+    errno = EINVAL;
+  }
+  return -1;
+}
+
+// -----------------------------------------------------------------------------
+// Lecture d'un entier de l'entête compris entre iMin et iMax
+static int
+iGetInt (xCapture * x, int * piValue, int iMin, int iMax) {
+  uint64_t v;
+
+  if (iGetVarint (x, &v) != 0) {
+    return -1;
+  }
+  if ( (v < (uint64_t) iMin) || (v > (uint64_t) iMax)) {
+
+    errno = EINVAL;
+    return -1;
+  }
+  *piValue = (int) v;
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+static int *
+piGetIntList (xCapture * x, int iCount, int iMin, int iMax) {
+  int i, * piList = malloc (iCount * sizeof (int));
+
+  if (piList == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < iCount; i++) {
+
+    if (iGetInt (x, &piList[i], iMin, iMax) != 0) {
+
+      free (piList);
+      return NULL;
+    }
+  }
+  return piList;
+}
+
+// -----------------------------------------------------------------------------
+// Allocation de la capture et des blocs de référence
+static xCapture *
+xCaptureNew (const xCaptureHeader * h) {
+  xCapture * x;
+  size_t ulBlocks;
+
+  // bornes de la lecture de l'entête, le produit tient dans un size_t
+  if ( (h->iSlaveCount < 0) || (h->iSlaveCount > CAPTURE_LIST_MAX) ||
+       (h->iRefCount < 0) || (h->iRefCount > CAPTURE_LIST_MAX) ||
+       (h->iBlockSize < 0) || (h->iBlockSize > CAPTURE_LIST_MAX)) {
+
+    errno = EINVAL;
+    return NULL;
+  }
+  ulBlocks = (size_t) h->iSlaveCount * (size_t) h->iRefCount;
+  x = calloc (1, sizeof (xCapture));
+  if (x == NULL) {
+    return NULL;
+  }
+  x->iElemBits = h->iElemBits;
+  x->iBlockSize = h->iBlockSize;
+  x->ulBlockBytes = BITS_SIZE (h->iBlockSize * h->iElemBits);
+  x->iRefCount = h->iRefCount;
+  x->iCycle = -1;
+  x->ullTime = h->ullStartTime;
+  // les blocs de référence partent de zéro, comme les blocs de mbpoll
+  x->pucLast = calloc (ulBlocks, x->ulBlockBytes);
+  if ( (x->pucLast == NULL) && (ulBlocks > 0)) {
+
+    free (x);
+    return NULL;
+  }
+  vOutBufInit (&x->xOut);
+  return x;
+}
+
+// -----------------------------------------------------------------------------
+static void
+vCaptureDelete (xCapture * x) {
+
+  if (x->xFile) {
+    fclose (x->xFile);
+  }
+  vOutBufFree (&x->xOut);
+  free (x->pucIn);
+  free (x->pucLast);
+  free (x);
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+xCapture *
+xCaptureCreate (const char * sPath, const xCaptureHeader * h) {
+  xCapture * x = xCaptureNew (h);
+  size_t ulLen = strlen (h->sDevice);
+  int i;
+
+  if (x == NULL) {
+    return NULL;
+  }
+  x->bIsWriting = true;
+  x->xFile = fopen (sPath, "wb");
+  if (x->xFile == NULL) {
+
+    vCaptureDelete (x);
+    return NULL;
+  }
+
+  vOutBufWrite (&x->xOut, sMagic, sizeof (sMagic) - 1);
+  vPutVarint (&x->xOut, CAPTURE_VERSION);
+  vPutVarint (&x->xOut, h->iMode);
+  vPutVarint (&x->xOut, h->iFunction);
+  vPutVarint (&x->xOut, h->iFormat);
+  vPutVarint (&x->xOut, h->iOrder);
+  vPutVarint (&x->xOut, h->iPduOffset);
+  vPutVarint (&x->xOut, h->iPollRate);
+  vPutVarint (&x->xOut, h->iElemBits);
+  vPutVarint (&x->xOut, h->iBlockSize);
+  vPutVarint (&x->xOut, h->iCount);
+  vPutVarint (&x->xOut, h->iRefCount);
+  for (i = 0; i < h->iRefCount; i++) {
+
+    vPutVarint (&x->xOut, h->piRef[i]);
+    vPutVarint (&x->xOut, h->piEvery ? h->piEvery[i] : 1);
+  }
+  vPutVarint (&x->xOut, h->iSlaveCount);
+  for (i = 0; i < h->iSlaveCount; i++) {
+
+    vPutVarint (&x->xOut, h->piSlave[i]);
+  }
+  vPutVarint (&x->xOut, ulLen);
+  vOutBufWrite (&x->xOut, h->sDevice, ulLen);
+  vPutVarint (&x->xOut, h->ullStartTime);
+
+  if (iCaptureFlush (x) != 0) {
+    int iError = errno;
+
+    vCaptureDelete (x);
+    errno = iError;
+    return NULL;
+  }
+  return x;
+}
+
+// -----------------------------------------------------------------------------
+void
+vCaptureCycle (xCapture * x, int iCycle) {
+
+  vPutVarint (&x->xOut, iCycle - x->iCycle);
+  x->iCycle = iCycle;
+}
+
+// -----------------------------------------------------------------------------
+void
+vCaptureSlave (xCapture * x, bool bIsPolled, uint64_t ullTime) {
+
+  vPutVarint (&x->xOut, bIsPolled);
+  if (bIsPolled) {
+
+    vPutVarint (&x->xOut, ullZigzag ( (int64_t) (ullTime - x->ullTime)));
+    x->ullTime = ullTime;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vCaptureBlock (xCapture * x, int iSlave, int iRef, int iError,
+               const void * pvBlock) {
+  uint8_t * pucLast = x->pucLast +
+                      ( (size_t) iSlave * x->iRefCount + iRef) * x->ulBlockBytes;
+  int i, n, iRun = 0;
+
+  vPutVarint (&x->xOut, (unsigned) iError);
+  if (iError) {
+    return;
+  }
+
+  if (memcmp (pvBlock, pucLast, x->ulBlockBytes) == 0) {
+
+    // cas le plus fréquent, rien n'a changé
+    vPutVarint (&x->xOut, (x->iElemBits == 1) ?
+                x->ulBlockBytes : (size_t) x->iBlockSize);
+    return;
+  }
+
+  if (x->iElemBits == 1) {
+    const uint8_t * pucNew = (const uint8_t *) pvBlock;
+
+    n = x->ulBlockBytes;
+    for (i = 0; i < n; i++) {
+      uint8_t ucDiff = pucNew[i] ^ pucLast[i];
+
+      if (ucDiff == 0) {
+
+        iRun++;
+        continue;
+      }
+      vPutVarint (&x->xOut, iRun);
+      vPutVarint (&x->xOut, ucDiff);
+      iRun = 0;
+    }
+  }
+  else {
+    const uint16_t * pusNew = (const uint16_t *) pvBlock;
+    const uint16_t * pusLast = (const uint16_t *) pucLast;
+
+    n = x->iBlockSize;
+    for (i = 0; i < n; i++) {
+      int16_t sDiff = (int16_t) (pusNew[i] - pusLast[i]);
+
+      if (sDiff == 0) {
+
+        iRun++;
+        continue;
+      }
+      vPutVarint (&x->xOut, iRun);
+      vPutVarint (&x->xOut, ullZigzag (sDiff));
+      iRun = 0;
+    }
+  }
+  if (iRun) {
+
+    vPutVarint (&x->xOut, iRun);
+  }
+  memcpy (pucLast, pvBlock, x->ulBlockBytes);
+}
+
+// -----------------------------------------------------------------------------
+int
+iCaptureFlush (xCapture * x) {
+
+  return iOutBufFlush (&x->xOut, fileno (x->xFile));
+}
+
+// -----------------------------------------------------------------------------
+xCapture *
+xCaptureOpen (const char * sPath, xCaptureHeader * h) {
+  FILE * xFile = fopen (sPath, "rb");
+  char sSign[sizeof (sMagic) - 1];
+  xCaptureHeader xHdr;
+  xCapture * x = NULL;
+  uint64_t ullLen = 0;
+  int i, iVersion = 0;
+
+  if (xFile == NULL) {
+    return NULL;
+  }
+  if ( (fread (sSign, 1, sizeof (sSign), xFile) != sizeof (sSign)) ||
+       (memcmp (sSign, sMagic, sizeof (sSign)) != 0)) {
+
+    fclose (xFile);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  // l'entête est lue avec une capture provisoire, sans blocs de référence
+  memset (&xHdr, 0, sizeof (xHdr));
+  x = xCaptureNew (&xHdr);
+  if (x == NULL) {
+
+    fclose (xFile);
+    return NULL;
+  }
+  x->xFile = xFile;
+  x->pucIn = malloc (CAPTURE_CHUNK);
+  if ( (x->pucIn == NULL) ||
+       (iGetInt (x, &iVersion, CAPTURE_VERSION, CAPTURE_VERSION) != 0) ||
+       (iGetInt (x, &xHdr.iMode, 0, 255) != 0) ||
+       (iGetInt (x, &xHdr.iFunction, 0, 255) != 0) ||
+       (iGetInt (x, &xHdr.iFormat, 0, 255) != 0) ||
+       (iGetInt (x, &xHdr.iOrder, 0, 255) != 0) ||
+       (iGetInt (x, &xHdr.iPduOffset, 0, 1) != 0) ||
+       (iGetInt (x, &xHdr.iPollRate, 0, 0x7FFFFFFF) != 0) ||
+       (iGetInt (x, &xHdr.iElemBits, 1, 16) != 0) ||
+       (iGetInt (x, &xHdr.iBlockSize, 1, CAPTURE_LIST_MAX) != 0) ||
+       (iGetInt (x, &xHdr.iCount, 1, CAPTURE_LIST_MAX) != 0) ||
+       (iGetInt (x, &xHdr.iRefCount, 1, CAPTURE_LIST_MAX) != 0)) {
+
+    goto error;
+  }
+  if ( (xHdr.iElemBits != 1) && (xHdr.iElemBits != 16)) {
+
+    errno = EINVAL;
+    goto error;
+  }
+
+  xHdr.piRef = malloc (xHdr.iRefCount * sizeof (int));
+  xHdr.piEvery = malloc (xHdr.iRefCount * sizeof (int));
+  if ( (xHdr.piRef == NULL) || (xHdr.piEvery == NULL)) {
+    goto error;
+  }
+  for (i = 0; i < xHdr.iRefCount; i++) {
+
+    if ( (iGetInt (x, &xHdr.piRef[i], 0, 0xFFFF + 1) != 0) ||
+         (iGetInt (x, &xHdr.piEvery[i], 1, 0x7FFFFFFF) != 0)) {
+      goto error;
+    }
+  }
+  if (iGetInt (x, &xHdr.iSlaveCount, 1, CAPTURE_LIST_MAX) != 0) {
+    goto error;
+  }
+  xHdr.piSlave = piGetIntList (x, xHdr.iSlaveCount, 0, 255);
+  if ( (xHdr.piSlave == NULL) || (iGetVarint (x, &ullLen) != 0)) {
+    goto error;
+  }
+  if (ullLen > CAPTURE_DEVICE_MAX) {
+
+    errno = EINVAL;
+    goto error;
+  }
+  xHdr.sDevice = malloc (ullLen + 1);
+  if (xHdr.sDevice == NULL) {
+    goto error;
+  }
+  for (i = 0; i < (int) ullLen; i++) {
+
+    if (ulFill (x) == 0) {
+
+      errno = ferror (xFile) ? errno : EINVAL;
+      goto error;
+    }
+    xHdr.sDevice[i] = x->pucIn[x->ulInPos++];
+  }
+  xHdr.sDevice[ullLen] = 0;
+  if (iGetVarint (x, &xHdr.ullStartTime) != 0) {
+    goto error;
+  }
+
+  {
+    // la capture définitive reprend le fichier et le tampon de lecture
+    xCapture * xNew = xCaptureNew (&xHdr);
+
+    if (xNew == NULL) {
+      goto error;
+    }
+    xNew->xFile = x->xFile;
+    xNew->pucIn = x->pucIn;
+    xNew->ulInPos = x->ulInPos;
+    xNew->ulInLen = x->ulInLen;
+    x->xFile = NULL;
+    x->pucIn = NULL;
+    vCaptureDelete (x);
+    *h = xHdr;
+    return xNew;
+  }
+
+error: {
+    int iError = errno;
+
+    free (xHdr.piRef);
+    free (xHdr.piEvery);
+    free (xHdr.piSlave);
+    free (xHdr.sDevice);
+    vCaptureDelete (x);
+    errno = iError;
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+int
+iCaptureReadCycle (xCapture * x, int * piCycle) {
+  uint64_t v;
+
+  if (ulFill (x) == 0) {
+
+    // fin normale, entre deux cycles
+    return ferror (x->xFile) ? -1 : 0;
+  }
+  if (iGetVarint (x, &v) != 0) {
+    return -1;
+  }
+  if ( (v == 0) || (v > (uint64_t) (0x7FFFFFFF - x->iCycle))) {
+
+    errno = EINVAL;
+    return -1;
+  }
+  x->iCycle += (int) v;
+  *piCycle = x->iCycle;
+  return 1;
+}
+
+// -----------------------------------------------------------------------------
+int
+iCaptureReadSlave (xCapture * x, bool * pbIsPolled, uint64_t * pullTime) {
+  uint64_t v;
+
+  if (iGetVarint (x, &v) != 0) {
+    return -1;
+  }
+  *pbIsPolled = (v != 0);
+  if (*pbIsPolled) {
+
+    if (iGetVarint (x, &v) != 0) {
+      return -1;
+    }
+    x->ullTime += (uint64_t) llUnzigzag (v);
+    *pullTime = x->ullTime;
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int
+iCaptureReadBlock (xCapture * x, int iSlave, int iRef, int * piError,
+                   void * pvBlock) {
+  uint8_t * pucLast = x->pucLast +
+                      ( (size_t) iSlave * x->iRefCount + iRef) * x->ulBlockBytes;
+  int n = (x->iElemBits == 1) ? (int) x->ulBlockBytes : x->iBlockSize;
+  int i = 0;
+  uint64_t v;
+
+  if (iGetVarint (x, &v) != 0) {
+    return -1;
+  }
+  *piError = (int) v;
+  if (*piError) {
+    return 0;
+  }
+
+  while (i < n) {
+
+    // éléments inchangés
+    if (iGetVarint (x, &v) != 0) {
+      return -1;
+    }
+    if (v > (uint64_t) (n - i)) {
+
+      errno = EINVAL;
+      return -1;
+    }
+    i += (int) v;
+    if (i == n) {
+      break;
+    }
+
+    // élément modifié
+    if (iGetVarint (x, &v) != 0) {
+      return -1;
+    }
+    if (x->iElemBits == 1) {
+
+      pucLast[i] ^= (uint8_t) v;
+    }
+    else {
+      uint16_t * pusLast = (uint16_t *) pucLast;
+
+      pusLast[i] += (uint16_t) llUnzigzag (v);
+    }
+    i++;
+  }
+  memcpy (pvBlock, pucLast, x->ulBlockBytes);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int
+iCaptureClose (xCapture * x) {
+  int iRet = 0, iError = 0;
+
+  if (x) {
+
+    if (x->bIsWriting) {
+
+      iRet = iCaptureFlush (x);
+      iError = errno;
+    }
+    if ( (fclose (x->xFile) != 0) && (iRet == 0)) {
+
+      iRet = -1;
+      iError = errno;
+    }
+    x->xFile = NULL;
+    vCaptureDelete (x);
+    errno = iError;
+  }
+  return iRet;
+}
+
+/* ========================================================================== */
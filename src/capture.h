@@ -0,0 +1,161 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_CAPTURE_H_
+#define _MBPOLL_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Fichier de capture binaire
+ *
+ * Le fichier commence par une entête qui décrit la scrutation (plan,
+ * esclaves, format), suivie d'un enregistrement par cycle. Tous les entiers
+ * sont codés en varint (7 bits par octet, poids faibles en premier).
+ *
+ * Cycle : écart avec le numéro du cycle précédent, puis pour chaque esclave :
+ *  - 0 s'il n'a pas été scruté, 1 sinon suivi de l'écart en µs (zigzag) entre
+ *    son heure de scrutation et l'heure précédente du fichier,
+ *  - pour chaque référence de départ à échéance : le code d'erreur, puis si
+ *    la lecture a réussi, le bloc codé par rapport au dernier bloc réussi de
+ *    la même référence.
+ * Un bloc est une suite de paires (nombre d'éléments inchangés, écart du
+ * premier élément modifié) : différence en zigzag pour les registres, ou
+ * exclusif des octets pour les bits compactés. Un bloc inchangé tient donc
+ * dans un seul octet.
+ *
+ * La lecture et l'écriture se font dans le même ordre, c'est l'appelant qui
+ * sait quelles références sont à échéance à chaque cycle.
+ */
+
+/* structures =============================================================== */
+/**
+ * Capture ouverte en écriture ou en lecture (opaque)
+ */
+typedef struct xCapture xCapture;
+
+/**
+ * Entête de capture
+ *
+ * Les champs iMode, iFunction, iFormat et iOrder contiennent les valeurs
+ * des énumérations de mbpoll, ils ne sont pas interprétés ici.
+ */
+typedef struct xCaptureHeader {
+  int iMode;
+  int iFunction;
+  int iFormat;
+  int iOrder;
+  int iPduOffset; /**< 1 si les références commencent à 1, 0 sinon */
+  int iPollRate; /**< période de scrutation en ms */
+  int iElemBits; /**< taille d'un élément en bits (1 ou 16) */
+  int iBlockSize; /**< nombre d'éléments d'un bloc */
+  int iCount; /**< nombre de valeurs d'un bloc */
+  int iRefCount; /**< nombre de références de départ */
+  int * piRef; /**< références de départ */
+  int * piEvery; /**< période de lecture de chaque référence, en cycles */
+  int iSlaveCount; /**< nombre d'esclaves */
+  int * piSlave; /**< adresses des esclaves */
+  char * sDevice; /**< hôte ou port série */
+  uint64_t ullStartTime; /**< début de la capture, en µs (UTC) */
+} xCaptureHeader;
+
+/* internal public functions ================================================ */
+
+/**
+ * Création d'un fichier de capture et écriture de son entête
+ *
+ * @return la capture, NULL si erreur (errno est positionné)
+ */
+xCapture * xCaptureCreate (const char * sPath, const xCaptureHeader * xHdr);
+
+/**
+ * Début de l'enregistrement d'un cycle
+ */
+void vCaptureCycle (xCapture * xCap, int iCycle);
+
+/**
+ * Enregistrement d'un esclave dans le cycle en cours
+ *
+ * @param bIsPolled faux si l'esclave n'a pas été scruté pendant ce cycle,
+ * il n'a alors pas de bloc
+ * @param ullTime heure de la scrutation, en µs (UTC)
+ */
+void vCaptureSlave (xCapture * xCap, bool bIsPolled, uint64_t ullTime);
+
+/**
+ * Enregistrement du résultat de la lecture d'une référence de départ
+ *
+ * @param iSlave rang de l'esclave dans la liste de l'entête
+ * @param iRef rang de la référence dans la liste de l'entête
+ * @param iError 0 si succès, errno sinon, pvBlock est alors ignoré
+ * @param pvBlock bloc lu : bits compactés ou registres de 16 bits
+ */
+void vCaptureBlock (xCapture * xCap, int iSlave, int iRef, int iError,
+                    const void * pvBlock);
+
+/**
+ * Ecriture dans le fichier de ce qui a été enregistré depuis le dernier
+ * appel, à faire à la fin de chaque cycle
+ *
+ * @return 0, -1 si erreur (errno est positionné)
+ */
+int iCaptureFlush (xCapture * xCap);
+
+/**
+ * Ouverture d'un fichier de capture et lecture de son entête
+ *
+ * Les tableaux et la chaîne de l'entête sont alloués par malloc(), leur
+ * libération est à la charge de l'appelant.
+ *
+ * @return la capture, NULL si erreur (errno est positionné, EINVAL si le
+ * fichier n'est pas une capture valide)
+ */
+xCapture * xCaptureOpen (const char * sPath, xCaptureHeader * xHdr);
+
+/**
+ * Lecture du début d'un cycle
+ *
+ * @return 1, 0 à la fin du fichier, -1 si erreur
+ */
+int iCaptureReadCycle (xCapture * xCap, int * piCycle);
+
+/**
+ * Lecture d'un esclave du cycle en cours
+ *
+ * @return 0, -1 si erreur
+ */
+int iCaptureReadSlave (xCapture * xCap, bool * pbIsPolled,
+                       uint64_t * pullTime);
+
+/**
+ * Lecture du résultat de la lecture d'une référence de départ
+ *
+ * pvBlock n'est modifié que si la lecture avait réussi.
+ *
+ * @return 0, -1 si erreur
+ */
+int iCaptureReadBlock (xCapture * xCap, int iSlave, int iRef, int * piError,
+                       void * pvBlock);
+
+/**
+ * Fermeture de la capture, le fichier est écrit s'il est ouvert en écriture
+ *
+ * @return 0, -1 si erreur (errno est positionné)
+ */
+int iCaptureClose (xCapture * xCap);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_CAPTURE_H_ */
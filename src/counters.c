@@ -0,0 +1,106 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <modbus.h>
+#include "counters.h"
+
+/* constants ================================================================ */
+// PDU de requête de lecture : fonction, adresse, nombre
+#define READ_REQUEST_PDU 5
+// PDU de réponse d'exception : fonction | 0x80, code
+#define EXCEPTION_PDU 2
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vCountersRecordRead (xCounters * c, int iFunction, int iCount,
+                     int iError, int iOverhead) {
+  // fonction, nombre d'octets, données
+  int iResponsePdu = 2 + ( ( (iFunction == 1) || (iFunction == 2)) ?
+                           (iCount + 7) / 8 : iCount * 2);
+
+  c->ullRequests++;
+  c->ullBytesOut += READ_REQUEST_PDU + iOverhead;
+
+  if (iError == 0) {
+
+    c->ullResponses++;
+    c->ullBytesIn += iResponsePdu + iOverhead;
+  }
+  else if ( (iError > MODBUS_ENOBASE) &&
+            (iError <= MODBUS_ENOBASE + COUNTERS_EXCEPTION_MAX)) {
+
+    c->ullExceptions[iError - MODBUS_ENOBASE]++;
+    c->ullBytesIn += EXCEPTION_PDU + iOverhead;
+  }
+  else if (iError == ETIMEDOUT) {
+
+    c->ullTimeouts++;
+  }
+  else if (iError == EMBBADCRC) {
+
+    // la trame a été reçue en entier, seul son contenu est faux
+    c->ullCrcErrors++;
+    c->ullBytesIn += iResponsePdu + iOverhead;
+  }
+  else {
+
+    c->ullOtherErrors++;
+  }
+}
+
+// -----------------------------------------------------------------------------
+double
+dCountersLineTime (const xCounters * c, long lBaudrate, double dCharBits) {
+  // trames reçues en entier, les timeouts et les autres erreurs sont exclus
+  uint64_t ullFrames = c->ullRequests + c->ullResponses + c->ullCrcErrors +
+                       ullCountersExceptions (c);
+  double dChars = (double) (c->ullBytesOut + c->ullBytesIn) + 3.5 * ullFrames;
+
+  return dChars * dCharBits / lBaudrate;
+}
+
+// -----------------------------------------------------------------------------
+void
+vCountersMerge (xCounters * d, const xCounters * s) {
+  int i;
+
+  d->ullRequests += s->ullRequests;
+  d->ullResponses += s->ullResponses;
+  for (i = 0; i <= COUNTERS_EXCEPTION_MAX; i++) {
+    d->ullExceptions[i] += s->ullExceptions[i];
+  }
+  d->ullTimeouts += s->ullTimeouts;
+  d->ullCrcErrors += s->ullCrcErrors;
+  d->ullOtherErrors += s->ullOtherErrors;
+  d->ullBytesOut += s->ullBytesOut;
+  d->ullBytesIn += s->ullBytesIn;
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullCountersExceptions (const xCounters * c) {
+  uint64_t n = 0;
+  int i;
+
+  for (i = 0; i <= COUNTERS_EXCEPTION_MAX; i++) {
+    n += c->ullExceptions[i];
+  }
+  return n;
+}
+
+/* ========================================================================== */
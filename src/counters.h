@@ -0,0 +1,91 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_COUNTERS_H_
+#define _MBPOLL_COUNTERS_H_
+
+#include <stdint.h>
+
+/* constants ================================================================ */
+/**
+ * Plus grand code d'exception ModBus (gateway target device failed to respond)
+ */
+#define COUNTERS_EXCEPTION_MAX 11
+
+/**
+ * Octets ajoutés au PDU par la trame : entête MBAP en TCP, adresse et CRC
+ * en RTU
+ */
+#define COUNTERS_TCP_OVERHEAD 7
+#define COUNTERS_RTU_OVERHEAD 3
+
+/* structures =============================================================== */
+/**
+ * Compteurs de transactions
+ *
+ * Chaque requête est comptée une seule fois, dans une seule des catégories
+ * de résultat. Les octets sont ceux des trames ModBus (ADU), calculés à
+ * partir de la taille des requêtes et des réponses attendues.
+ */
+typedef struct xCounters {
+  uint64_t ullRequests; /**< requêtes envoyées */
+  uint64_t ullResponses; /**< réponses avec données */
+  uint64_t ullExceptions[COUNTERS_EXCEPTION_MAX + 1]; /**< réponses d'exception, par code */
+  uint64_t ullTimeouts; /**< requêtes sans réponse */
+  uint64_t ullCrcErrors; /**< réponses avec un CRC erroné */
+  uint64_t ullOtherErrors; /**< autres erreurs (trame invalide, connexion...) */
+  uint64_t ullBytesOut; /**< octets envoyés */
+  uint64_t ullBytesIn; /**< octets reçus */
+} xCounters;
+
+/* internal public functions ================================================ */
+
+/**
+ * Enregistrement d'une requête de lecture
+ *
+ * @param iFunction code fonction ModBus (1 à 4)
+ * @param iCount nombre de bits ou de registres demandés
+ * @param iError 0 si succès, errno sinon (codes libmodbus)
+ * @param iOverhead octets de trame en plus du PDU
+ */
+void vCountersRecordRead (xCounters * xCnt, int iFunction, int iCount,
+                          int iError, int iOverhead);
+
+/**
+ * Durée d'occupation d'une liaison série par les trames comptées
+ *
+ * Chaque trame occupe la ligne le temps de ses caractères plus le silence
+ * de 3,5 caractères qui la termine (mode RTU). Les délais de réponse des
+ * esclaves et les requêtes restées sans réponse ne sont pas comptés.
+ *
+ * @param lBaudrate vitesse de la liaison en bauds
+ * @param dCharBits nombre de bits par caractère (start, données, parité, stop)
+ * @return la durée en secondes
+ */
+double dCountersLineTime (const xCounters * xCnt, long lBaudrate,
+                          double dCharBits);
+
+/**
+ * Ajout des compteurs xSrc à xDst
+ */
+void vCountersMerge (xCounters * xDst, const xCounters * xSrc);
+
+/**
+ * Nombre total de réponses d'exception
+ */
+uint64_t ullCountersExceptions (const xCounters * xCnt);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_COUNTERS_H_ */
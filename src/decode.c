@@ -0,0 +1,126 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include "decode.h"
+
+/*
+ * Les noyaux vectoriels supposent un hôte little endian, c'est le cas des
+ * processeurs x86 et des ARM en mode courant.
+ */
+#if defined (__SSE2__) || defined (_M_X64) || \
+    (defined (_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define DECODE_SSE2
+#elif defined (__ARM_NEON) && !defined (__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define DECODE_NEON
+#endif
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static bool
+bIsHostBigEndian (void) {
+  const uint16_t usOne = 1;
+
+  return * (const uint8_t *) &usOne == 0;
+}
+
+// -----------------------------------------------------------------------------
+static inline uint16_t
+usSwap16 (uint16_t w) {
+
+  return (uint16_t) ( (w << 8) | (w >> 8));
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vDecodeWords (uint16_t * w, int iCount, int iWords, eDecodeOrder eOrder) {
+  // l'hôte range le mot de poids faible en premier en little endian, les
+  // registres doivent être inversés si l'ordre de la trame est différent
+  bool bIsBigWords = (eOrder == eOrderAbcd) || (eOrder == eOrderBadc);
+  bool bReverse = (bIsBigWords != bIsHostBigEndian());
+  bool bSwapBytes = (eOrder == eOrderBadc) || (eOrder == eOrderDcba);
+  int i = 0, iTotal = iCount * iWords;
+
+  if (!bReverse && !bSwapBytes) {
+    return;
+  }
+
+#if defined (DECODE_SSE2)
+  for (; i + 8 <= iTotal; i += 8) {
+    __m128i x = _mm_loadu_si128 ( (const __m128i *) &w[i]);
+
+    if (bSwapBytes) {
+
+      x = _mm_or_si128 (_mm_slli_epi16 (x, 8), _mm_srli_epi16 (x, 8));
+    }
+    if (bReverse) {
+
+      if (iWords == 2) {
+
+        x = _mm_shufflelo_epi16 (x, _MM_SHUFFLE (2, 3, 0, 1));
+        x = _mm_shufflehi_epi16 (x, _MM_SHUFFLE (2, 3, 0, 1));
+      }
+      else {
+
+        x = _mm_shufflelo_epi16 (x, _MM_SHUFFLE (0, 1, 2, 3));
+        x = _mm_shufflehi_epi16 (x, _MM_SHUFFLE (0, 1, 2, 3));
+      }
+    }
+    _mm_storeu_si128 ( (__m128i *) &w[i], x);
+  }
+#elif defined (DECODE_NEON)
+  for (; i + 8 <= iTotal; i += 8) {
+    uint16x8_t x = vld1q_u16 (&w[i]);
+
+    if (bSwapBytes) {
+
+      x = vreinterpretq_u16_u8 (vrev16q_u8 (vreinterpretq_u8_u16 (x)));
+    }
+    if (bReverse) {
+
+      x = (iWords == 2) ? vrev32q_u16 (x) : vrev64q_u16 (x);
+    }
+    vst1q_u16 (&w[i], x);
+  }
+#endif
+
+  // reste du bloc, ou bloc entier sans instructions vectorielles
+  for (; i < iTotal; i += iWords) {
+    int j;
+
+    if (bSwapBytes) {
+
+      for (j = 0; j < iWords; j++) {
+        w[i + j] = usSwap16 (w[i + j]);
+      }
+    }
+    if (bReverse) {
+
+      for (j = 0; j < iWords / 2; j++) {
+        uint16_t t = w[i + j];
+
+        w[i + j] = w[i + iWords - 1 - j];
+        w[i + iWords - 1 - j] = t;
+      }
+    }
+  }
+}
+
+/* ========================================================================== */
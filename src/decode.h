@@ -0,0 +1,61 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_DECODE_H_
+#define _MBPOLL_DECODE_H_
+
+#include <stdint.h>
+
+/* constants ================================================================ */
+/**
+ * Ordre des octets d'une valeur de 32 ou 64 bits répartie sur plusieurs
+ * registres
+ *
+ * Les lettres donnent, dans l'ordre de la trame, la position des octets de
+ * la valeur, A étant l'octet de poids fort. Pour une valeur de 64 bits,
+ * l'ordre des mots s'applique aux 4 registres (ABCD : le premier registre
+ * est celui de poids fort).
+ */
+typedef enum {
+  eOrderAbcd, /**< mots et octets de poids fort en premier (big endian) */
+  eOrderCdab, /**< mot de poids faible en premier */
+  eOrderBadc, /**< mot de poids fort en premier, octets inversés */
+  eOrderDcba, /**< mots et octets de poids faible en premier (little endian) */
+  eOrderUnknown = -1,
+} eDecodeOrder;
+
+/* internal public functions ================================================ */
+
+/**
+ * Conversion en place d'un bloc de registres en valeurs de l'hôte
+ *
+ * Les registres sont des mots de 16 bits dans l'ordre de l'hôte, tels que
+ * lus par libmodbus. Après conversion, chaque groupe de iWords registres
+ * peut être lu comme un entier ou un flottant de 32 ou 64 bits de l'hôte.
+ * La conversion est sa propre inverse : appliquée à des valeurs de l'hôte,
+ * elle donne les registres à écrire.
+ * Le bloc est traité par 16 octets à la fois avec SSE2 ou NEON si
+ * disponibles.
+ *
+ * @param pusWords registres, iCount * iWords mots de 16 bits
+ * @param iCount nombre de valeurs
+ * @param iWords nombre de registres par valeur, 2 ou 4
+ * @param eOrder ordre des octets dans les registres
+ */
+void vDecodeWords (uint16_t * pusWords, int iCount, int iWords,
+                   eDecodeOrder eOrder);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_DECODE_H_ */
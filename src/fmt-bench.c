@@ -0,0 +1,270 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Mesure du nombre de valeurs converties par seconde pour chaque format de
+ * mbpoll, avec les fonctions de fmt.c et avec snprintf() et les formats
+ * utilisés auparavant.
+ *
+ * Ce programme n'est compilé qu'avec -DMBPOLL_BENCH=ON, il n'est pas
+ * installé.
+ * Usage: fmt-bench [durée par mesure en ms, 200 par défaut]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "fmt.h"
+#include "timing.h"
+
+/* constants ================================================================ */
+// Nombre de valeurs aléatoires converties à chaque passe
+#define BENCH_VALUES 4096
+#define BENCH_DEFAULT_MS 200
+
+/* structures =============================================================== */
+typedef union {
+  uint16_t usValue;
+  int32_t lValue;
+  uint32_t ulValue;
+  int64_t llValue;
+  float fValue;
+  double dValue;
+} xValue;
+
+typedef struct {
+  const char * sName; // nom du format pour l'option -t
+  void (*vFill) (xValue * v, uint64_t ullRand);
+  int (*iFmt) (char * pcDst, const xValue * v);
+  int (*iPrintf) (char * pcDst, const xValue * v);
+} xBench;
+
+/* private variables ======================================================== */
+static xValue xValues[BENCH_VALUES];
+// les résultats y sont cumulés pour que les conversions ne soient pas éliminées
+static volatile unsigned long ulSink;
+
+// -----------------------------------------------------------------------------
+// xorshift64*, suffisant pour répartir les valeurs sur toute leur plage
+static uint64_t
+ullRand (void) {
+  static uint64_t x = 0x9E3779B97F4A7C15ULL;
+
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+// -----------------------------------------------------------------------------
+static void
+vFill16 (xValue * v, uint64_t r) {
+  v->usValue = (uint16_t) r;
+}
+
+// -----------------------------------------------------------------------------
+static void
+vFill32 (xValue * v, uint64_t r) {
+  v->ulValue = (uint32_t) r;
+}
+
+// -----------------------------------------------------------------------------
+static void
+vFill64 (xValue * v, uint64_t r) {
+  v->llValue = (int64_t) r;
+}
+
+// -----------------------------------------------------------------------------
+// Motifs binaires quelconques, nan et inf exclus comme dans la sortie JSON
+static void
+vFillFloat (xValue * v, uint64_t r) {
+  uint32_t ul = (uint32_t) r;
+
+  memcpy (&v->fValue, &ul, sizeof (float));
+  if (!isfinite (v->fValue)) {
+    v->fValue = (float) (int32_t) ul;
+  }
+}
+
+// -----------------------------------------------------------------------------
+static void
+vFillDouble (xValue * v, uint64_t r) {
+
+  memcpy (&v->dValue, &r, sizeof (double));
+  if (!isfinite (v->dValue)) {
+    v->dValue = (double) (int64_t) r;
+  }
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtDec (char * d, const xValue * v) {
+  return iFmtU32 (d, v->usValue);
+}
+
+static int
+iPrintfDec (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%u", v->usValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtInt16 (char * d, const xValue * v) {
+  return iFmtI32 (d, (int16_t) v->usValue);
+}
+
+static int
+iPrintfInt16 (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%d", (int) (int16_t) v->usValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtHex (char * d, const xValue * v) {
+  return iFmtHex16 (d, v->usValue);
+}
+
+static int
+iPrintfHex (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "0x%04X", v->usValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtInt (char * d, const xValue * v) {
+  return iFmtI32 (d, v->lValue);
+}
+
+static int
+iPrintfInt (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%"PRId32, v->lValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtUInt32 (char * d, const xValue * v) {
+  return iFmtU32 (d, v->ulValue);
+}
+
+static int
+iPrintfUInt32 (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%"PRIu32, v->ulValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtInt64 (char * d, const xValue * v) {
+  return iFmtI64 (d, v->llValue);
+}
+
+static int
+iPrintfInt64 (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%"PRId64, v->llValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtFloatValue (char * d, const xValue * v) {
+  return iFmtFloat (d, v->fValue);
+}
+
+static int
+iPrintfFloat (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%.9g", v->fValue);
+}
+
+// -----------------------------------------------------------------------------
+static int
+iFmtDoubleValue (char * d, const xValue * v) {
+  return iFmtDouble (d, v->dValue);
+}
+
+static int
+iPrintfDouble (char * d, const xValue * v) {
+  return snprintf (d, FMT_MAX, "%.17g", v->dValue);
+}
+
+// -----------------------------------------------------------------------------
+// Les formats binaires (bin, mask) et string n'utilisent pas fmt.c
+static const xBench xBenchList[] = {
+  { "dec",    vFill16,     iFmtDec,         iPrintfDec },
+  { "int16",  vFill16,     iFmtInt16,       iPrintfInt16 },
+  { "hex",    vFill16,     iFmtHex,         iPrintfHex },
+  { "int",    vFill32,     iFmtInt,         iPrintfInt },
+  { "uint32", vFill32,     iFmtUInt32,      iPrintfUInt32 },
+  { "int64",  vFill64,     iFmtInt64,       iPrintfInt64 },
+  { "float",  vFillFloat,  iFmtFloatValue,  iPrintfFloat },
+  { "double", vFillDouble, iFmtDoubleValue, iPrintfDouble },
+};
+
+// -----------------------------------------------------------------------------
+// Conversions par seconde, les passes sur le tableau sont répétées jusqu'à
+// ce que la durée demandée soit écoulée
+static double
+dRate (int (*iConv) (char *, const xValue *), uint64_t ullDurationUs) {
+  char cBuf[FMT_MAX + 1];
+  uint64_t ullStart = ullTimeNowUs();
+  uint64_t ullElapsed;
+  uint64_t ullCount = 0;
+
+  do {
+
+    for (int i = 0; i < BENCH_VALUES; i++) {
+
+      ulSink += iConv (cBuf, &xValues[i]) + cBuf[0];
+    }
+    ullCount += BENCH_VALUES;
+    ullElapsed = ullTimeNowUs() - ullStart;
+  }
+  while (ullElapsed < ullDurationUs);
+
+  return (double) ullCount * 1e6 / (double) ullElapsed;
+}
+
+// -----------------------------------------------------------------------------
+int
+main (int argc, char ** argv) {
+  long lMs = BENCH_DEFAULT_MS;
+
+  if (argc > 1) {
+
+    lMs = strtol (argv[1], NULL, 0);
+    if (lMs <= 0) {
+
+      fprintf (stderr, "usage: %s [duration in ms per measure]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf ("%-8s %16s %17s %8s\n", "format", "fmt (values/s)",
+          "printf (values/s)", "ratio");
+  for (size_t n = 0; n < sizeof (xBenchList) / sizeof (xBenchList[0]); n++) {
+    const xBench * b = &xBenchList[n];
+    double dFmt, dPrintf;
+
+    for (int i = 0; i < BENCH_VALUES; i++) {
+
+      b->vFill (&xValues[i], ullRand());
+    }
+    dFmt = dRate (b->iFmt, lMs * 1000ULL);
+    dPrintf = dRate (b->iPrintf, lMs * 1000ULL);
+    printf ("%-8s %16.0f %17.0f %8.1f\n", b->sName, dFmt, dPrintf,
+            dFmt / dPrintf);
+  }
+
+  return EXIT_SUCCESS;
+}
+/* ========================================================================== */
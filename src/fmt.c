@@ -0,0 +1,899 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <stdbool.h>
+#include "fmt.h"
+
+/* constants ================================================================ */
+// paires de chiffres décimaux, "00" à "99"
+static const char sDigits[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static const char sHexDigits[] = "0123456789ABCDEF";
+
+/*
+ * Algorithme Ryu pour les float (Ulf Adams, "Ryū: fast float-to-string
+ * conversion", PLDI 2018). Les tables donnent 5^-i et 5^i en virgule fixe :
+ * ullPow5InvSplit[i] = floor (2^(pow5bits(i) - 1 + 59) / 5^i) + 1
+ * ullPow5Split[i] = 5^i / 2^(pow5bits(i) - 61)
+ */
+#define FLOAT_MANTISSA_BITS 23
+#define FLOAT_EXPONENT_BITS 8
+#define FLOAT_BIAS 127
+#define FLOAT_POW5_INV_BITCOUNT 59
+#define FLOAT_POW5_BITCOUNT 61
+
+static const uint64_t ullPow5InvSplit[31] = {
+  576460752303423489ULL, 461168601842738791ULL, 368934881474191033ULL,
+  295147905179352826ULL, 472236648286964522ULL, 377789318629571618ULL,
+  302231454903657294ULL, 483570327845851670ULL, 386856262276681336ULL,
+  309485009821345069ULL, 495176015714152110ULL, 396140812571321688ULL,
+  316912650057057351ULL, 507060240091291761ULL, 405648192073033409ULL,
+  324518553658426727ULL, 519229685853482763ULL, 415383748682786211ULL,
+  332306998946228969ULL, 531691198313966350ULL, 425352958651173080ULL,
+  340282366920938464ULL, 544451787073501542ULL, 435561429658801234ULL,
+  348449143727040987ULL, 557518629963265579ULL, 446014903970612463ULL,
+  356811923176489971ULL, 570899077082383953ULL, 456719261665907162ULL,
+  365375409332725730ULL
+};
+
+static const uint64_t ullPow5Split[47] = {
+  1152921504606846976ULL, 1441151880758558720ULL, 1801439850948198400ULL,
+  2251799813685248000ULL, 1407374883553280000ULL, 1759218604441600000ULL,
+  2199023255552000000ULL, 1374389534720000000ULL, 1717986918400000000ULL,
+  2147483648000000000ULL, 1342177280000000000ULL, 1677721600000000000ULL,
+  2097152000000000000ULL, 1310720000000000000ULL, 1638400000000000000ULL,
+  2048000000000000000ULL, 1280000000000000000ULL, 1600000000000000000ULL,
+  2000000000000000000ULL, 1250000000000000000ULL, 1562500000000000000ULL,
+  1953125000000000000ULL, 1220703125000000000ULL, 1525878906250000000ULL,
+  1907348632812500000ULL, 1192092895507812500ULL, 1490116119384765625ULL,
+  1862645149230957031ULL, 1164153218269348144ULL, 1455191522836685180ULL,
+  1818989403545856475ULL, 2273736754432320594ULL, 1421085471520200371ULL,
+  1776356839400250464ULL, 2220446049250313080ULL, 1387778780781445675ULL,
+  1734723475976807094ULL, 2168404344971008868ULL, 1355252715606880542ULL,
+  1694065894508600678ULL, 2117582368135750847ULL, 1323488980084844279ULL,
+  1654361225106055349ULL, 2067951531382569187ULL, 1292469707114105741ULL,
+  1615587133892632177ULL, 2019483917365790221ULL
+};
+
+/*
+ * Algorithme Ryu pour les double, avec les tables réduites de l'implantation
+ * de référence : 5^i et 5^-i (sur 125 bits) ne sont donnés que pour les
+ * multiples de 26, les autres sont obtenus en multipliant par une puissance
+ * de 5 de ullPow5Table, les offsets (2 bits par valeur) corrigent l'arrondi.
+ */
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BITS 11
+#define DOUBLE_BIAS 1023
+#define DOUBLE_POW5_INV_BITCOUNT 125
+#define DOUBLE_POW5_BITCOUNT 125
+#define POW5_TABLE_SIZE 26
+
+static const uint64_t ullPow5Table[POW5_TABLE_SIZE] = {
+  1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL, 390625ULL,
+  1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL, 1220703125ULL,
+  6103515625ULL, 30517578125ULL, 152587890625ULL, 762939453125ULL,
+  3814697265625ULL, 19073486328125ULL, 95367431640625ULL, 476837158203125ULL,
+  2384185791015625ULL, 11920928955078125ULL, 59604644775390625ULL,
+  298023223876953125ULL
+};
+
+static const uint64_t ullDoublePow5InvSplit[13][2] = {
+  { 1ULL, 2305843009213693952ULL },
+  { 5955668970331000884ULL, 1784059615882449851ULL },
+  { 8982663654677661702ULL, 1380349269358112757ULL },
+  { 7286864317269821294ULL, 2135987035920910082ULL },
+  { 7005857020398200553ULL, 1652639921975621497ULL },
+  { 17965325103354776697ULL, 1278668206209430417ULL },
+  { 8928596168509315048ULL, 1978643211784836272ULL },
+  { 10075671573058298858ULL, 1530901034580419511ULL },
+  { 597001226353042382ULL, 1184477304306571148ULL },
+  { 1527430471115325346ULL, 1832889850782397517ULL },
+  { 12533209867169019542ULL, 1418129833677084982ULL },
+  { 5577825024675947042ULL, 2194449627517475473ULL },
+  { 11006974540203867551ULL, 1697873161311732311ULL }
+};
+
+static const uint32_t ulPow5InvOffsets[19] = {
+  0x54544554UL, 0x04055545UL, 0x10041000UL, 0x00400414UL,
+  0x40010000UL, 0x41155555UL, 0x00000454UL, 0x00010044UL,
+  0x40000000UL, 0x44000041UL, 0x50454450UL, 0x55550054UL,
+  0x51655554UL, 0x40004000UL, 0x01000001UL, 0x00010500UL,
+  0x51515411UL, 0x05555554UL, 0x00000000UL
+};
+
+static const uint64_t ullDoublePow5Split[13][2] = {
+  { 0ULL, 1152921504606846976ULL },
+  { 0ULL, 1490116119384765625ULL },
+  { 1032610780636961552ULL, 1925929944387235853ULL },
+  { 7910200175544436838ULL, 1244603055572228341ULL },
+  { 16941905809032713930ULL, 1608611746708759036ULL },
+  { 13024893955298202172ULL, 2079081953128979843ULL },
+  { 6607496772837067824ULL, 1343575221513417750ULL },
+  { 17332926989895652603ULL, 1736530273035216783ULL },
+  { 13037379183483547984ULL, 2244412773384604712ULL },
+  { 1605989338741628675ULL, 1450417759929778918ULL },
+  { 9630225068416591280ULL, 1874621017369538693ULL },
+  { 665883850346957067ULL, 1211445438634777304ULL },
+  { 14931890668723713708ULL, 1565756531257009982ULL }
+};
+
+static const uint32_t ulPow5Offsets[21] = {
+  0x00000000UL, 0x00000000UL, 0x00000000UL, 0x00000000UL,
+  0x40000000UL, 0x59695995UL, 0x55545555UL, 0x56555515UL,
+  0x41150504UL, 0x40555410UL, 0x44555145UL, 0x44504540UL,
+  0x45555550UL, 0x40004000UL, 0x96440440UL, 0x55565565UL,
+  0x54454045UL, 0x40154151UL, 0x55559155UL, 0x51405555UL,
+  0x00000105UL
+};
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+// Ecriture des n chiffres de v, n doit être le nombre de chiffres de v
+static void
+vPutDigits (char * p, uint32_t v, int n) {
+
+  p += n;
+  while (v >= 100) {
+    const char * d = &sDigits[ (v % 100) * 2];
+
+    v /= 100;
+    *--p = d[1];
+    *--p = d[0];
+  }
+  if (v >= 10) {
+    const char * d = &sDigits[v * 2];
+
+    *--p = d[1];
+    *--p = d[0];
+  }
+  else {
+
+    *--p = (char) ('0' + v);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture des 8 chiffres de v < 10^8, avec des zéros en tête
+static void
+vPut8Digits (char * p, uint32_t v) {
+  int i;
+
+  for (i = 6; i >= 0; i -= 2) {
+    const char * d = &sDigits[ (v % 100) * 2];
+
+    v /= 100;
+    p[i] = d[0];
+    p[i + 1] = d[1];
+  }
+}
+
+// -----------------------------------------------------------------------------
+static int
+iDigitCount (uint32_t v) {
+
+  if (v < 10) return 1;
+  if (v < 100) return 2;
+  if (v < 1000) return 3;
+  if (v < 10000) return 4;
+  if (v < 100000) return 5;
+  if (v < 1000000) return 6;
+  if (v < 10000000) return 7;
+  if (v < 100000000) return 8;
+  if (v < 1000000000) return 9;
+  return 10;
+}
+
+// -----------------------------------------------------------------------------
+// ceil (log2 (5^e)), 1 pour e = 0
+static inline int32_t
+lPow5Bits (int32_t e) {
+
+  return (int32_t) ( ( (uint32_t) e * 1217359) >> 19) + 1;
+}
+
+// -----------------------------------------------------------------------------
+// floor (log10 (2^e))
+static inline uint32_t
+ulLog10Pow2 (int32_t e) {
+
+  return ( (uint32_t) e * 78913) >> 18;
+}
+
+// -----------------------------------------------------------------------------
+// floor (log10 (5^e))
+static inline uint32_t
+ulLog10Pow5 (int32_t e) {
+
+  return ( (uint32_t) e * 732923) >> 20;
+}
+
+// -----------------------------------------------------------------------------
+static inline bool
+bIsMultipleOfPow5 (uint32_t v, uint32_t p) {
+  uint32_t n = 0;
+
+  while ( (v % 5) == 0) {
+    v /= 5;
+    n++;
+  }
+  return n >= p;
+}
+
+// -----------------------------------------------------------------------------
+static inline bool
+bIsMultipleOfPow2 (uint32_t v, uint32_t p) {
+
+  return (v & ( (1u << p) - 1)) == 0;
+}
+
+// -----------------------------------------------------------------------------
+// (m * factor) >> shift, avec shift > 32
+static inline uint32_t
+ulMulShift (uint32_t m, uint64_t factor, int32_t shift) {
+  uint64_t bits0 = (uint64_t) m * (uint32_t) factor;
+  uint64_t bits1 = (uint64_t) m * (uint32_t) (factor >> 32);
+
+  return (uint32_t) ( ( (bits0 >> 32) + bits1) >> (shift - 32));
+}
+
+// -----------------------------------------------------------------------------
+// Produit de 64 x 64 bits, retourne les 64 bits de poids faible
+static inline uint64_t
+ullUMul128 (uint64_t a, uint64_t b, uint64_t * pullHigh) {
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 p = (unsigned __int128) a * b;
+
+  *pullHigh = (uint64_t) (p >> 64);
+  return (uint64_t) p;
+#else
+  uint64_t b00 = (uint64_t) (uint32_t) a * (uint32_t) b;
+  uint64_t b01 = (uint64_t) (uint32_t) a * (uint32_t) (b >> 32);
+  uint64_t b10 = (uint64_t) (uint32_t) (a >> 32) * (uint32_t) b;
+  uint64_t b11 = (uint64_t) (uint32_t) (a >> 32) * (uint32_t) (b >> 32);
+  uint64_t mid1 = b10 + (b00 >> 32);
+  uint64_t mid2 = b01 + (uint32_t) mid1;
+
+  *pullHigh = b11 + (mid1 >> 32) + (mid2 >> 32);
+  return (mid2 << 32) | (uint32_t) b00;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// (high:low) >> dist, avec 0 < dist < 64
+static inline uint64_t
+ullShiftRight128 (uint64_t low, uint64_t high, uint32_t dist) {
+
+  return (high << (64 - dist)) | (low >> dist);
+}
+
+// -----------------------------------------------------------------------------
+// 5^i sur 125 bits, i <= 325 (plus petit double)
+static void
+vDoublePow5 (uint32_t i, uint64_t * pullResult) {
+  uint32_t ulBase = i / POW5_TABLE_SIZE;
+  uint32_t ulBase2 = ulBase * POW5_TABLE_SIZE;
+  uint32_t ulOffset = i - ulBase2;
+  const uint64_t * mul = ullDoublePow5Split[ulBase];
+  uint64_t m, low0, high0, low1, high1, sum;
+  uint32_t ulDelta;
+
+  if (ulOffset == 0) {
+
+    pullResult[0] = mul[0];
+    pullResult[1] = mul[1];
+    return;
+  }
+  m = ullPow5Table[ulOffset];
+  low1 = ullUMul128 (m, mul[1], &high1);
+  low0 = ullUMul128 (m, mul[0], &high0);
+  sum = high0 + low1;
+  if (sum < high0) {
+    high1++;
+  }
+  ulDelta = lPow5Bits (i) - lPow5Bits (ulBase2);
+  pullResult[0] = ullShiftRight128 (low0, sum, ulDelta) +
+                  ( (ulPow5Offsets[i / 16] >> ( (i % 16) << 1)) & 3);
+  pullResult[1] = ullShiftRight128 (sum, high1, ulDelta);
+}
+
+// -----------------------------------------------------------------------------
+// 5^-i sur 125 bits, i <= 290 (plus grand double)
+static void
+vDoubleInvPow5 (uint32_t i, uint64_t * pullResult) {
+  uint32_t ulBase = (i + POW5_TABLE_SIZE - 1) / POW5_TABLE_SIZE;
+  uint32_t ulBase2 = ulBase * POW5_TABLE_SIZE;
+  uint32_t ulOffset = ulBase2 - i;
+  const uint64_t * mul = ullDoublePow5InvSplit[ulBase];
+  uint64_t m, low0, high0, low1, high1, sum;
+  uint32_t ulDelta;
+
+  if (ulOffset == 0) {
+
+    pullResult[0] = mul[0];
+    pullResult[1] = mul[1];
+    return;
+  }
+  m = ullPow5Table[ulOffset];
+  low1 = ullUMul128 (m, mul[1], &high1);
+  low0 = ullUMul128 (m, mul[0] - 1, &high0);
+  sum = high0 + low1;
+  if (sum < high0) {
+    high1++;
+  }
+  ulDelta = lPow5Bits (ulBase2) - lPow5Bits (i);
+  pullResult[0] = ullShiftRight128 (low0, sum, ulDelta) + 1 +
+                  ( (ulPow5InvOffsets[i / 16] >> ( (i % 16) << 1)) & 3);
+  pullResult[1] = ullShiftRight128 (sum, high1, ulDelta);
+}
+
+// -----------------------------------------------------------------------------
+// (m * mul) >> j, mul sur 128 bits, m sur 55 bits au plus, 64 < j < 128
+static inline uint64_t
+ullMulShift64 (uint64_t m, const uint64_t * mul, int32_t j) {
+  uint64_t high0, high1, low1, sum;
+
+  (void) ullUMul128 (m, mul[0], &high0);
+  low1 = ullUMul128 (m, mul[1], &high1);
+  sum = high0 + low1;
+  if (sum < high0) {
+    high1++;
+  }
+  return ullShiftRight128 (sum, high1, j - 64);
+}
+
+// -----------------------------------------------------------------------------
+static inline bool
+bIsMultipleOfPow5Ull (uint64_t v, uint32_t p) {
+  uint32_t n = 0;
+
+  while ( (v % 5) == 0) {
+    v /= 5;
+    n++;
+  }
+  return n >= p;
+}
+
+// -----------------------------------------------------------------------------
+static inline bool
+bIsMultipleOfPow2Ull (uint64_t v, uint32_t p) {
+
+  return (v & ( (1ULL << p) - 1)) == 0;
+}
+
+// -----------------------------------------------------------------------------
+// Plus court décimal d'un float fini non nul : *pulDigits * 10^*plExp
+static void
+vFloatToDecimal (uint32_t ulMantissa, uint32_t ulExponent,
+                 uint32_t * pulDigits, int32_t * plExp) {
+  int32_t e2, e10;
+  uint32_t m2, mv, mp, mm, vr, vp, vm, q;
+  uint32_t ulMmShift;
+  bool bIsEven, bVmIsTrailingZeros = false, bVrIsTrailingZeros = false;
+  uint8_t ucLastRemoved = 0;
+  int32_t lRemoved = 0;
+
+  if (ulExponent == 0) {
+
+    e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+    m2 = ulMantissa;
+  }
+  else {
+
+    e2 = (int32_t) ulExponent - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+    m2 = (1u << FLOAT_MANTISSA_BITS) | ulMantissa;
+  }
+  bIsEven = (m2 & 1) == 0;
+
+  // intervalle des réels qui s'arrondissent vers ce float
+  mv = 4 * m2;
+  mp = 4 * m2 + 2;
+  ulMmShift = (ulMantissa != 0) || (ulExponent <= 1);
+  mm = 4 * m2 - 1 - ulMmShift;
+
+  // conversion de l'intervalle en base 10
+  if (e2 >= 0) {
+    int32_t k, i;
+
+    q = ulLog10Pow2 (e2);
+    e10 = (int32_t) q;
+    k = FLOAT_POW5_INV_BITCOUNT + lPow5Bits (q) - 1;
+    i = -e2 + (int32_t) q + k;
+    vr = ulMulShift (mv, ullPow5InvSplit[q], i);
+    vp = ulMulShift (mp, ullPow5InvSplit[q], i);
+    vm = ulMulShift (mm, ullPow5InvSplit[q], i);
+    if ( (q != 0) && ( (vp - 1) / 10 <= vm / 10)) {
+
+      // le dernier chiffre supprimé est nécessaire à l'arrondi
+      int32_t l = FLOAT_POW5_INV_BITCOUNT + lPow5Bits (q - 1) - 1;
+
+      ucLastRemoved = (uint8_t) (ulMulShift (mv, ullPow5InvSplit[q - 1],
+                                             -e2 + (int32_t) q - 1 + l) % 10);
+    }
+    if (q <= 9) {
+
+      if ( (mv % 5) == 0) {
+
+        bVrIsTrailingZeros = bIsMultipleOfPow5 (mv, q);
+      }
+      else if (bIsEven) {
+
+        bVmIsTrailingZeros = bIsMultipleOfPow5 (mm, q);
+      }
+      else {
+
+        vp -= bIsMultipleOfPow5 (mp, q);
+      }
+    }
+  }
+  else {
+    int32_t k, i, j;
+
+    q = ulLog10Pow5 (-e2);
+    e10 = (int32_t) q + e2;
+    i = -e2 - (int32_t) q;
+    k = lPow5Bits (i) - FLOAT_POW5_BITCOUNT;
+    j = (int32_t) q - k;
+    vr = ulMulShift (mv, ullPow5Split[i], j);
+    vp = ulMulShift (mp, ullPow5Split[i], j);
+    vm = ulMulShift (mm, ullPow5Split[i], j);
+    if ( (q != 0) && ( (vp - 1) / 10 <= vm / 10)) {
+
+      j = (int32_t) q - 1 - (lPow5Bits (i + 1) - FLOAT_POW5_BITCOUNT);
+      ucLastRemoved = (uint8_t) (ulMulShift (mv, ullPow5Split[i + 1], j) % 10);
+    }
+    if (q <= 1) {
+
+      // mv = 4 * m2 a toujours au moins 2 zéros en fin
+      bVrIsTrailingZeros = true;
+      if (bIsEven) {
+
+        bVmIsTrailingZeros = (ulMmShift == 1);
+      }
+      else {
+
+        --vp;
+      }
+    }
+    else if (q < 31) {
+
+      bVrIsTrailingZeros = bIsMultipleOfPow2 (mv, q - 1);
+    }
+  }
+
+  // suppression des chiffres tant que l'intervalle contient le résultat
+  if (bVmIsTrailingZeros || bVrIsTrailingZeros) {
+
+    while (vp / 10 > vm / 10) {
+
+      bVmIsTrailingZeros &= (vm % 10) == 0;
+      bVrIsTrailingZeros &= (ucLastRemoved == 0);
+      ucLastRemoved = (uint8_t) (vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      lRemoved++;
+    }
+    if (bVmIsTrailingZeros) {
+
+      while ( (vm % 10) == 0) {
+
+        bVrIsTrailingZeros &= (ucLastRemoved == 0);
+        ucLastRemoved = (uint8_t) (vr % 10);
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        lRemoved++;
+      }
+    }
+    if (bVrIsTrailingZeros && (ucLastRemoved == 5) && ( (vr % 2) == 0)) {
+
+      // égalité exacte, arrondi au pair
+      ucLastRemoved = 4;
+    }
+    *pulDigits = vr + ( ( (vr == vm) && (!bIsEven || !bVmIsTrailingZeros)) ||
+                        (ucLastRemoved >= 5));
+  }
+  else {
+
+    while (vp / 10 > vm / 10) {
+
+      ucLastRemoved = (uint8_t) (vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      lRemoved++;
+    }
+    *pulDigits = vr + ( (vr == vm) || (ucLastRemoved >= 5));
+  }
+  *plExp = e10 + lRemoved;
+}
+
+// -----------------------------------------------------------------------------
+// Plus court décimal d'un double fini non nul : *pullDigits * 10^*plExp
+// Contrairement aux float, q est diminué de 1 pour que le dernier chiffre
+// supprimé soit toujours calculé dans la boucle.
+static void
+vDoubleToDecimal (uint64_t ullMantissa, uint32_t ulExponent,
+                  uint64_t * pullDigits, int32_t * plExp) {
+  int32_t e2, e10;
+  uint64_t m2, mv, vr, vp, vm;
+  uint64_t pow5[2];
+  uint32_t q, ulMmShift;
+  bool bIsEven, bVmIsTrailingZeros = false, bVrIsTrailingZeros = false;
+  uint8_t ucLastRemoved = 0;
+  int32_t lRemoved = 0;
+
+  if (ulExponent == 0) {
+
+    e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+    m2 = ullMantissa;
+  }
+  else {
+
+    e2 = (int32_t) ulExponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+    m2 = (1ULL << DOUBLE_MANTISSA_BITS) | ullMantissa;
+  }
+  bIsEven = (m2 & 1) == 0;
+
+  // intervalle des réels qui s'arrondissent vers ce double
+  mv = 4 * m2;
+  ulMmShift = (ullMantissa != 0) || (ulExponent <= 1);
+
+  // conversion de l'intervalle en base 10
+  if (e2 >= 0) {
+    int32_t k, i;
+
+    q = ulLog10Pow2 (e2) - (e2 > 3);
+    e10 = (int32_t) q;
+    k = DOUBLE_POW5_INV_BITCOUNT + lPow5Bits (q) - 1;
+    i = -e2 + (int32_t) q + k;
+    vDoubleInvPow5 (q, pow5);
+    vr = ullMulShift64 (mv, pow5, i);
+    vp = ullMulShift64 (mv + 2, pow5, i);
+    vm = ullMulShift64 (mv - 1 - ulMmShift, pow5, i);
+    if (q <= 21) {
+
+      // un seul de mv, mp et mm peut être multiple de 5
+      if ( (mv % 5) == 0) {
+
+        bVrIsTrailingZeros = bIsMultipleOfPow5Ull (mv, q);
+      }
+      else if (bIsEven) {
+
+        bVmIsTrailingZeros = bIsMultipleOfPow5Ull (mv - 1 - ulMmShift, q);
+      }
+      else {
+
+        vp -= bIsMultipleOfPow5Ull (mv + 2, q);
+      }
+    }
+  }
+  else {
+    int32_t k, i, j;
+
+    q = ulLog10Pow5 (-e2) - (-e2 > 1);
+    e10 = (int32_t) q + e2;
+    i = -e2 - (int32_t) q;
+    k = lPow5Bits (i) - DOUBLE_POW5_BITCOUNT;
+    j = (int32_t) q - k;
+    vDoublePow5 (i, pow5);
+    vr = ullMulShift64 (mv, pow5, j);
+    vp = ullMulShift64 (mv + 2, pow5, j);
+    vm = ullMulShift64 (mv - 1 - ulMmShift, pow5, j);
+    if (q <= 1) {
+
+      // mv = 4 * m2 a toujours au moins 2 zéros en fin
+      bVrIsTrailingZeros = true;
+      if (bIsEven) {
+
+        bVmIsTrailingZeros = (ulMmShift == 1);
+      }
+      else {
+
+        --vp;
+      }
+    }
+    else if (q < 63) {
+
+      bVrIsTrailingZeros = bIsMultipleOfPow2Ull (mv, q);
+    }
+  }
+
+  // suppression des chiffres tant que l'intervalle contient le résultat
+  if (bVmIsTrailingZeros || bVrIsTrailingZeros) {
+
+    while (vp / 10 > vm / 10) {
+
+      bVmIsTrailingZeros &= (vm % 10) == 0;
+      bVrIsTrailingZeros &= (ucLastRemoved == 0);
+      ucLastRemoved = (uint8_t) (vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      lRemoved++;
+    }
+    if (bVmIsTrailingZeros) {
+
+      while ( (vm % 10) == 0) {
+
+        bVrIsTrailingZeros &= (ucLastRemoved == 0);
+        ucLastRemoved = (uint8_t) (vr % 10);
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        lRemoved++;
+      }
+    }
+    if (bVrIsTrailingZeros && (ucLastRemoved == 5) && ( (vr % 2) == 0)) {
+
+      // égalité exacte, arrondi au pair
+      ucLastRemoved = 4;
+    }
+    *pullDigits = vr + ( ( (vr == vm) && (!bIsEven || !bVmIsTrailingZeros)) ||
+                         (ucLastRemoved >= 5));
+  }
+  else {
+
+    // cas courant : deux chiffres à la fois, puis un par un
+    if (vp / 100 > vm / 100) {
+
+      ucLastRemoved = (uint8_t) (vr % 100 >= 50 ? 5 : 0);
+      vr /= 100;
+      vp /= 100;
+      vm /= 100;
+      lRemoved += 2;
+    }
+    while (vp / 10 > vm / 10) {
+
+      ucLastRemoved = (uint8_t) (vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      lRemoved++;
+    }
+    *pullDigits = vr + ( (vr == vm) || (ucLastRemoved >= 5));
+  }
+  *plExp = e10 + lRemoved;
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture de pcDigits (n chiffres) x 10^lExp, en notation décimale entre
+// 1e-5 et 10^iPointMax, en notation scientifique au-delà
+static int
+iPutDecimal (char * p, const char * pcDigits, int n, int32_t lExp,
+             int iPointMax) {
+  char * pcStart = p;
+  // position de la virgule par rapport au premier chiffre
+  int iPoint = n + lExp;
+
+  if ( (iPoint > -5) && (iPoint <= iPointMax)) {
+
+    if (iPoint <= 0) {
+
+      // 0.000ddd
+      *p++ = '0';
+      *p++ = '.';
+      memset (p, '0', -iPoint);
+      p += -iPoint;
+      memcpy (p, pcDigits, n);
+      p += n;
+    }
+    else if (iPoint >= n) {
+
+      // ddd000
+      memcpy (p, pcDigits, n);
+      p += n;
+      memset (p, '0', iPoint - n);
+      p += iPoint - n;
+    }
+    else {
+
+      // dd.ddd
+      memcpy (p, pcDigits, iPoint);
+      p[iPoint] = '.';
+      memcpy (p + iPoint + 1, pcDigits + iPoint, n - iPoint);
+      p += n + 1;
+    }
+  }
+  else {
+    int32_t lSciExp = iPoint - 1;
+
+    // d.ddde+XX
+    *p++ = pcDigits[0];
+    if (n > 1) {
+
+      *p++ = '.';
+      memcpy (p, pcDigits + 1, n - 1);
+      p += n - 1;
+    }
+    *p++ = 'e';
+    *p++ = (lSciExp < 0) ? '-' : '+';
+    if (lSciExp < 0) {
+      lSciExp = -lSciExp;
+    }
+    if (lSciExp >= 100) {
+
+      p += iFmtU32 (p, (uint32_t) lSciExp);
+    }
+    else {
+
+      // au moins 2 chiffres comme printf()
+      memcpy (p, &sDigits[lSciExp * 2], 2);
+      p += 2;
+    }
+  }
+  return (int) (p - pcStart);
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+int
+iFmtU32 (char * pcDst, uint32_t ulValue) {
+  int n = iDigitCount (ulValue);
+
+  vPutDigits (pcDst, ulValue, n);
+  return n;
+}
+
+// -----------------------------------------------------------------------------
+int
+iFmtI32 (char * pcDst, int32_t lValue) {
+
+  if (lValue < 0) {
+
+    *pcDst = '-';
+    // -INT32_MIN n'est pas représentable en int32_t
+    return 1 + iFmtU32 (pcDst + 1, 0u - (uint32_t) lValue);
+  }
+  return iFmtU32 (pcDst, (uint32_t) lValue);
+}
+
+// -----------------------------------------------------------------------------
+int
+iFmtU64 (char * pcDst, uint64_t ullValue) {
+  int n;
+
+  if (ullValue <= UINT32_MAX) {
+    return iFmtU32 (pcDst, (uint32_t) ullValue);
+  }
+  // tranches de 8 chiffres, au plus 20 chiffres en tout
+  if (ullValue < 10000000000000000ULL) {
+
+    n = iFmtU32 (pcDst, (uint32_t) (ullValue / 100000000));
+  }
+  else {
+
+    n = iFmtU32 (pcDst, (uint32_t) (ullValue / 10000000000000000ULL));
+    vPut8Digits (pcDst + n, (uint32_t) (ullValue / 100000000 % 100000000));
+    n += 8;
+  }
+  vPut8Digits (pcDst + n, (uint32_t) (ullValue % 100000000));
+  return n + 8;
+}
+
+// -----------------------------------------------------------------------------
+int
+iFmtI64 (char * pcDst, int64_t llValue) {
+
+  if (llValue < 0) {
+
+    *pcDst = '-';
+    return 1 + iFmtU64 (pcDst + 1, 0u - (uint64_t) llValue);
+  }
+  return iFmtU64 (pcDst, (uint64_t) llValue);
+}
+
+// -----------------------------------------------------------------------------
+int
+iFmtHex16 (char * pcDst, uint16_t usValue) {
+
+  pcDst[0] = '0';
+  pcDst[1] = 'x';
+  pcDst[2] = sHexDigits[usValue >> 12];
+  pcDst[3] = sHexDigits[ (usValue >> 8) & 0xF];
+  pcDst[4] = sHexDigits[ (usValue >> 4) & 0xF];
+  pcDst[5] = sHexDigits[usValue & 0xF];
+  return 6;
+}
+
+// -----------------------------------------------------------------------------
+int
+iFmtFloat (char * pcDst, float fValue) {
+  uint32_t ulBits, ulMantissa, ulExponent, ulDigits;
+  int32_t lExp;
+  int n;
+  char cDigits[10];
+  char * p = pcDst;
+
+  memcpy (&ulBits, &fValue, sizeof (ulBits));
+  ulMantissa = ulBits & ( (1u << FLOAT_MANTISSA_BITS) - 1);
+  ulExponent = (ulBits >> FLOAT_MANTISSA_BITS) &
+               ( (1u << FLOAT_EXPONENT_BITS) - 1);
+
+  if ( (ulExponent == (1u << FLOAT_EXPONENT_BITS) - 1) && (ulMantissa != 0)) {
+
+    memcpy (pcDst, "nan", 3);
+    return 3;
+  }
+  if (ulBits >> 31) {
+
+    *p++ = '-';
+  }
+  if (ulExponent == (1u << FLOAT_EXPONENT_BITS) - 1) {
+
+    memcpy (p, "inf", 3);
+    return (int) (p - pcDst) + 3;
+  }
+  if ( (ulExponent == 0) && (ulMantissa == 0)) {
+
+    *p++ = '0';
+    return (int) (p - pcDst);
+  }
+
+  vFloatToDecimal (ulMantissa, ulExponent, &ulDigits, &lExp);
+  n = iDigitCount (ulDigits);
+  vPutDigits (cDigits, ulDigits, n);
+  p += iPutDecimal (p, cDigits, n, lExp, 9);
+  return (int) (p - pcDst);
+}
+
+// -----------------------------------------------------------------------------
+int
+iFmtDouble (char * pcDst, double dValue) {
+  uint64_t ullBits, ullMantissa, ullDigits;
+  uint32_t ulExponent;
+  int32_t lExp;
+  int n;
+  char cDigits[20];
+  char * p = pcDst;
+
+  memcpy (&ullBits, &dValue, sizeof (ullBits));
+  ullMantissa = ullBits & ( (1ULL << DOUBLE_MANTISSA_BITS) - 1);
+  ulExponent = (uint32_t) ( (ullBits >> DOUBLE_MANTISSA_BITS) &
+                            ( (1u << DOUBLE_EXPONENT_BITS) - 1));
+
+  if ( (ulExponent == (1u << DOUBLE_EXPONENT_BITS) - 1) && (ullMantissa != 0)) {
+
+    memcpy (pcDst, "nan", 3);
+    return 3;
+  }
+  if (ullBits >> 63) {
+
+    *p++ = '-';
+  }
+  if (ulExponent == (1u << DOUBLE_EXPONENT_BITS) - 1) {
+
+    memcpy (p, "inf", 3);
+    return (int) (p - pcDst) + 3;
+  }
+  if ( (ulExponent == 0) && (ullMantissa == 0)) {
+
+    *p++ = '0';
+    return (int) (p - pcDst);
+  }
+
+  vDoubleToDecimal (ullMantissa, ulExponent, &ullDigits, &lExp);
+  n = iFmtU64 (cDigits, ullDigits);
+  p += iPutDecimal (p, cDigits, n, lExp, 17);
+  return (int) (p - pcDst);
+}
+
+/* ========================================================================== */
@@ -0,0 +1,80 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_FMT_H_
+#define _MBPOLL_FMT_H_
+
+#include <stdint.h>
+
+/*
+ * Conversion des valeurs lues en texte, sans passer par printf()
+ * Les fonctions écrivent dans pcDst sans zéro final et retournent le nombre
+ * de caractères écrits, pcDst doit pouvoir recevoir FMT_MAX caractères.
+ */
+
+/* constants ================================================================ */
+/**
+ * Nombre maximal de caractères écrits par une fonction de conversion
+ * ("-2.2250738585072014e-308" pour un double)
+ */
+#define FMT_MAX 32
+
+/* internal public functions ================================================ */
+
+/**
+ * Entier non signé en décimal
+ */
+int iFmtU32 (char * pcDst, uint32_t ulValue);
+
+/**
+ * Entier signé en décimal
+ */
+int iFmtI32 (char * pcDst, int32_t lValue);
+
+/**
+ * Entier de 64 bits non signé en décimal
+ */
+int iFmtU64 (char * pcDst, uint64_t ullValue);
+
+/**
+ * Entier de 64 bits signé en décimal
+ */
+int iFmtI64 (char * pcDst, int64_t llValue);
+
+/**
+ * Mot de 16 bits en hexadécimal, de la forme 0x00FF
+ */
+int iFmtHex16 (char * pcDst, uint16_t usValue);
+
+/**
+ * Nombre flottant, avec le plus petit nombre de chiffres qui permet de
+ * retrouver exactement la même valeur à la relecture (algorithme Ryu)
+ *
+ * La notation décimale est utilisée entre 1e-5 et 1e9, la notation
+ * scientifique au-delà (1.5e+10, 2e-07), nan et inf sont écrits comme par
+ * printf().
+ */
+int iFmtFloat (char * pcDst, float fValue);
+
+/**
+ * Nombre flottant double précision, avec le plus petit nombre de chiffres qui
+ * permet de retrouver exactement la même valeur (algorithme Ryu)
+ *
+ * Comme iFmtFloat() mais la notation décimale est utilisée jusqu'à 1e17.
+ */
+int iFmtDouble (char * pcDst, double dValue);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_FMT_H_ */
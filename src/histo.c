@@ -0,0 +1,147 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "histo.h"
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+// Rang du bit de poids fort, v > 0
+static int
+iMsb (uint64_t v) {
+#if defined (__GNUC__)
+  return 63 - __builtin_clzll (v);
+#else
+  int n = 0;
+
+  while (v >>= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Case d'une valeur
+static int
+iBucket (uint64_t v) {
+  int iMsbPos, iShift, i;
+
+  if (v < HISTO_LINEAR) {
+    return (int) v;
+  }
+  iMsbPos = iMsb (v);
+  iShift = iMsbPos - HISTO_SUB_BITS;
+  i = HISTO_LINEAR + (iMsbPos - HISTO_SUB_BITS - 1) * HISTO_SUB_COUNT +
+      (int) ( (v >> iShift) - HISTO_SUB_COUNT);
+  return (i < HISTO_BUCKETS) ? i : HISTO_BUCKETS - 1;
+}
+
+// -----------------------------------------------------------------------------
+// Plus grande valeur d'une case
+static uint64_t
+ullBucketHigh (int i) {
+  int iOctave, iShift;
+
+  if (i < HISTO_LINEAR) {
+    return i;
+  }
+  iOctave = (i - HISTO_LINEAR) / HISTO_SUB_COUNT;
+  iShift = iOctave + 1;
+  return ( ( (uint64_t) ( (i - HISTO_LINEAR) % HISTO_SUB_COUNT +
+                          HISTO_SUB_COUNT) + 1) << iShift) - 1;
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vHistoClear (xHisto * h) {
+
+  memset (h, 0, sizeof (xHisto));
+  h->ullMin = UINT64_MAX;
+}
+
+// -----------------------------------------------------------------------------
+void
+vHistoRecord (xHisto * h, uint64_t v) {
+
+  h->ulBucket[iBucket (v)]++;
+  h->ullCount++;
+  h->ullSum += v;
+  if (v < h->ullMin) {
+    h->ullMin = v;
+  }
+  if (v > h->ullMax) {
+    h->ullMax = v;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vHistoMerge (xHisto * d, const xHisto * s) {
+  int i;
+
+  for (i = 0; i < HISTO_BUCKETS; i++) {
+    d->ulBucket[i] += s->ulBucket[i];
+  }
+  d->ullCount += s->ullCount;
+  d->ullSum += s->ullSum;
+  if (s->ullMin < d->ullMin) {
+    d->ullMin = s->ullMin;
+  }
+  if (s->ullMax > d->ullMax) {
+    d->ullMax = s->ullMax;
+  }
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullHistoQuantile (const xHisto * h, double q) {
+  uint64_t ullRank, ullSeen = 0;
+  int i;
+
+  if (h->ullCount == 0) {
+    return 0;
+  }
+  // rang de la valeur recherchée, de 1 à ullCount
+  ullRank = (uint64_t) (q * h->ullCount + 0.5);
+  if (ullRank < 1) {
+    ullRank = 1;
+  }
+  if (ullRank > h->ullCount) {
+    ullRank = h->ullCount;
+  }
+
+  for (i = 0; i < HISTO_BUCKETS; i++) {
+
+    ullSeen += h->ulBucket[i];
+    if (ullSeen >= ullRank) {
+      uint64_t v = ullBucketHigh (i);
+
+      if (v > h->ullMax) {
+        v = h->ullMax;
+      }
+      if (v < h->ullMin) {
+        v = h->ullMin;
+      }
+      return v;
+    }
+  }
+  return h->ullMax;
+}
+
+/* ========================================================================== */
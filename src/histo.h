@@ -0,0 +1,72 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_HISTO_H_
+#define _MBPOLL_HISTO_H_
+
+#include <stdint.h>
+
+/* constants ================================================================ */
+/*
+ * Histogramme à échelle log-linéaire (principe de HdrHistogram) : les valeurs
+ * inférieures à 32 ont chacune leur case, chaque puissance de 2 au-delà est
+ * découpée en 16 cases. L'erreur relative sur une valeur est donc d'au plus
+ * 1/16 (6,25 %), quel que soit son ordre de grandeur, pour un encombrement
+ * fixe. Les valeurs supérieures à 2^32 sont comptées dans la dernière case.
+ */
+#define HISTO_SUB_BITS  4
+#define HISTO_SUB_COUNT (1 << HISTO_SUB_BITS)
+#define HISTO_LINEAR    (2 * HISTO_SUB_COUNT)
+#define HISTO_BUCKETS   (HISTO_LINEAR + (32 - HISTO_SUB_BITS - 1) * HISTO_SUB_COUNT)
+
+/* structures =============================================================== */
+/**
+ * Histogramme de valeurs entières (temps en µs dans mbpoll)
+ */
+typedef struct xHisto {
+  uint64_t ullCount; /**< nombre de valeurs enregistrées */
+  uint64_t ullMin; /**< plus petite valeur */
+  uint64_t ullMax; /**< plus grande valeur */
+  uint64_t ullSum; /**< somme des valeurs, pour la moyenne */
+  uint32_t ulBucket[HISTO_BUCKETS];
+} xHisto;
+
+/* internal public functions ================================================ */
+
+/**
+ * Remise à zéro
+ */
+void vHistoClear (xHisto * xH);
+
+/**
+ * Enregistrement d'une valeur
+ */
+void vHistoRecord (xHisto * xH, uint64_t ullValue);
+
+/**
+ * Ajout du contenu de xSrc à xDst
+ */
+void vHistoMerge (xHisto * xDst, const xHisto * xSrc);
+
+/**
+ * Valeur du quantile q (0 à 1)
+ *
+ * @return la plus grande valeur de la case qui contient le quantile (bornée
+ * par le maximum enregistré), 0 si l'histogramme est vide
+ */
+uint64_t ullHistoQuantile (const xHisto * xH, double q);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_HISTO_H_ */
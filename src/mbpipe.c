@@ -0,0 +1,981 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mbpipe.h"
+#ifdef MBPOLL_PIPELINE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef MBPOLL_EPOLL
+#include <sys/epoll.h>
+#endif
+#include <modbus.h>
+#include "timing.h"
+#include "bits.h"
+#include "wheel.h"
+#include "mbrtu.h"
+
+/* constants ================================================================ */
+#define MBAP_HEADER_SIZE  7
+#define MBAP_ADU_MAX      (MBAP_HEADER_SIZE + MB_PDU_MAX)
+#define RXBUF_SIZE        (4 * MBAP_ADU_MAX)
+// durée d'une case de la roue d'échéances, en µs
+#define ENGINE_TICK       1000
+// nombre maximal d'évènements traités par attente
+#define ENGINE_EVENTS     64
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* structures =============================================================== */
+// Echéance armée par le moteur, bIsRtu indique la structure qui la contient
+typedef struct xEngineTimer {
+  xWheelTimer xWheel;
+  bool bIsRtu; // xRtuPort, xMbSlot sinon
+} xEngineTimer;
+
+// Transaction en attente de réponse
+typedef struct xMbSlot {
+  bool bUsed;
+  uint16_t usTid;
+  int iReq;
+  uint64_t ullSent;
+  xEngineTimer xTimer; // timeout de réponse
+  xMbPipe * xPipe;
+} xMbSlot;
+
+/*
+ * Port série mené par le moteur pendant iMbEngineRun() : il est surveillé en
+ * lecture et son échéance armée tant que son lot n'est pas terminé, la
+ * machine à états est dans mbrtu.c. bIsRtu est le premier champ, comme dans
+ * xMbPipe, pour distinguer les évènements des ports et des connexions.
+ */
+typedef struct xRtuPort {
+  bool bIsRtu; // toujours vrai
+  xMbBatch * xBatch; // NULL quand le lot est terminé
+  xEngineTimer xTimer;
+} xRtuPort;
+
+/*
+ * Etat d'une connexion pendant iMbEngineRun() :
+ * - inactive (xBatch NULL), les réponses qui arrivent encore sont ignorées,
+ * - en cours, des requêtes attendent d'être envoyées (iNext < iCount) ou
+ *   leur réponse (iInFlight > 0), les trames à envoyer qui n'ont pas pu
+ *   l'être attendent dans ucTx que le socket soit prêt en écriture,
+ * - terminée quand toutes les requêtes ont une réponse ou ont expiré, ou
+ *   rompue à la première erreur du socket.
+ */
+struct xMbPipe {
+  bool bIsRtu; // toujours faux, voir xRtuPort
+  int iFd;
+  int iWindow;
+  uint64_t ullTimeout; // µs
+  bool bDebug;
+  uint16_t usNextTid;
+  xMbSlot * xSlots;
+  uint8_t ucRx[RXBUF_SIZE];
+  size_t ulRxLen;
+  uint8_t * ucTx; // iWindow requêtes au plus
+  size_t ulTxLen;
+  // moteur
+  xMbEngine * xEngine; // moteur où le socket est enregistré
+  bool bWantsWrite; // attente de la possibilité d'écrire
+  xMbBatch * xBatch; // lot en cours, NULL si inactive
+  int iNext; // prochaine requête du lot à envoyer
+  int iInFlight; // requêtes en attente de réponse
+};
+
+struct xMbEngine {
+  int iFd; // epoll, -1 avec poll()
+  int iActive; // connexions et ports en cours
+  xWheel xWheel;
+  xRtuPort * xPorts; // un par lot, seuls ceux des ports série sont utilisés
+  int iPortsSize;
+  // poll()
+  struct pollfd * xPfd;
+  void ** pvPfdSrc; // connexion (xMbPipe) ou port (xRtuPort)
+  int iPfdSize;
+};
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static void
+vPrintFrame (const char * sFmt, const uint8_t * ucFrame, size_t ulLen) {
+  size_t i;
+
+  for (i = 0; i < ulLen; i++) {
+
+    printf (sFmt, ucFrame[i]);
+  }
+  putchar ('\n');
+}
+
+// -----------------------------------------------------------------------------
+// Attente d'un évènement sur le socket, retourne 0 si timeout
+static int
+iWait (int iFd, short sEvents, uint64_t ullDeadline) {
+  uint64_t ullNow = ullTimeNowUs();
+  struct pollfd xPfd = { .fd = iFd, .events = sEvents };
+  int iMs, iRet;
+
+  iMs = (ullDeadline > ullNow) ? (int) ( (ullDeadline - ullNow + 999) / 1000) : 0;
+  do {
+    iRet = poll (&xPfd, 1, iMs);
+  }
+  while ( (iRet < 0) && (errno == EINTR));
+  return iRet;
+}
+
+// -----------------------------------------------------------------------------
+// Décodage d'une réponse, retourne 0 ou le code d'erreur de la requête
+static int
+iDecodeResponse (const xMbRequest * r, const uint8_t * ucAdu, size_t ulLen) {
+
+  if (ucAdu[6] != r->iSlave) {
+
+    return EMBBADSLAVE;
+  }
+  return iMbPduDecode (r, ucAdu + MBAP_HEADER_SIZE, ulLen - MBAP_HEADER_SIZE);
+}
+
+// -----------------------------------------------------------------------------
+// Mise à jour des évènements attendus sur le socket : la possibilité d'écrire
+// n'est attendue que si des trames n'ont pas pu partir
+static int
+iWatch (xMbEngine * e, xMbPipe * p) {
+  bool bWantsWrite = (p->ulTxLen > 0);
+
+#ifdef MBPOLL_EPOLL
+  if ( (e->iFd >= 0) && ( (p->xEngine != e) ||
+                          (p->bWantsWrite != bWantsWrite))) {
+    struct epoll_event xEv = {
+      .events = EPOLLIN | (bWantsWrite ? EPOLLOUT : 0),
+      .data.ptr = p
+    };
+
+    if (epoll_ctl (e->iFd, (p->xEngine == e) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                   p->iFd, &xEv) != 0) {
+      return -1;
+    }
+  }
+#endif
+  p->xEngine = e;
+  p->bWantsWrite = bWantsWrite;
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Retrait du socket du moteur
+static void
+vUnwatch (xMbEngine * e, xMbPipe * p) {
+
+#ifdef MBPOLL_EPOLL
+  if ( (e->iFd >= 0) && (p->xEngine == e)) {
+
+    epoll_ctl (e->iFd, EPOLL_CTL_DEL, p->iFd, NULL);
+  }
+#endif
+  p->xEngine = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Envoi des trames en attente, sans bloquer
+static int
+iFlush (xMbEngine * e, xMbPipe * p) {
+  size_t ulSent = 0;
+
+  while (ulSent < p->ulTxLen) {
+    ssize_t n = send (p->iFd, p->ucTx + ulSent, p->ulTxLen - ulSent,
+                      MSG_NOSIGNAL);
+
+    if (n < 0) {
+
+      if ( (errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    ulSent += n;
+  }
+  if (ulSent > 0) {
+
+    memmove (p->ucTx, p->ucTx + ulSent, p->ulTxLen - ulSent);
+    p->ulTxLen -= ulSent;
+  }
+  return iWatch (e, p);
+}
+
+// -----------------------------------------------------------------------------
+// Remplissage de la fenêtre avec les requêtes suivantes du lot
+static int
+iFill (xMbEngine * e, xMbPipe * p) {
+  xMbBatch * b = p->xBatch;
+  bool bIsQueued = false;
+  int i;
+
+  for (i = 0; (i < p->iWindow) && (p->iNext < b->iCount); i++) {
+    xMbSlot * s = &p->xSlots[i];
+
+    if (!s->bUsed) {
+      xMbRequest * r = &b->xReq[p->iNext];
+      uint8_t * ucFrame = p->ucTx + p->ulTxLen;
+      size_t ulLen = ulMbPduEncode (r, ucFrame + MBAP_HEADER_SIZE);
+
+      if (ulLen == 0) {
+
+        // requête trop longue, elle échoue sans être envoyée et la case
+        // reste libre pour la suivante
+        r->iError = EMBMDATA;
+        p->iNext++;
+        i--;
+        continue;
+      }
+      ulLen++;
+      s->usTid = p->usNextTid++;
+      ucFrame[0] = s->usTid >> 8;
+      ucFrame[1] = s->usTid & 0xFF;
+      ucFrame[2] = ucFrame[3] = 0; // protocole ModBus
+      ucFrame[4] = ulLen >> 8; // longueur : unit id + PDU
+      ucFrame[5] = ulLen & 0xFF;
+      ucFrame[6] = r->iSlave;
+      ulLen += MBAP_HEADER_SIZE - 1;
+      if (p->bDebug) {
+        vPrintFrame ("[%.2X]", ucFrame, ulLen);
+      }
+      p->ulTxLen += ulLen;
+
+      s->iReq = p->iNext++;
+      s->ullSent = ullTimeNowUs();
+      vWheelAdd (&e->xWheel, &s->xTimer.xWheel, s->ullSent +
+                 (r->ullTimeout ? r->ullTimeout : p->ullTimeout));
+      s->bUsed = true;
+      p->iInFlight++;
+      bIsQueued = true;
+    }
+  }
+  return bIsQueued ? iFlush (e, p) : 0;
+}
+
+// -----------------------------------------------------------------------------
+// Fin du lot d'une connexion dont toutes les requêtes sont terminées
+static void
+vCheckDone (xMbEngine * e, xMbPipe * p) {
+  xMbBatch * b = p->xBatch;
+  int i;
+
+  if ( (b == NULL) || (p->iNext < b->iCount) || (p->iInFlight > 0)) {
+    return;
+  }
+  for (i = 0; i < b->iCount; i++) {
+
+    if (b->xReq[i].iError) {
+      b->iResult++;
+    }
+  }
+  p->xBatch = NULL;
+  e->iActive--;
+}
+
+// -----------------------------------------------------------------------------
+// Lot qui ne peut pas démarrer, toutes ses requêtes sont en erreur
+static void
+vFailBatch (xMbBatch * b, int iError) {
+  int i;
+
+  for (i = 0; i < b->iCount; i++) {
+
+    b->xReq[i].iError = iError;
+  }
+  b->iResult = -1;
+  b->iError = iError;
+}
+
+// -----------------------------------------------------------------------------
+// Connexion rompue : les requêtes non terminées du lot sont en erreur
+static void
+vBreak (xMbEngine * e, xMbPipe * p, int iError) {
+  xMbBatch * b = p->xBatch;
+  int i;
+
+  for (i = 0; i < p->iWindow; i++) {
+    xMbSlot * s = &p->xSlots[i];
+
+    if (s->bUsed) {
+
+      vWheelRemove (&e->xWheel, &s->xTimer.xWheel);
+      b->xReq[s->iReq].iError = iError;
+      s->bUsed = false;
+    }
+  }
+  for (i = p->iNext; i < b->iCount; i++) {
+
+    b->xReq[i].iError = iError;
+  }
+  p->iInFlight = 0;
+  p->ulTxLen = 0;
+  b->iResult = -1;
+  b->iError = iError;
+  p->xBatch = NULL;
+  e->iActive--;
+  vUnwatch (e, p);
+}
+
+// -----------------------------------------------------------------------------
+// Lecture des données disponibles et traitement des trames complètes,
+// retourne -1 si connexion rompue
+static int
+iReceive (xMbEngine * e, xMbPipe * p) {
+  ssize_t n;
+  size_t ulPos = 0;
+  uint64_t ullNow;
+
+  n = recv (p->iFd, p->ucRx + p->ulRxLen, sizeof (p->ucRx) - p->ulRxLen, 0);
+  if (n == 0) {
+
+    errno = ECONNRESET;
+    return -1;
+  }
+  if (n < 0) {
+
+    return ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ?
+           0 : -1;
+  }
+  p->ulRxLen += n;
+  ullNow = ullTimeNowUs();
+
+  while (p->ulRxLen - ulPos >= MBAP_HEADER_SIZE) {
+    uint8_t * ucAdu = p->ucRx + ulPos;
+    uint16_t usTid = (ucAdu[0] << 8) | ucAdu[1];
+    size_t ulLen = ( (ucAdu[4] << 8) | ucAdu[5]) + 6;
+    int i;
+
+    if ( (ucAdu[2] != 0) || (ucAdu[3] != 0) ||
+         (ulLen < MBAP_HEADER_SIZE + 1) || (ulLen > MBAP_ADU_MAX)) {
+
+      // protocole autre que ModBus ou flux désynchronisé, impossible de
+      // retrouver le début des trames
+      errno = EMBBADDATA;
+      return -1;
+    }
+    if (p->ulRxLen - ulPos < ulLen) {
+      break;
+    }
+    if (p->bDebug) {
+      vPrintFrame ("<%.2X>", ucAdu, ulLen);
+    }
+
+    for (i = 0; i < p->iWindow; i++) {
+      xMbSlot * s = &p->xSlots[i];
+
+      if ( (s->bUsed) && (s->usTid == usTid)) {
+        xMbRequest * r = &p->xBatch->xReq[s->iReq];
+
+        vWheelRemove (&e->xWheel, &s->xTimer.xWheel);
+        r->iError = iDecodeResponse (r, ucAdu, ulLen);
+        r->ullRtt = ullNow - s->ullSent;
+        s->bUsed = false;
+        p->iInFlight--;
+        break;
+      }
+    }
+    // une réponse sans transaction en attente (arrivée après son timeout) est
+    // ignorée
+    ulPos += ulLen;
+  }
+
+  if (ulPos > 0) {
+
+    memmove (p->ucRx, p->ucRx + ulPos, p->ulRxLen - ulPos);
+    p->ulRxLen -= ulPos;
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Traitement des évènements d'une connexion
+static void
+vOnEvent (xMbEngine * e, xMbPipe * p, bool bIsReadable, bool bIsWritable) {
+
+  if (p->xBatch == NULL) {
+
+    // réponse tardive d'une connexion inactive, lue pour être ignorée
+    if (bIsReadable && (iReceive (e, p) != 0)) {
+
+      // la rupture sera constatée au prochain lot de la connexion
+      vUnwatch (e, p);
+    }
+    return;
+  }
+  if ( (bIsWritable && (iFlush (e, p) != 0)) ||
+       (bIsReadable && (iReceive (e, p) != 0)) ||
+       (iFill (e, p) != 0)) {
+
+    vBreak (e, p, errno);
+    return;
+  }
+  vCheckDone (e, p);
+}
+
+// -----------------------------------------------------------------------------
+// Fin du lot d'un port série, il n'est plus surveillé
+static void
+vRtuDone (xMbEngine * e, xRtuPort * x) {
+
+#ifdef MBPOLL_EPOLL
+  if (e->iFd >= 0) {
+
+    epoll_ctl (e->iFd, EPOLL_CTL_DEL, iMbRtuFd (x->xBatch->xRtu), NULL);
+  }
+#endif
+  x->xBatch = NULL;
+  e->iActive--;
+}
+
+// -----------------------------------------------------------------------------
+// Départ du lot d'un port série
+static void
+vRtuStart (xMbEngine * e, xRtuPort * x, xMbBatch * b) {
+  uint64_t ullNext;
+
+  x->bIsRtu = true;
+  x->xTimer.bIsRtu = true;
+  x->xBatch = b;
+  e->iActive++;
+  ullNext = ullMbRtuStart (b->xRtu, b);
+  if (ullNext == 0) {
+
+    x->xBatch = NULL;
+    e->iActive--;
+    return;
+  }
+#ifdef MBPOLL_EPOLL
+  if (e->iFd >= 0) {
+    struct epoll_event xEv = { .events = EPOLLIN, .data.ptr = x };
+
+    if (epoll_ctl (e->iFd, EPOLL_CTL_ADD, iMbRtuFd (b->xRtu), &xEv) != 0) {
+
+      vMbRtuCancel (b->xRtu, errno);
+      x->xBatch = NULL;
+      e->iActive--;
+      return;
+    }
+  }
+#endif
+  vWheelAdd (&e->xWheel, &x->xTimer.xWheel, ullNext);
+}
+
+// -----------------------------------------------------------------------------
+// Etape suivante d'un port série, à l'arrivée d'octets ou à son échéance
+// (déjà désarmée par la roue)
+static void
+vRtuStep (xMbEngine * e, xRtuPort * x, bool bIsReadable) {
+  uint64_t ullNext;
+
+  if (x->xBatch == NULL) {
+    return;
+  }
+  if (bIsReadable) {
+    vWheelRemove (&e->xWheel, &x->xTimer.xWheel);
+  }
+  ullNext = ullMbRtuStep (x->xBatch->xRtu, bIsReadable);
+  if (ullNext == 0) {
+
+    vRtuDone (e, x);
+    return;
+  }
+  vWheelAdd (&e->xWheel, &x->xTimer.xWheel, ullNext);
+}
+
+// -----------------------------------------------------------------------------
+// Traitement des évènements d'une source, connexion ou port série
+static void
+vOnSource (xMbEngine * e, void * pvSrc, bool bIsReadable, bool bIsWritable) {
+
+  if (* (bool *) pvSrc) {
+
+    vRtuStep (e, (xRtuPort *) pvSrc, bIsReadable);
+  }
+  else {
+
+    vOnEvent (e, (xMbPipe *) pvSrc, bIsReadable, bIsWritable);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Attente et traitement des évènements jusqu'à iMs ms
+static int
+iPoll (xMbEngine * e, xMbBatch * xBatch, int iCount, int iMs) {
+  int i, n;
+
+#ifdef MBPOLL_EPOLL
+  if (e->iFd >= 0) {
+    struct epoll_event xEv[ENGINE_EVENTS];
+
+    n = epoll_wait (e->iFd, xEv, ENGINE_EVENTS, iMs);
+    for (i = 0; i < n; i++) {
+
+      vOnSource (e, xEv[i].data.ptr,
+                 (xEv[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0,
+                 (xEv[i].events & EPOLLOUT) != 0);
+    }
+    return (n < 0) && (errno != EINTR) ? -1 : 0;
+  }
+#endif
+
+  // poll() : seules les connexions et les ports en cours sont surveillés
+  if (e->iPfdSize < iCount) {
+    void * pvPfd = realloc (e->xPfd, iCount * sizeof (struct pollfd));
+    void * pvSrc = pvPfd ? realloc (e->pvPfdSrc, iCount * sizeof (void *)) :
+                   NULL;
+
+    if (pvPfd) {
+      e->xPfd = pvPfd;
+    }
+    if (pvSrc == NULL) {
+      return -1;
+    }
+    e->pvPfdSrc = pvSrc;
+    e->iPfdSize = iCount;
+  }
+  for (i = 0, n = 0; i < iCount; i++) {
+    xMbPipe * p = xBatch[i].xPipe;
+
+    if (xBatch[i].xRtu) {
+
+      if (e->xPorts[i].xBatch) {
+
+        e->xPfd[n].fd = iMbRtuFd (xBatch[i].xRtu);
+        e->xPfd[n].events = POLLIN;
+        e->xPfd[n].revents = 0;
+        e->pvPfdSrc[n++] = &e->xPorts[i];
+      }
+    }
+    else if (p->xBatch) {
+
+      e->xPfd[n].fd = p->iFd;
+      e->xPfd[n].events = POLLIN | (p->ulTxLen ? POLLOUT : 0);
+      e->xPfd[n].revents = 0;
+      e->pvPfdSrc[n++] = p;
+    }
+  }
+  n = poll (e->xPfd, n, iMs);
+  if (n < 0) {
+    return (errno == EINTR) ? 0 : -1;
+  }
+  for (i = 0; n > 0; i++) {
+    short sEv = e->xPfd[i].revents;
+
+    if (sEv) {
+
+      vOnSource (e, e->pvPfdSrc[i], (sEv & (POLLIN | POLLERR | POLLHUP)) != 0,
+                 (sEv & POLLOUT) != 0);
+      n--;
+    }
+  }
+  return 0;
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+size_t
+ulMbPduEncode (const xMbRequest * r, uint8_t * ucPdu) {
+  const uint16_t * usSrc = (const uint16_t *) r->pvSrc;
+  size_t ulLen = 5;
+  int i;
+
+  // les données doivent tenir dans le PDU, leur taille dans un octet
+  if ( ( (r->iFunction == 15) && (BITS_SIZE (r->iCount) > MB_PDU_MAX - 6)) ||
+       ( (r->iFunction == 16) && (r->iCount * 2 > MB_PDU_MAX - 6))) {
+    return 0;
+  }
+
+  ucPdu[0] = r->iFunction;
+  ucPdu[1] = r->iAddr >> 8;
+  ucPdu[2] = r->iAddr & 0xFF;
+  switch (r->iFunction) {
+
+    case 5:
+      // 0xFF00 pour ON, 0x0000 pour OFF
+      ucPdu[3] = bBitsGet (r->pvSrc, 0) ? 0xFF : 0;
+      ucPdu[4] = 0;
+      break;
+
+    case 6:
+      ucPdu[3] = usSrc[0] >> 8;
+      ucPdu[4] = usSrc[0] & 0xFF;
+      break;
+
+    case 15:
+      ucPdu[3] = r->iCount >> 8;
+      ucPdu[4] = r->iCount & 0xFF;
+      ucPdu[5] = BITS_SIZE (r->iCount);
+      // les bits au-delà de iCount dans le dernier octet sont à 0
+      memset (ucPdu + 6, 0, ucPdu[5]);
+      vBitsCopy (ucPdu + 6, 0, r->pvSrc, 0, r->iCount);
+      ulLen = 6 + ucPdu[5];
+      break;
+
+    case 16:
+      ucPdu[3] = r->iCount >> 8;
+      ucPdu[4] = r->iCount & 0xFF;
+      ucPdu[5] = r->iCount * 2;
+      for (i = 0; i < r->iCount; i++) {
+
+        ucPdu[6 + 2 * i] = usSrc[i] >> 8;
+        ucPdu[7 + 2 * i] = usSrc[i] & 0xFF;
+      }
+      ulLen = 6 + ucPdu[5];
+      break;
+
+    default: // lecture
+      ucPdu[3] = r->iCount >> 8;
+      ucPdu[4] = r->iCount & 0xFF;
+      break;
+  }
+  return ulLen;
+}
+
+// -----------------------------------------------------------------------------
+int
+iMbPduDecode (const xMbRequest * r, const uint8_t * ucPdu, size_t ulPduLen) {
+  int i;
+
+  if (ucPdu[0] == (r->iFunction | 0x80)) {
+
+    return (ulPduLen >= 2) ? MODBUS_ENOBASE + ucPdu[1] : EMBBADEXC;
+  }
+  if ( (ucPdu[0] != r->iFunction) || (ulPduLen < 2)) {
+
+    return EMBBADDATA;
+  }
+
+  if (r->iFunction >= 5) {
+    uint8_t ucEcho[MB_PDU_MAX];
+
+    // écho de l'adresse et de la valeur (5 et 6) ou du nombre d'éléments
+    // (15 et 16) de la requête
+    ulMbPduEncode (r, ucEcho);
+    return ( (ulPduLen == 5) && (memcmp (ucPdu, ucEcho, 5) == 0)) ?
+           0 : EMBBADDATA;
+  }
+  if ( (r->iFunction == 1) || (r->iFunction == 2)) {
+
+    if ( (ucPdu[1] != BITS_SIZE (r->iCount)) || (ulPduLen != ucPdu[1] + 2U)) {
+
+      return EMBBADDATA;
+    }
+    // les bits sont déjà compactés dans la trame
+    vBitsCopy (r->pvDest, r->iBit, ucPdu + 2, 0, r->iCount);
+  }
+  else {
+    uint16_t * usDest = (uint16_t *) r->pvDest;
+
+    if ( (ucPdu[1] != r->iCount * 2) || (ulPduLen != ucPdu[1] + 2U)) {
+
+      return EMBBADDATA;
+    }
+    for (i = 0; i < r->iCount; i++) {
+
+      usDest[i] = (ucPdu[2 + 2 * i] << 8) | ucPdu[3 + 2 * i];
+    }
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+xMbPipe *
+xMbPipeOpen (const char * sHost, const char * sPort, int iWindow,
+             double dTimeout, bool bDebug) {
+  struct addrinfo xHints, * xList, * ai;
+  xMbPipe * p;
+  int iErr = ECONNREFUSED, i;
+
+  memset (&xHints, 0, sizeof (xHints));
+  xHints.ai_family = AF_UNSPEC;
+  xHints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo (sHost, sPort, &xHints, &xList) != 0) {
+
+    errno = EHOSTUNREACH;
+    return NULL;
+  }
+
+  p = calloc (1, sizeof (xMbPipe));
+  if (p) {
+    p->xSlots = calloc (iWindow, sizeof (xMbSlot));
+    p->ucTx = malloc (iWindow * MBAP_ADU_MAX);
+  }
+  if ( (p == NULL) || (p->xSlots == NULL) || (p->ucTx == NULL)) {
+
+    vMbPipeClose (p);
+    freeaddrinfo (xList);
+    errno = ENOMEM;
+    return NULL;
+  }
+  p->iWindow = iWindow;
+  p->ullTimeout = (uint64_t) (dTimeout * 1E6);
+  p->bDebug = bDebug;
+  p->iFd = -1;
+  for (i = 0; i < iWindow; i++) {
+
+    p->xSlots[i].xPipe = p;
+  }
+
+  for (ai = xList; ai; ai = ai->ai_next) {
+    int iFd, iRet, iOne = 1;
+
+    iFd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (iFd < 0) {
+      iErr = errno;
+      continue;
+    }
+    fcntl (iFd, F_SETFL, fcntl (iFd, F_GETFL) | O_NONBLOCK);
+    // les requêtes sont petites et doivent partir sans délai
+    setsockopt (iFd, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof (iOne));
+
+    iRet = connect (iFd, ai->ai_addr, ai->ai_addrlen);
+    if ( (iRet < 0) && (errno == EINPROGRESS)) {
+      socklen_t xLen = sizeof (iErr);
+
+      // connexion non bloquante, limitée par le timeout
+      if (iWait (iFd, POLLOUT, ullTimeNowUs() + p->ullTimeout) <= 0) {
+
+        iErr = ETIMEDOUT;
+      }
+      else if ( (getsockopt (iFd, SOL_SOCKET, SO_ERROR, &iErr, &xLen) == 0) &&
+                (iErr == 0)) {
+
+        iRet = 0;
+      }
+    }
+    else if (iRet < 0) {
+
+      iErr = errno;
+    }
+
+    if (iRet == 0) {
+
+      p->iFd = iFd;
+      break;
+    }
+    close (iFd);
+  }
+  freeaddrinfo (xList);
+
+  if (p->iFd < 0) {
+
+    vMbPipeClose (p);
+    errno = iErr;
+    return NULL;
+  }
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+void
+vMbPipeClose (xMbPipe * p) {
+
+  if (p) {
+
+    // la fermeture retire aussi le socket de l'epoll du moteur
+    if (p->iFd >= 0) {
+      close (p->iFd);
+    }
+    free (p->xSlots);
+    free (p->ucTx);
+    free (p);
+  }
+}
+
+// -----------------------------------------------------------------------------
+xMbEngine *
+xMbEngineNew (void) {
+  xMbEngine * e = calloc (1, sizeof (xMbEngine));
+
+  if (e == NULL) {
+
+    errno = ENOMEM;
+    return NULL;
+  }
+  e->iFd = -1;
+#ifdef MBPOLL_EPOLL
+  e->iFd = epoll_create1 (EPOLL_CLOEXEC);
+  if (e->iFd < 0) {
+    int iErr = errno;
+
+    free (e);
+    errno = iErr;
+    return NULL;
+  }
+#endif
+  return e;
+}
+
+// -----------------------------------------------------------------------------
+int
+iMbEngineRun (xMbEngine * e, xMbBatch * xBatch, int iCount) {
+  int i, iBroken = 0;
+
+  vWheelInit (&e->xWheel, ENGINE_TICK, ullTimeNowUs());
+  e->iActive = 0;
+  if (e->iPortsSize < iCount) {
+    void * pv = realloc (e->xPorts, iCount * sizeof (xRtuPort));
+
+    if (pv == NULL) {
+
+      for (i = 0; i < iCount; i++) {
+        vFailBatch (&xBatch[i], ENOMEM);
+      }
+      return iCount;
+    }
+    e->xPorts = pv;
+    e->iPortsSize = iCount;
+  }
+
+  // départ des premières requêtes de chaque connexion et de chaque port
+  for (i = 0; i < iCount; i++) {
+    xMbBatch * b = &xBatch[i];
+    xMbPipe * p = b->xPipe;
+
+    e->xPorts[i].xBatch = NULL;
+    if (b->xRtu) {
+
+      vRtuStart (e, &e->xPorts[i], b);
+      continue;
+    }
+    b->iResult = 0;
+    b->iError = 0;
+    p->xBatch = b;
+    p->iNext = 0;
+    p->iInFlight = 0;
+    p->ulTxLen = 0;
+    e->iActive++;
+    if ( (iWatch (e, p) != 0) || (iFill (e, p) != 0)) {
+
+      vBreak (e, p, errno);
+      continue;
+    }
+    vCheckDone (e, p);
+  }
+
+  while (e->iActive > 0) {
+    uint64_t ullNow = ullTimeNowUs();
+    uint64_t ullNext = ullWheelNext (&e->xWheel);
+    xWheelTimer * t;
+    int iMs;
+
+    iMs = (ullNext <= ullNow) ? 0 :
+          (int) MIN ( (ullNext - ullNow + 999) / 1000, INT32_MAX);
+    if (iPoll (e, xBatch, iCount, iMs) != 0) {
+
+      // le moteur ne peut plus attendre, toutes les connexions et tous les
+      // ports sont rompus
+      int iErr = errno;
+
+      for (i = 0; i < iCount; i++) {
+
+        if (xBatch[i].xRtu) {
+
+          if (e->xPorts[i].xBatch) {
+
+            vWheelRemove (&e->xWheel, &e->xPorts[i].xTimer.xWheel);
+            vMbRtuCancel (xBatch[i].xRtu, iErr);
+            vRtuDone (e, &e->xPorts[i]);
+          }
+        }
+        else if (xBatch[i].xPipe->xBatch) {
+
+          vBreak (e, xBatch[i].xPipe, iErr);
+        }
+      }
+      break;
+    }
+
+    // transactions expirées, la fenêtre de leur connexion se libère, et
+    // échéances des ports série
+    ullNow = ullTimeNowUs();
+    while ( (t = xWheelExpire (&e->xWheel, ullNow)) != NULL) {
+      xMbSlot * s;
+      xMbPipe * p;
+
+      if ( ( (xEngineTimer *) t)->bIsRtu) {
+        xRtuPort * x;
+
+        x = (xRtuPort *) ( (uint8_t *) t - offsetof (xRtuPort, xTimer));
+        vRtuStep (e, x, false);
+        continue;
+      }
+      s = (xMbSlot *) ( (uint8_t *) t - offsetof (xMbSlot, xTimer));
+      p = s->xPipe;
+
+      p->xBatch->xReq[s->iReq].iError = ETIMEDOUT;
+      s->bUsed = false;
+      p->iInFlight--;
+      if (iFill (e, p) != 0) {
+
+        vBreak (e, p, errno);
+        continue;
+      }
+      vCheckDone (e, p);
+    }
+  }
+
+  for (i = 0; i < iCount; i++) {
+
+    if (xBatch[i].iResult < 0) {
+      iBroken++;
+    }
+  }
+  return iBroken;
+}
+
+// -----------------------------------------------------------------------------
+void
+vMbEngineDelete (xMbEngine * e) {
+
+  if (e) {
+
+    if (e->iFd >= 0) {
+      close (e->iFd);
+    }
+    free (e->xPorts);
+    free (e->xPfd);
+    free (e->pvPfdSrc);
+    free (e);
+  }
+}
+
+#endif /* MBPOLL_PIPELINE defined */
+/* ========================================================================== */
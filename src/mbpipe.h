@@ -0,0 +1,171 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_MBPIPE_H_
+#define _MBPOLL_MBPIPE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Client ModBus/TCP pouvant garder plusieurs transactions en cours sur une
+ * même connexion, les réponses sont associées aux requêtes grâce à
+ * l'identifiant de transaction de l'entête MBAP.
+ * Les connexions sont non bloquantes et un moteur d'évènements (epoll sous
+ * Linux, poll ailleurs) fait avancer les transactions de toutes les
+ * connexions et de tous les ports série (mbrtu.h) d'un même thread, les
+ * timeouts et les délais de la ligne série sont gérés par une roue
+ * d'échéances (wheel.h).
+ * Disponible uniquement sur les plateformes POSIX.
+ */
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#define MBPOLL_PIPELINE
+#endif
+#if defined (__linux__)
+#define MBPOLL_EPOLL
+#endif
+
+/* constants ================================================================ */
+/**
+ * Taille maximale d'un PDU, code fonction compris
+ */
+#define MB_PDU_MAX 253
+
+/* structures =============================================================== */
+/**
+ * Connexion ModBus/TCP (opaque)
+ */
+typedef struct xMbPipe xMbPipe;
+
+/**
+ * Port série ModBus RTU (opaque, voir mbrtu.h)
+ */
+typedef struct xMbRtu xMbRtu;
+
+/**
+ * Requête de lecture ou d'écriture
+ *
+ * Les bits lus par les fonctions 1 et 2 sont compactés (voir bits.h) à
+ * partir du bit de rang iBit de pvDest, les registres lus par les fonctions
+ * 3 et 4 sont stockés dans un mot de 16 bits (ordre de l'hôte) chacun.
+ * Les fonctions d'écriture 5 et 15 prennent les bits compactés de pvSrc à
+ * partir du bit 0, les fonctions 6 et 16 ses mots de 16 bits. L'esclave 0
+ * (diffusion) ne répond pas, seul le client RTU l'accepte.
+ */
+typedef struct xMbRequest {
+  int iSlave; /**< adresse de l'esclave (unit identifier) */
+  int iFunction; /**< code fonction ModBus (1 à 6, 15 ou 16) */
+  int iAddr; /**< adresse PDU du premier élément */
+  int iCount; /**< nombre de bits ou de registres */
+  void * pvDest; /**< destination des données lues */
+  int iBit; /**< rang du premier bit dans pvDest (fonctions 1 et 2) */
+  const void * pvSrc; /**< données à écrire (fonctions 5, 6, 15 et 16) */
+  uint64_t ullTimeout; /**< timeout de réponse en µs, 0 pour celui de la connexion */
+  int iError; /**< 0 si succès, errno sinon (codes libmodbus pour les exceptions) */
+  uint64_t ullRtt; /**< temps de réponse mesuré en µs, si une réponse est reçue */
+} xMbRequest;
+
+/**
+ * Moteur d'évènements (opaque)
+ */
+typedef struct xMbEngine xMbEngine;
+
+/**
+ * Lot de requêtes à exécuter sur une connexion
+ */
+typedef struct xMbBatch {
+  xMbPipe * xPipe; /**< connexion, NULL pour un port série */
+  xMbRtu * xRtu; /**< port série, NULL pour une connexion */
+  xMbRequest * xReq; /**< requêtes, exécutées dans l'ordre */
+  int iCount; /**< nombre de requêtes */
+  int iResult; /**< nombre de requêtes en erreur, -1 si la connexion est rompue */
+  int iError; /**< errno si la connexion est rompue */
+} xMbBatch;
+
+/* internal public functions ================================================ */
+
+/**
+ * Codage du PDU d'une requête
+ *
+ * Partagé avec le client RTU (mbrtu.h).
+ *
+ * @param ucPdu reçoit le PDU, MB_PDU_MAX octets au plus
+ * @return la taille du PDU, 0 si les données à écrire n'y tiennent pas
+ */
+size_t ulMbPduEncode (const xMbRequest * xReq, uint8_t * ucPdu);
+
+/**
+ * Décodage du PDU de la réponse à une requête
+ *
+ * Partagé avec le client RTU (mbrtu.h), les données lues sont stockées dans
+ * pvDest. La réponse à une écriture reprend l'adresse et la valeur ou le
+ * nombre d'éléments de la requête.
+ *
+ * @param ucPdu PDU de la réponse (code fonction, puis données)
+ * @param ulPduLen taille du PDU, 1 au moins
+ * @return 0 ou le code d'erreur de la requête (codes libmodbus)
+ */
+int iMbPduDecode (const xMbRequest * xReq, const uint8_t * ucPdu,
+                  size_t ulPduLen);
+
+/**
+ * Ouverture d'une connexion
+ *
+ * @param sHost nom ou adresse IP de l'hôte
+ * @param sPort numéro ou nom du service TCP
+ * @param iWindow nombre maximal de transactions en cours
+ * @param dTimeout timeout de connexion et de réponse en secondes
+ * @param bDebug affiche les trames échangées
+ * @return la connexion, NULL si erreur (errno est positionné)
+ */
+xMbPipe * xMbPipeOpen (const char * sHost, const char * sPort, int iWindow,
+                       double dTimeout, bool bDebug);
+
+/**
+ * Fermeture de la connexion et libération des ressources
+ */
+void vMbPipeClose (xMbPipe * xPipe);
+
+/**
+ * Création d'un moteur d'évènements
+ *
+ * @return le moteur, NULL si erreur (errno est positionné)
+ */
+xMbEngine * xMbEngineNew (void);
+
+/**
+ * Exécution simultanée de lots de requêtes, un par connexion ou port série
+ *
+ * Sur chaque connexion, jusqu'à iWindow requêtes sont envoyées sans attendre
+ * les réponses, une nouvelle requête part dès qu'une réponse arrive ou qu'un
+ * timeout expire. Sur un port série, les requêtes partent l'une après
+ * l'autre, chacune après un silence de t3.5 sur la ligne. Le résultat de
+ * chaque requête est stocké dans son champ iError, celui de chaque lot dans
+ * iResult et iError. Une connexion ou un port rompu n'interrompt pas les
+ * autres, ses requêtes non abouties sont en erreur.
+ * Une même connexion ou un même port ne peut figurer que dans un lot.
+ *
+ * @return le nombre de connexions et de ports rompus
+ */
+int iMbEngineRun (xMbEngine * xEngine, xMbBatch * xBatch, int iCount);
+
+/**
+ * Libération d'un moteur d'évènements, les connexions ne sont pas fermées
+ */
+void vMbEngineDelete (xMbEngine * xEngine);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_MBPIPE_H_ */
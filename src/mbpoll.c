@@ -24,6 +24,7 @@
 #include <getopt.h>
 #include <signal.h>
 #include <float.h>
+#include <math.h>
 #include <inttypes.h>
 #include <assert.h>
 #include <modbus.h>
@@ -39,6 +40,21 @@
 #endif
 #include "serial.h"
 #include "custom-rts.h"
+#include "workers.h"
+#include "mbpipe.h"
+#include "mbrtu.h"
+#include "timing.h"
+#include "plan.h"
+#include "bits.h"
+#include "rto.h"
+#include "histo.h"
+#include "counters.h"
+#include "outbuf.h"
+#include "fmt.h"
+#include "decode.h"
+#include "capture.h"
+#include "shm.h"
+#include "ring.h"
 #include "version-git.h"
 #include "mbpoll-config.h"
 
@@ -97,9 +113,45 @@ typedef enum {
   eFormatInt,
   eFormatFloat,
   eFormatBin,
+  eFormatMask,
+  eFormatUInt32,
+  eFormatInt64,
+  eFormatDouble,
   eFormatUnknown = -1,
 } eFormats;
 
+typedef enum {
+  eOutputText,
+  eOutputJsonl,
+  eOutputCsv,
+  eOutputUnknown = -1,
+} eOutputs;
+
+// Options longues, sans équivalent court
+typedef enum {
+  eOptWorkers = 0x100,
+  eOptPipeline,
+  eOptCoalesce,
+  eOptEvery,
+  eOptAdaptiveTimeout,
+  eOptDownAfter,
+  eOptReport,
+  eOptOutput,
+  eOptNoBanner,
+  eOptOrder,
+  eOptOnChange,
+  eOptCapture,
+  eOptReplay,
+  eOptRealtime,
+  eOptShm,
+  eOptQueue,
+  eOptOverflow,
+  eOptBus,
+  eOptGateway,
+  eOptBroadcast,
+  eOptRtuGap,
+} eLongOptions;
+
 /* macros =================================================================== */
 #define SIZEOF_ILIST(list) (sizeof(list)/sizeof(int))
 /*
@@ -110,6 +162,15 @@ typedef enum {
 #define DUINT16(p,i) ((uint16_t *)(p))[i]
 #define DINT32(p,i) ((int32_t *)(p))[i]
 #define DFLOAT(p,i) ((float *)(p))[i]
+#define DUINT32(p,i) ((uint32_t *)(p))[i]
+#define DINT64(p,i) ((int64_t *)(p))[i]
+#define DDOUBLE(p,i) ((double *)(p))[i]
+
+// Ajout au tampon b de la valeur v convertie par une fonction de fmt.h
+#define PUT_FMT(b,func,v) do { \
+    char * _p = pcOutBufReserve ((b), FMT_MAX); \
+    if (_p) vOutBufCommit ((b), func (_p, (v))); \
+  } while (0)
 
 /* constants ================================================================ */
 static const char * sModeList[] = {
@@ -151,13 +212,19 @@ static const char * sFormatList[] = {
   "int16",
   "hex",
   "string",
-  "int"
+  "int",
+  "mask",
+  "uint32",
+  "int64"
 };
 static const int iFormatList[] = {
   eFormatInt16,
   eFormatHex,
   eFormatString,
-  eFormatInt
+  eFormatInt,
+  eFormatMask,
+  eFormatUInt32,
+  eFormatInt64
 };
 #else
 static const char * sFormatList[] = {
@@ -165,16 +232,56 @@ static const char * sFormatList[] = {
   "hex",
   "string",
   "int",
-  "float"
+  "float",
+  "mask",
+  "uint32",
+  "int64",
+  "double"
 };
 static const int iFormatList[] = {
   eFormatInt16,
   eFormatHex,
   eFormatString,
   eFormatInt,
-  eFormatFloat
+  eFormatFloat,
+  eFormatMask,
+  eFormatUInt32,
+  eFormatInt64,
+  eFormatDouble
 };
 #endif
+static const char * sOutputList[] = {
+  "text",
+  "jsonl",
+  "csv"
+};
+static const int iOutputList[] = {
+  eOutputText,
+  eOutputJsonl,
+  eOutputCsv
+};
+static const char * sOrderList[] = {
+  "abcd",
+  "cdab",
+  "badc",
+  "dcba"
+};
+static const int iOrderList[] = {
+  eOrderAbcd,
+  eOrderCdab,
+  eOrderBadc,
+  eOrderDcba
+};
+static const char * sOverflowList[] = {
+  "block",
+  "drop-oldest",
+  "count"
+};
+static const int iOverflowList[] = {
+  eRingBlock,
+  eRingDropOldest,
+  eRingCount
+};
 static const char * sFunctionList[] = {
   "discrete output (coil)",
   "discrete input",
@@ -197,6 +304,21 @@ static const char sRtuBaudrateStr[] = "rtu baudrate";
 static const char sTcpPortStr[] = "tcp port";
 static const char sTimeoutStr[] = "timeout";
 static const char sPollRateStr[] = "poll rate";
+static const char sWorkersStr[] = "workers";
+static const char sPipelineStr[] = "pipeline window";
+static const char sCoalesceStr[] = "coalesce gap";
+static const char sEveryStr[] = "scan period";
+static const char sRtoMinStr[] = "minimal time-out";
+static const char sDownAfterStr[] = "failure count";
+static const char sReportStr[] = "report period";
+static const char sOutputStr[] = "output";
+static const char sOrderStr[] = "byte order";
+static const char sDeadbandStr[] = "deadband";
+static const char sQueueStr[] = "queue size";
+static const char sOverflowStr[] = "overflow policy";
+static const char sBusStr[] = "bus";
+static const char sGatewayStr[] = "gateway";
+static const char sRtuGapStr[] = "rtu gap";
 static const char sFunctionStr[] = "function";
 static const char sFormatStr[] = "format";
 static const char sNumOfValuesStr[] = "number of values";
@@ -204,10 +326,11 @@ static const char sStartRefStr[] = "start reference";
 static const char sDataStr[] = "data";
 static const char sUnknownStr[] = "unknown";
 static const char sIntStr[] = "32-bit integer";
+static const char sUInt32Str[] = "32-bit unsigned integer";
 static const char sFloatStr[] = "32-bit float";
+static const char sInt64Str[] = "64-bit integer";
+static const char sDoubleStr[] = "64-bit float";
 static const char sWordStr[] = "16-bit register";
-static const char sLittleEndianStr[] = "(little endian)";
-static const char sBigEndianStr[] = "(big endian)";
 static char * progname;
 
 #ifdef MBPOLL_GPIO_RTS
@@ -217,6 +340,89 @@ static const char sRtsPinStr[] = "RTS pin";
 /* structures =============================================================== */
 typedef struct xChipIoContext xChipIoContext;
 
+// Bande morte d'une référence de départ (--on-change)
+typedef struct xDeadband {
+  double dValue; // écart absolu, ou pourcentage de la dernière valeur signalée
+  bool bIsPercent;
+} xDeadband;
+
+// Résultat de la lecture d'un esclave pour un cycle de scrutation
+typedef struct xSlave {
+  int iAddr;
+  void * pvData; // un bloc de données par référence de départ
+  int * piError; // 0 si la lecture a réussi, errno sinon
+  void * pvImage; // image lue par le plan, pvData si identique aux blocs
+  int * piReadError; // résultat de chaque requête du plan
+  xRto xRto; // estimation du timeout de réponse (--adaptive-timeout)
+  xHisto xLatency; // temps de réponse des requêtes, en µs
+  xCounters xCounters; // résultat et volume des requêtes
+  // état de santé (--down-after)
+  bool bIsDown; // esclave hors service, interrogé seulement aux sondages
+  bool bIsSkipped; // esclave ignoré pendant le cycle courant
+  int iFailures; // nombre de scrutations consécutives sans réponse
+  int iBackoff; // intervalle entre deux sondages, en cycles
+  int iNextProbe; // cycle du prochain sondage
+  int iDownCount; // nombre de passages hors service
+  uint64_t ullTime; // heure de fin de la dernière scrutation, en µs (UTC)
+  int iBus; // rang du bus de l'esclave dans xBuses (--bus)
+  // signalement par exception (--on-change)
+  void * pvReported; // dernières valeurs signalées, décodées, un bloc par référence
+  bool * pbIsReported; // vrai si le bloc de pvReported est valide
+  int * piReportedError; // dernière erreur signalée, 0 si aucune
+} xSlave;
+
+// Etat d'un esclave pour un cycle en attente d'affichage (--queue)
+typedef struct xQueuedSlave {
+  uint64_t ullTime;
+  bool bIsSkipped;
+} xQueuedSlave;
+
+// Résultat de l'écriture vers un esclave
+typedef struct xTarget {
+  int iAddr;
+  int iBus; // rang du bus ou de la passerelle dans xBuses
+  int iError; // 0 si l'écriture a réussi, errno sinon
+  uint64_t ullRtt; // temps de réponse, en µs
+} xTarget;
+
+// Port série scruté en parallèle des autres (--bus), ou passerelle ModBus
+// TCP vers RTU qui donne accès à un port série (--gateway). Le premier est
+// celui de la ligne de commande.
+typedef struct xSerialBus {
+  char * sDevice; // port série ou hôte de la passerelle
+  char * sTcpPort; // port TCP de la passerelle, celui de -p si NULL
+  bool bIsGateway;
+  char * sName; // nom dans les sorties, avec le port TCP d'une passerelle
+  xSerialIos xIos;
+  bool bHasIos; // configuration de ligne propre, sinon celle de -b -d -s -P
+  int * piSlaveAddr; // libérée une fois les listes réunies dans piSlaveAddr
+  int iFirst; // rang du premier esclave du bus dans xSlaves
+  int iSlaveCount;
+} xSerialBus;
+
+// Connexion utilisée pour la scrutation, une par thread de travail
+typedef struct xLink {
+  modbus_t * xBus;
+  const char * sDevice; // port série ou hôte TCP de la connexion
+  const char * sTcpPort;
+  const char * sName; // nom dans les messages
+#ifdef MBPOLL_PIPELINE
+  xMbPipe * xPipe; // NULL si les requêtes ne sont pas pipelinées
+  xMbRequest * xReq; // lot de requêtes, une par esclave et référence
+#endif
+#ifdef MBPOLL_RTU
+  xMbRtu * xRtu; // port série géré sans libmodbus, NULL si aucun ou fermé
+  const xSerialIos * xIos; // configuration de la ligne pour la réouverture
+#endif
+  // reconnexion, temps en µs
+  bool bIsDown; // connexion rompue
+  uint64_t ullDownSince; // instant de la rupture
+  uint64_t ullNextAttempt; // instant de la prochaine tentative
+  uint64_t ullBackoff; // délai avant la tentative suivante
+  uint64_t ullDownTime; // durée cumulée sans connexion
+  int iReconnectCount;
+} xLink;
+
 typedef struct xMbPollContext {
 
   // Paramètres
@@ -246,8 +452,32 @@ typedef struct xMbPollContext {
   int iPduOffset;
   bool bWriteSingleAsMany;
   bool bIsChipIo;
-  bool bIsBigEndian;
+  eDecodeOrder eOrder; // ordre des octets des valeurs de 32 et 64 bits
   bool bIsQuiet;
+  int iWorkers;
+  int iPipeline;
+  int iCoalesceGap;
+  int * piEvery;
+  int iEveryCount;
+  double dRtoMin;
+  int iDownAfter;
+  int iReportPeriod;
+  eOutputs eOutput;
+  bool bIsBanner;
+  bool bIsOnChange;
+  xDeadband * xDeadbands; // une par référence de départ, NULL si aucune
+  int iDeadbandCount;
+  char * sCaptureFile;
+  char * sReplayFile;
+  bool bIsRealtime;
+  char * sShmName;
+  int iQueueSize; // 0 si l'affichage se fait dans la boucle de scrutation
+  eRingPolicy eOverflow;
+  bool bIsNativeRtu; // lectures RTU par mbrtu.c plutôt que par libmodbus
+  xSerialBus * xBuses; // un par lien de scrutation, NULL sans --bus
+  int iBusCount;
+  bool bIsBroadcast; // écriture diffusée à tous les esclaves RTU
+  int iRtuGap; // silence maximal dans une réponse RTU (t1.5), 0 si défaut
 #ifdef MBPOLL_GPIO_RTS
   int iRtsPin;
 #endif
@@ -255,9 +485,38 @@ typedef struct xMbPollContext {
   // Variables de travail
   modbus_t * xBus;
   void * pvData;
-  int iTxCount;
-  int iRxCount;
+  size_t ulDataSize;
+  void * pvDecoded; // bloc converti en valeurs de 32 ou 64 bits de l'hôte
+  int iValueWords; // nombre de registres par valeur (1, 2 ou 4)
+  int iElemBits;
+  int iNbReg;
+  xPollPlan * xPlan;
+  xSlave * xSlaves;
+  xTarget * xTargets; // un par esclave en écriture
+  xLink * xLinks;
+#ifdef MBPOLL_PTHREAD
+  xWorkerPool * xPool;
+#endif
+#ifdef MBPOLL_PIPELINE
+  xMbEngine * xEngine; // fait avancer les connexions pipelinées
+#endif
   int iErrorCount;
+  uint64_t ullStartTime; // début de la scrutation, en µs
+  uint64_t ullNextCycle; // échéance absolue du prochain cycle, en µs
+  int iCycleCount;
+  int iOverrunCount;
+  uint64_t ullMaxOverrun; // plus grand dépassement d'échéance, en µs
+  uint64_t ullNextReport; // échéance du prochain rapport périodique, en µs
+  xOutBuf xOut; // enregistrements du cycle en cours (--output)
+  xCapture * xCapture; // capture en cours d'écriture ou de relecture
+#ifdef MBPOLL_SHM
+  xShm * xShm; // image publiée en mémoire partagée (--shm)
+#endif
+#ifdef MBPOLL_PTHREAD
+  xRing * xQueue; // cycles en attente d'affichage (--queue)
+#endif
+  size_t ulQueueErrorOffset; // position des erreurs dans une entrée de xQueue
+  size_t ulQueueDataOffset; // position des blocs dans une entrée de xQueue
 
   xChipIoContext * xChip; // TODO: séparer la partie chipio
 } xMbPollContext;
@@ -294,15 +553,41 @@ static xMbPollContext ctx = {
   .iPduOffset = 1,
   .bWriteSingleAsMany = false,
   .bIsChipIo = false,
-  .bIsBigEndian = false,
+  .eOrder = eOrderCdab,
   .bIsQuiet = false,
+  .iWorkers = DEFAULT_WORKERS,
+  .iPipeline = 0,
+  .iCoalesceGap = -1,
+  .piEvery = NULL,
+  .iEveryCount = 0,
+  .dRtoMin = 0,
+  .iDownAfter = 0,
+  .iReportPeriod = 0,
+  .eOutput = eOutputText,
+  .bIsBanner = true,
+  .bIsOnChange = false,
+  .xDeadbands = NULL,
+  .iDeadbandCount = 0,
+  .sCaptureFile = NULL,
+  .sReplayFile = NULL,
+  .bIsRealtime = false,
+  .sShmName = NULL,
+  .iQueueSize = 0,
+  .eOverflow = eRingBlock,
+  .xBuses = NULL,
+  .iBusCount = 0,
+  .bIsBroadcast = false,
+  .iRtuGap = 0,
 #ifdef MBPOLL_GPIO_RTS
   .iRtsPin = -1,
 #endif
 
   // Variables de travail
   .xBus = NULL,
-  .pvData = NULL
+  .pvData = NULL,
+  .iValueWords = 1,
+  .xPlan = NULL,
+  .xSlaves = NULL
 };
 
 #ifdef USE_CHIPIO
@@ -336,9 +621,110 @@ static const char * short_options = "m:a:r:c:t:1l:o:p:b:d:s:P:u0WRFhVvwBq";
 // -----------------------------------------------------------------------------
 #endif /* USE_CHIPIO == 0 */
 
+static const struct option long_options[] = {
+  {"workers", required_argument, NULL, eOptWorkers},
+  {"pipeline", required_argument, NULL, eOptPipeline},
+  {"coalesce", optional_argument, NULL, eOptCoalesce},
+  {"every", required_argument, NULL, eOptEvery},
+  {"adaptive-timeout", optional_argument, NULL, eOptAdaptiveTimeout},
+  {"down-after", required_argument, NULL, eOptDownAfter},
+  {"report", required_argument, NULL, eOptReport},
+  {"output", required_argument, NULL, eOptOutput},
+  {"no-banner", no_argument, NULL, eOptNoBanner},
+  {"order", required_argument, NULL, eOptOrder},
+  {"on-change", optional_argument, NULL, eOptOnChange},
+  {"capture", required_argument, NULL, eOptCapture},
+  {"replay", required_argument, NULL, eOptReplay},
+  {"realtime", no_argument, NULL, eOptRealtime},
+  {"shm", required_argument, NULL, eOptShm},
+  {"queue", required_argument, NULL, eOptQueue},
+  {"overflow", required_argument, NULL, eOptOverflow},
+  {"bus", required_argument, NULL, eOptBus},
+  {"gateway", required_argument, NULL, eOptGateway},
+  {"broadcast", no_argument, NULL, eOptBroadcast},
+  {"rtu-gap", required_argument, NULL, eOptRtuGap},
+  {NULL, 0, NULL, 0}
+};
+
 /* private functions ======================================================== */
 void vAllocate (xMbPollContext * ctx);
-void vPrintReadValues (int iAddr, int iCount, xMbPollContext * ctx);
+void vAllocateSlaves (xMbPollContext * ctx);
+void vBuildPlan (xMbPollContext * ctx);
+void vFreeSlaves (xMbPollContext * ctx);
+void vAllocateTargets (xMbPollContext * ctx);
+int iPollSlave (modbus_t * xBus, xSlave * xSlv, const xMbPollContext * ctx);
+int iPollSlaves (xLink * xLnk, xSlave * xSlv, int iCount,
+                 const xMbPollContext * ctx);
+void vPrintSlave (xSlave * xSlv, int iCycle, xMbPollContext * ctx);
+void vEndSlavePoll (xSlave * xSlv, xMbPollContext * ctx);
+void vPrintReadValues (xOutBuf * xBuf, int iAddr, int iCount,
+                       const void * pvData, const xMbPollContext * ctx);
+void vPrintReadLine (xOutBuf * xBuf, int iAddr, int iCount,
+                     const void * pvData, int i, const xMbPollContext * ctx);
+int iLineValues (const xMbPollContext * ctx);
+int iPrintChanges (xSlave * xSlv, int j, const void * pvData,
+                   xMbPollContext * ctx);
+void vSetResponseTimeout (modbus_t * xBus, double dTimeout);
+void vRecordTransaction (xSlave * xSlv, int iCount, int iError,
+                         uint64_t ullRtt,
+                         const xMbPollContext * ctx);
+void vPrintLatency (const xMbPollContext * ctx, int iFirst, int iCount,
+                    FILE * f);
+void vPrintTraffic (const xMbPollContext * ctx, int iFirst, int iCount,
+                    const xSerialIos * xIos, FILE * f);
+void vPrintBuses (const xMbPollContext * ctx, const char * sTitle, FILE * f);
+const char * sSlaveName (const xSlave * xSlv, const xMbPollContext * ctx);
+void vPrintRecord (const xSlave * xSlv, int j, const void * pvData,
+                   int iFirst, int iNum, xMbPollContext * ctx);
+void vPrintCsvHeader (xMbPollContext * ctx);
+void vFlushOutput (xMbPollContext * ctx);
+void vSetDeadbands (xMbPollContext * ctx);
+void vCreateCapture (xMbPollContext * ctx);
+void vCaptureSlaves (xMbPollContext * ctx);
+void vReplay (xMbPollContext * ctx);
+#ifdef MBPOLL_SHM
+void vCreateShm (xMbPollContext * ctx);
+void vPublishSlaves (xMbPollContext * ctx);
+#endif
+#ifdef MBPOLL_PTHREAD
+void vCreateQueue (xMbPollContext * ctx);
+void vQueueCycle (xMbPollContext * ctx);
+#endif
+bool bIsResponse (int iError);
+void vSelectSlaves (xMbPollContext * ctx);
+void vUpdateHealth (xSlave * xSlv, const xMbPollContext * ctx);
+void vOpenLinks (xMbPollContext * ctx);
+bool bIsLinkError (int iError);
+void vLinkDown (xLink * xLnk, int iError, const xMbPollContext * ctx);
+bool bLinkIsUp (xLink * xLnk, const xMbPollContext * ctx);
+void vFailSlave (xSlave * xSlv, int iError, const xMbPollContext * ctx);
+#ifdef MBPOLL_PIPELINE
+void vPrepareBatch (xMbBatch * xBatch, xLink * xLnk, xSlave * xSlv, int iCount,
+                    const xMbPollContext * ctx);
+void vEndBatch (const xMbBatch * xBatch, xLink * xLnk, xSlave * xSlv,
+                int iCount, const xMbPollContext * ctx);
+void vPollLinks (xMbPollContext * ctx);
+void vPrepareWrites (xMbBatch * xBatch, xLink * xLnk, xTarget * xTgt,
+                     int iCount, const xMbPollContext * ctx);
+void vEndWrites (const xMbBatch * xBatch, xLink * xLnk, xTarget * xTgt,
+                 int iCount, const xMbPollContext * ctx);
+void vWriteLinks (xMbPollContext * ctx);
+#endif
+void vCloseLinks (xMbPollContext * ctx);
+void vLinkRanges (const xMbPollContext * ctx, int * piFirst);
+int iWriteFunctionCode (const xMbPollContext * ctx);
+void vWriteSlave (modbus_t * xBus, xTarget * xTgt, const xMbPollContext * ctx);
+void vFailTargets (xTarget * xTgt, int iCount, int iError);
+void vWriteSlaves (xLink * xLnk, xTarget * xTgt, int iCount,
+                   const xMbPollContext * ctx);
+void vWriteTargets (xMbPollContext * ctx);
+void vPrintWrites (xMbPollContext * ctx, uint64_t ullElapsed);
+#ifdef MBPOLL_PTHREAD
+void vPollSlaveJob (void * pvWorker, int iIndex, void * pvUser);
+void vWriteSlaveJob (void * pvWorker, int iIndex, void * pvUser);
+#endif
+void vAddBus (xMbPollContext * ctx, char * sSpec, bool bIsGateway);
+void vMergeBuses (xMbPollContext * ctx);
 void vPrintConfig (const xMbPollContext * ctx);
 void vPrintCommunicationSetup (const xMbPollContext * ctx);
 void vReportSlaveID (const xMbPollContext * ctx);
@@ -354,6 +740,10 @@ void vCheckIntRange (const char * sName, int i, int min, int max);
 void vCheckDoubleRange (const char * sName, double d, double min, double max);
 int iGetInt (const char * sName, const char * sNum, int iBase);
 int * iGetIntList (const char * sName, const char * sList, int * iLen);
+xDeadband * xGetDeadbandList (const char * sName, const char * sList,
+                              int * iLen);
+void vGetSerialLine (const char * sName, const char * sLine,
+                     xSerialIos * xIos);
 void vPrintIntList (int * iList, int iLen);
 double dGetDouble (const char * sName, const char * sNum);
 int iGetEnum (const char * sName, char * sElmt, const char ** psStrList,
@@ -361,11 +751,17 @@ int iGetEnum (const char * sName, char * sElmt, const char ** psStrList,
 const char * sEnumToStr (int iElmt, const int * iList,
                          const char ** psStrList, int iSize);
 const char * sFunctionToStr (eFunctions eFunction);
+int iFunctionCode (eFunctions eFunction);
 const char * sModeToStr (eModes eMode);
 void vSigIntHandler (int sig);
-float fSwapFloat (float f);
-int32_t lSwapLong (int32_t l);
+void vSetSignals (void);
+int iFormatWords (eFormats eFormat);
+void vPrintValueType (const xMbPollContext * ctx);
+const void * pvDecodeBlock (const void * pvBlock, const xMbPollContext * ctx);
+int64_t llGetInt64 (const char * name, const char * num);
 void mb_delay (unsigned long d);
+void vWaitNextCycle (xMbPollContext * ctx);
+bool bIsCycleDue (const xMbPollContext * ctx);
 
 #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
 // Portage des fonctions Microsoft
@@ -441,14 +837,14 @@ index (const char *s, int c) {
 
 int
 main (int argc, char **argv) {
-  int iNextOption, iRet = 0;
+  int iNextOption;
   char * p;
 
   progname = argv[0];
 
   do  {
 
-    iNextOption = getopt (argc, argv, short_options);
+    iNextOption = getopt_long (argc, argv, short_options, long_options, NULL);
     opterr = 0;
     switch (iNextOption) {
 
@@ -499,7 +895,7 @@ main (int argc, char **argv) {
         break;
 
       case 'B':
-        ctx.bIsBigEndian = true;
+        ctx.eOrder = eOrderAbcd;
         break;
 
       case 'R':
@@ -545,6 +941,115 @@ main (int argc, char **argv) {
         ctx.bIsQuiet = true;
         break;
 
+      case eOptWorkers:
+        ctx.iWorkers = iGetInt (sWorkersStr, optarg, 0);
+        vCheckIntRange (sWorkersStr, ctx.iWorkers, WORKERS_MIN, WORKERS_MAX);
+        break;
+
+      case eOptPipeline:
+        ctx.iPipeline = iGetInt (sPipelineStr, optarg, 0);
+        vCheckIntRange (sPipelineStr, ctx.iPipeline, PIPELINE_MIN, PIPELINE_MAX);
+        break;
+
+      case eOptCoalesce:
+        ctx.iCoalesceGap = DEFAULT_COALESCE_GAP;
+        if (optarg) {
+          ctx.iCoalesceGap = iGetInt (sCoalesceStr, optarg, 0);
+          vCheckIntRange (sCoalesceStr, ctx.iCoalesceGap,
+                          COALESCE_GAP_MIN, COALESCE_GAP_MAX);
+        }
+        break;
+
+      case eOptEvery:
+        ctx.piEvery = iGetIntList (sEveryStr, optarg, &ctx.iEveryCount);
+        break;
+
+      case eOptAdaptiveTimeout:
+        ctx.dRtoMin = DEFAULT_RTO_MIN;
+        if (optarg) {
+          ctx.dRtoMin = dGetDouble (sRtoMinStr, optarg);
+          vCheckDoubleRange (sRtoMinStr, ctx.dRtoMin, TIMEOUT_MIN, TIMEOUT_MAX);
+        }
+        break;
+
+      case eOptDownAfter:
+        ctx.iDownAfter = iGetInt (sDownAfterStr, optarg, 0);
+        vCheckIntRange (sDownAfterStr, ctx.iDownAfter,
+                        DOWN_AFTER_MIN, DOWN_AFTER_MAX);
+        break;
+
+      case eOptReport:
+        ctx.iReportPeriod = iGetInt (sReportStr, optarg, 0);
+        vCheckIntRange (sReportStr, ctx.iReportPeriod,
+                        REPORT_PERIOD_MIN, REPORT_PERIOD_MAX);
+        break;
+
+      case eOptOutput:
+        ctx.eOutput = iGetEnum (sOutputStr, optarg, sOutputList, iOutputList,
+                                SIZEOF_ILIST (iOutputList));
+        break;
+
+      case eOptNoBanner:
+        ctx.bIsBanner = false;
+        break;
+
+      case eOptOrder:
+        ctx.eOrder = iGetEnum (sOrderStr, optarg, sOrderList, iOrderList,
+                               SIZEOF_ILIST (iOrderList));
+        break;
+
+      case eOptOnChange:
+        ctx.bIsOnChange = true;
+        if (optarg) {
+          ctx.xDeadbands = xGetDeadbandList (sDeadbandStr, optarg,
+                                             &ctx.iDeadbandCount);
+        }
+        break;
+
+      case eOptCapture:
+        ctx.sCaptureFile = optarg;
+        break;
+
+      case eOptReplay:
+        ctx.sReplayFile = optarg;
+        break;
+
+      case eOptRealtime:
+        ctx.bIsRealtime = true;
+        break;
+
+      case eOptShm:
+        ctx.sShmName = optarg;
+        break;
+
+      case eOptQueue:
+        ctx.iQueueSize = iGetInt (sQueueStr, optarg, 0);
+        vCheckIntRange (sQueueStr, ctx.iQueueSize, QUEUE_SIZE_MIN,
+                        QUEUE_SIZE_MAX);
+        break;
+
+      case eOptOverflow:
+        ctx.eOverflow = iGetEnum (sOverflowStr, optarg, sOverflowList,
+                                  iOverflowList, SIZEOF_ILIST (iOverflowList));
+        break;
+
+      case eOptBus:
+        vAddBus (&ctx, optarg, false);
+        break;
+
+      case eOptGateway:
+        vAddBus (&ctx, optarg, true);
+        break;
+
+      case eOptBroadcast:
+        ctx.bIsBroadcast = true;
+        break;
+
+      case eOptRtuGap:
+        ctx.iRtuGap = iGetInt (sRtuGapStr, optarg, 0);
+        vCheckIntRange (sRtuGapStr, ctx.iRtuGap, RTU_GAP_MIN, RTU_GAP_MAX);
+        break;
+
         // TCP -----------------------------------------------------------------
       case 'p':
         ctx.sTcpPort = optarg;
@@ -606,6 +1111,19 @@ main (int argc, char **argv) {
   }
   while (iNextOption != -1);
 
+  if (ctx.sReplayFile) {
+
+    // la capture fournit le reste de la configuration
+    if (optind != argc) {
+      vSyntaxErrorExit ("--replay does not take a device, host or data");
+    }
+    vReplay (&ctx);
+  }
+  if (ctx.bIsRealtime) {
+
+    vSyntaxErrorExit ("--realtime is available only with --replay");
+  }
+
   if (ctx.iStartCount == -1) {
     ctx.piStartRef = malloc (sizeof (int));
     assert (ctx.piStartRef);
@@ -632,10 +1150,17 @@ main (int argc, char **argv) {
     ctx.iCount = 1;
   }
 
-  // Coils et Discrete inputs toujours en binaire
+  // Coils et Discrete inputs en binaire, sauf affichage compacté
   if ( (ctx.eFunction == eFuncCoil) || (ctx.eFunction == eFuncDiscreteInput)) {
 
-    ctx.eFormat = eFormatBin;
+    if ( (ctx.eFormat != eFormatHex) && (ctx.eFormat != eFormatMask)) {
+
+      ctx.eFormat = eFormatBin;
+    }
+  }
+  else if (ctx.eFormat == eFormatMask) {
+
+    vSyntaxErrorExit ("mask format is only available for coils and discrete inputs");
   }
 
   // Lecture du port série ou de l'hôte
@@ -736,22 +1261,41 @@ main (int argc, char **argv) {
             // 1 octets contient 8 coils
             iValue = iGetInt (sDataStr, argv[arg], 10);
             vCheckIntRange (sDataStr, iValue, 0, 1);
-            DUINT8 (ctx.pvData, i) = (uint8_t) iValue;
-            PDEBUG ("Byte[%d]=%d\n", i, DUINT8 (ctx.pvData, i));
+            vBitsSet (ctx.pvData, i, iValue);
+            PDEBUG ("Bit[%d]=%d\n", i, iValue);
             break;
             break;
 
           case eFuncHoldingReg:
+            // les valeurs de 32 et 64 bits sont converties en registres
+            // après la boucle
             if (ctx.eFormat == eFormatInt) {
-              DINT32 (ctx.pvData, i) = lSwapLong (iGetInt (sDataStr, argv[arg], 10));
-              PDEBUG ("Int[%d]=%"PRId32"\n", i, lSwapLong (DINT32 (ctx.pvData, i)));
+              DINT32 (ctx.pvData, i) = iGetInt (sDataStr, argv[arg], 10);
+              PDEBUG ("Int[%d]=%"PRId32"\n", i, DINT32 (ctx.pvData, i));
+            }
+            else if (ctx.eFormat == eFormatUInt32) {
+              int64_t llValue = llGetInt64 (sDataStr, argv[arg]);
+
+              if ( (llValue < 0) || (llValue > UINT32_MAX)) {
+                vSyntaxErrorExit ("%s out of range (%s)", sDataStr, argv[arg]);
+              }
+              DUINT32 (ctx.pvData, i) = (uint32_t) llValue;
+              PDEBUG ("UInt[%d]=%"PRIu32"\n", i, DUINT32 (ctx.pvData, i));
+            }
+            else if (ctx.eFormat == eFormatInt64) {
+              DINT64 (ctx.pvData, i) = llGetInt64 (sDataStr, argv[arg]);
+              PDEBUG ("Int64[%d]=%"PRId64"\n", i, DINT64 (ctx.pvData, i));
             }
             else if (ctx.eFormat == eFormatFloat) {
               dValue = dGetDouble (sDataStr, argv[arg]);
               PDEBUG ("%g,%g\n", FLT_MIN, FLT_MAX);
               vCheckDoubleRange (sDataStr, dValue, -FLT_MAX, FLT_MAX);
-              DFLOAT (ctx.pvData, i) = fSwapFloat ( (float) dValue);
-              PDEBUG ("Float[%d]=%g\n", i, fSwapFloat (DFLOAT (ctx.pvData, i)));
+              DFLOAT (ctx.pvData, i) = (float) dValue;
+              PDEBUG ("Float[%d]=%g\n", i, DFLOAT (ctx.pvData, i));
+            }
+            else if (ctx.eFormat == eFormatDouble) {
+              DDOUBLE (ctx.pvData, i) = dGetDouble (sDataStr, argv[arg]);
+              PDEBUG ("Double[%d]=%g\n", i, DDOUBLE (ctx.pvData, i));
             }
             else if (ctx.eFormat == eFormatString) {
                 vSyntaxErrorExit ("You can use string format only for output");
@@ -774,30 +1318,236 @@ main (int argc, char **argv) {
             break;
         }
       }
+      if (ctx.iValueWords > 1) {
+
+        vDecodeWords (ctx.pvData, ctx.iCount, ctx.iValueWords, ctx.eOrder);
+      }
     }
   }
 
-  if ( (ctx.iSlaveCount > 1) && ( (ctx.bIsWrite) || (ctx.bIsReportSlaveID))) {
-    vSyntaxErrorExit ("You can give a slave address list only for reading");
+  if ( (ctx.iSlaveCount > 1) && (ctx.bIsReportSlaveID)) {
+    vSyntaxErrorExit ("You can give a slave address list only for reading or writing");
   }
 
   if ( (ctx.iStartCount > 1) && (ctx.bIsWrite) ) {
     vSyntaxErrorExit ("You can give a start ref list only for reading");
   }
 
+  if (ctx.bIsWrite) {
+    // une seule requête écrit toutes les valeurs, de 2 ou 4 registres pour
+    // les valeurs de 32 et 64 bits
+    int iMax = (ctx.eFunction == eFuncCoil) ? MODBUS_MAX_WRITE_BITS :
+               MODBUS_MAX_WRITE_REGISTERS;
+
+    ctx.iNbReg = ctx.iCount * ctx.iValueWords;
+    if (ctx.iNbReg > iMax) {
+      vSyntaxErrorExit ("%s: %d references to write, %d at most",
+                        modbus_strerror (EMBMDATA), ctx.iNbReg, iMax);
+    }
+  }
+
+  if (ctx.eOutput != eOutputText) {
+
+    if ( (ctx.bIsWrite) || (ctx.bIsReportSlaveID)) {
+      vSyntaxErrorExit ("--output is available only for reading");
+    }
+    // seuls les enregistrements sont écrits sur la sortie standard
+    ctx.bIsQuiet = true;
+  }
+
+  if (ctx.bIsBroadcast) {
+#ifdef MBPOLL_RTU
+    if ( (ctx.eMode != eModeRtu) || (!ctx.bIsWrite)) {
+      vSyntaxErrorExit ("--broadcast is available only for writing in RTU mode");
+    }
+    if (ctx.iSlaveCount != -1) {
+      vSyntaxErrorExit ("--broadcast can not be used with a slave address");
+    }
+    if (ctx.iBusCount > 0) {
+      vSyntaxErrorExit ("--broadcast is not available with --bus");
+    }
+#else
+    vSyntaxErrorExit ("--broadcast is not available on this platform");
+#endif
+  }
+
   if (ctx.iSlaveCount == -1) {
 
     ctx.piSlaveAddr = malloc (sizeof (int));
     assert (ctx.piSlaveAddr);
-    ctx.piSlaveAddr[0] = DEFAULT_SLAVEADDR;
+    ctx.piSlaveAddr[0] = ctx.bIsBroadcast ? MODBUS_BROADCAST_ADDRESS :
+                         DEFAULT_SLAVEADDR;
     ctx.iSlaveCount = 1;
   }
 
+  if (ctx.iWorkers > 1) {
+#if defined (MBPOLL_PTHREAD) || defined (MBPOLL_PIPELINE)
+    if (ctx.eMode != eModeTcp) {
+      vSyntaxErrorExit ("--workers is available only in TCP mode");
+    }
+#ifndef MBPOLL_PTHREAD
+    if (ctx.iPipeline == 0) {
+      vSyntaxErrorExit ("--workers needs --pipeline on this platform");
+    }
+#endif
+    // inutile d'ouvrir plus de connexions qu'il n'y a d'esclaves
+    ctx.iWorkers = MIN (ctx.iWorkers, ctx.iSlaveCount);
+#else
+    vSyntaxErrorExit ("--workers is not available on this platform");
+#endif
+  }
+
+  if (ctx.iPipeline > 0) {
+#ifdef MBPOLL_PIPELINE
+    if (ctx.eMode != eModeTcp) {
+      vSyntaxErrorExit ("--pipeline is available only in TCP mode");
+    }
+#else
+    vSyntaxErrorExit ("--pipeline is not available on this platform");
+#endif
+  }
+
+  if (ctx.piEvery) {
+
+    if (ctx.bIsWrite) {
+      vSyntaxErrorExit ("--every is available only for reading");
+    }
+    if (ctx.iEveryCount == 1) {
+
+      // une seule valeur s'applique à toutes les références de départ
+      ctx.piEvery = realloc (ctx.piEvery, ctx.iStartCount * sizeof (int));
+      assert (ctx.piEvery);
+      for (i = 1; i < ctx.iStartCount; i++) {
+        ctx.piEvery[i] = ctx.piEvery[0];
+      }
+      ctx.iEveryCount = ctx.iStartCount;
+    }
+    if (ctx.iEveryCount != ctx.iStartCount) {
+      vSyntaxErrorExit ("--every needs one %s per start reference", sEveryStr);
+    }
+    for (i = 0; i < ctx.iEveryCount; i++) {
+      vCheckIntRange (sEveryStr, ctx.piEvery[i], EVERY_MIN, EVERY_MAX);
+    }
+  }
+
+  if ( (ctx.bIsOnChange) && (ctx.bIsWrite)) {
+
+    vSyntaxErrorExit ("--on-change is available only for reading");
+  }
+  vSetDeadbands (&ctx);
+
+  if ( (ctx.sCaptureFile) && (ctx.bIsWrite || ctx.bIsReportSlaveID)) {
+
+    vSyntaxErrorExit ("--capture is available only for reading");
+  }
+
+  if (ctx.sShmName) {
+#ifdef MBPOLL_SHM
+    if (ctx.bIsWrite || ctx.bIsReportSlaveID) {
+      vSyntaxErrorExit ("--shm is available only for reading");
+    }
+#else
+    vSyntaxErrorExit ("--shm is not available on this platform");
+#endif
+  }
+
+  if (ctx.iQueueSize > 0) {
+#ifdef MBPOLL_PTHREAD
+    if (ctx.bIsWrite || ctx.bIsReportSlaveID) {
+      vSyntaxErrorExit ("--queue is available only for reading");
+    }
+#else
+    vSyntaxErrorExit ("--queue is not available on this platform");
+#endif
+  }
+  else if (ctx.eOverflow != eRingBlock) {
+
+    vSyntaxErrorExit ("--overflow needs --queue");
+  }
+
+  if ( (ctx.iDownAfter > 0) && (ctx.bIsWrite)) {
+
+    vSyntaxErrorExit ("--down-after is available only for reading");
+  }
+
+  if (ctx.dRtoMin > 0) {
+
+    if (ctx.bIsWrite) {
+      vSyntaxErrorExit ("--adaptive-timeout is available only for reading");
+    }
+    // le timeout fixé par -o devient la borne maximale
+    if (ctx.dRtoMin > ctx.dTimeout) {
+      vSyntaxErrorExit ("Illegal %s: %.3f s is greater than the time-out",
+                        sRtoMinStr, ctx.dRtoMin);
+    }
+  }
+
+#ifdef MBPOLL_RTU
+  // le port série est géré directement pour la scrutation et l'écriture,
+  // sauf si libmodbus doit piloter le signal RTS (RS-485) ou passer par ChipIo
+  ctx.bIsNativeRtu = (ctx.eMode == eModeRtu) &&
+                     (!ctx.bIsReportSlaveID) && (!ctx.bIsChipIo) &&
+                     (ctx.iRtuMode == MODBUS_RTU_RTS_NONE);
+  if ( (ctx.bIsBroadcast) && (!ctx.bIsNativeRtu)) {
+    vSyntaxErrorExit ("--broadcast is not available with -R or -F");
+  }
+  if ( (ctx.iRtuGap > 0) && (!ctx.bIsNativeRtu)) {
+    vSyntaxErrorExit ("--rtu-gap is available only in RTU mode, without -R or -F");
+  }
+  if (ctx.iRtuGap == 0) {
+    ctx.iRtuGap = DEFAULT_RTU_GAP;
+  }
+#else
+  if (ctx.iRtuGap > 0) {
+    vSyntaxErrorExit ("--rtu-gap is not available on this platform");
+  }
+#endif
+
+  if ( (ctx.iBusCount > 0) && (ctx.xBuses[1].bIsGateway)) {
+#ifdef MBPOLL_PIPELINE
+    if (ctx.eMode != eModeTcp) {
+      vSyntaxErrorExit ("--gateway is available only in TCP mode");
+    }
+    if (ctx.iWorkers > 1) {
+      vSyntaxErrorExit ("--workers is not available with --gateway");
+    }
+    if (ctx.sCaptureFile) {
+      vSyntaxErrorExit ("--capture is not available with --gateway");
+    }
+    // une passerelle traite une requête à la fois sur sa ligne série, une
+    // connexion par passerelle est menée par le moteur d'évènements, toutes
+    // en même temps
+    if (ctx.iPipeline == 0) {
+      ctx.iPipeline = 1;
+    }
+    vMergeBuses (&ctx);
+    ctx.iWorkers = ctx.iBusCount;
+#else
+    vSyntaxErrorExit ("--gateway is not available on this platform");
+#endif
+  }
+  else if (ctx.iBusCount > 0) {
+#ifdef MBPOLL_RTU
+    if (!ctx.bIsNativeRtu) {
+      vSyntaxErrorExit ("--bus is available only in RTU mode, without -R or -F");
+    }
+    if (ctx.sCaptureFile) {
+      vSyntaxErrorExit ("--capture is not available with --bus");
+    }
+    // un lien de scrutation par bus, tous menés par le moteur d'évènements
+    vMergeBuses (&ctx);
+    ctx.iWorkers = ctx.iBusCount;
+#else
+    vSyntaxErrorExit ("--bus is not available on this platform");
+#endif
+  }
+
   // Fin de vérification des valeurs de paramètres et création des contextes
   switch (ctx.eMode) {
     case eModeRtu:
       for (i = 0; i < ctx.iSlaveCount; i++) {
         vCheckIntRange (sSlaveAddrStr, ctx.piSlaveAddr[i],
+                        ctx.bIsBroadcast ? MODBUS_BROADCAST_ADDRESS :
                         RTU_SLAVEADDR_MIN, SLAVEADDR_MAX);
       }
       ctx.xBus = modbus_new_rtu (ctx.sDevice, ctx.xRtu.baud, ctx.xRtu.parity,
@@ -845,458 +1595,3118 @@ main (int argc, char **argv) {
     modbus_rtu_set_rts (ctx.xBus, ctx.iRtuMode);
   }
 
-  // Connection au bus
-  if (modbus_connect (ctx.xBus) == -1) {
+  // Connection au bus, les connexions pipelinées et le port série géré sans
+  // libmodbus sont ouverts par vOpenLinks()
+  if ( (ctx.iPipeline == 0) && (!ctx.bIsNativeRtu)) {
 
-    modbus_free (ctx.xBus);
-    vIoErrorExit ("Connection failed: %s", modbus_strerror (errno));
-  }
+    if (modbus_connect (ctx.xBus) == -1) {
 
+      modbus_free (ctx.xBus);
+      vIoErrorExit ("Connection failed: %s", modbus_strerror (errno));
+    }
 
-  /*
-   * évites que l'esclave prenne l'impulsion de 40µs créée par le driver à
-   * l'ouverture du port comme un bit de start.
-   */
-  mb_delay (20);
+    /*
+     * évites que l'esclave prenne l'impulsion de 40µs créée par le driver à
+     * l'ouverture du port comme un bit de start.
+     */
+    mb_delay (20);
+  }
 
   // Réglage du timeout de réponse
-  uint32_t  sec, usec;
 #ifdef DEBUG
+  uint32_t  sec, usec;
 
   modbus_get_byte_timeout (ctx.xBus, &sec, &usec);
   PDEBUG ("Get byte timeout: %d s, %d us\n", sec, usec);
 #endif
-  sec = (uint32_t) ctx.dTimeout;
-  usec = (uint32_t) ( (ctx.dTimeout - sec) * 1E6);
-  modbus_set_response_timeout (ctx.xBus, sec, usec);
-  PDEBUG ("Set response timeout to %"PRIu32" sec, %"PRIu32" us\n", sec, usec);
+  vSetResponseTimeout (ctx.xBus, ctx.dTimeout);
 
-  // vSigIntHandler() intercepte le CTRL+C
-  signal (SIGINT, vSigIntHandler);
+  // vSigIntHandler() intercepte le CTRL+C, et l'arrêt demandé par un autre
+  // processus pour que le segment --shm soit supprimé
+  vSetSignals();
 
   if (ctx.bIsReportSlaveID) {
 
     vReportSlaveID (&ctx);
   }
   else {
-    int iNbReg, iStartReg;
+
+    if (!ctx.bIsWrite) {
+
+      vBuildPlan (&ctx);
+    }
+
     // Affichage complet de la configuration
     if (false == ctx.bIsQuiet) {
       vPrintConfig (&ctx);
     }
 
-    // int32 et float utilisent 2 registres 16 bits
-    iNbReg = ( (ctx.eFormat == eFormatInt) || (ctx.eFormat == eFormatFloat)) ?
-             ctx.iCount * 2 : ctx.iCount;
-
-    // Début de la boucle de scrutation
-    do {
-
-      if (ctx.bIsWrite) {
-
-        // libmodbus utilise les adresses PDU !
-        iStartReg = ctx.piStartRef[0] - ctx.iPduOffset;
+    // les valeurs de 32 et 64 bits utilisent 2 et 4 registres 16 bits
+    ctx.iNbReg = ctx.iCount * ctx.iValueWords;
 
-        modbus_set_slave (ctx.xBus, ctx.piSlaveAddr[0]);
-        ctx.iTxCount++;
+    if (ctx.bIsWrite) {
 
-        // Ecriture ------------------------------------------------------------
-        switch (ctx.eFunction) {
+      vAllocateTargets (&ctx);
+      vOpenLinks (&ctx);
+    }
+    else {
 
-          case eFuncCoil:
-            if (iNbReg == 1) {
+      vAllocateSlaves (&ctx);
+      vOpenLinks (&ctx);
+      if (ctx.sCaptureFile) {
+        vCreateCapture (&ctx);
+      }
+#ifdef MBPOLL_SHM
+      if (ctx.sShmName) {
+        vCreateShm (&ctx);
+      }
+#endif
+    }
 
-              // Ecriture d'un seul bit
-              iRet = modbus_write_bit (ctx.xBus, iStartReg,
-                                       DUINT8 (ctx.pvData, 0));
-            }
-            else {
+    // Début de la boucle de scrutation, les cycles démarrent à intervalles
+    // réguliers à partir de maintenant
+    ctx.ullStartTime = ctx.ullNextCycle = ullTimeNowUs ();
+    if (ctx.eOutput == eOutputCsv) {
 
-              iRet = modbus_write_bits (ctx.xBus, iStartReg, iNbReg,
-                                        ctx.pvData);
-            }
-            break;
+      vPrintCsvHeader (&ctx);
+    }
+#ifdef MBPOLL_PTHREAD
+    // le tampon de sortie appartient au thread d'écriture à partir d'ici
+    if (ctx.iQueueSize > 0) {
+      vCreateQueue (&ctx);
+    }
+#endif
+    ctx.ullNextReport = ctx.ullNextCycle + ctx.iReportPeriod * 1000000ULL;
+    do {
 
-          case eFuncHoldingReg:
-            if (iNbReg == 1 && (!ctx.bWriteSingleAsMany)) {
+      if (ctx.bIsWrite) {
+        uint64_t ullStart = ullTimeNowUs();
 
-              // Ecriture d'un seul registre
-              iRet = modbus_write_register (ctx.xBus, iStartReg,
-                                            DUINT16 (ctx.pvData, 0));
-            }
-            else {
+        // Ecriture ------------------------------------------------------------
+        vWriteTargets (&ctx);
+        vPrintWrites (&ctx, ullTimeNowUs() - ullStart);
+        // Fin écriture --------------------------------------------------------
+      }
+      else {
+        int i;
 
-              iRet =  modbus_write_registers (ctx.xBus, iStartReg, iNbReg,
-                                              ctx.pvData);
-            }
-            break;
+        // Lecture -------------------------------------------------------------
+        bool bIsBatch = false;
+        bool bIsDue = bIsCycleDue (&ctx);
 
-          default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
-            break;
+        if (ctx.iDownAfter > 0) {
+          vSelectSlaves (&ctx);
         }
-        if (iRet == iNbReg) {
+#ifdef MBPOLL_PTHREAD
+        if (bIsDue && ctx.xPool) {
 
-          ctx.iRxCount++;
-          printf ("Written %d references.\n", ctx.iCount);
+          // tous les esclaves sont scrutés en parallèle
+          iWorkerPoolRun (ctx.xPool, ctx.iSlaveCount, vPollSlaveJob, &ctx);
+          bIsBatch = true;
         }
-        else {
-          ctx.iErrorCount++;
-          fprintf (stderr, "Write %s failed: %s\n",
-                   sFunctionToStr (ctx.eFunction), modbus_strerror (errno));
+#endif
+#ifdef MBPOLL_PIPELINE
+        if (bIsDue && (!bIsBatch) &&
+            ( (ctx.iPipeline > 0) || (ctx.iBusCount > 0))) {
+
+          // les requêtes de tous les esclaves partent ensemble, réparties
+          // sur les connexions ou les bus
+          vPollLinks (&ctx);
+          bIsBatch = true;
         }
-        // Fin écriture --------------------------------------------------------
-      }
-      else {
-        int i;
+#endif
+        if (!bIsDue) {
 
-        // Lecture -------------------------------------------------------------
-        for (i = 0; i < ctx.iSlaveCount; i++) {
+          // aucune référence de départ à lire dans ce cycle
+        }
+        else if (bIsBatch) {
 
-          modbus_set_slave (ctx.xBus, ctx.piSlaveAddr[i]);
-          ctx.iTxCount++;
+          // l'affichage se fait dans l'ordre de la liste des esclaves
+          for (i = 0; i < ctx.iSlaveCount; i++) {
 
-          printf ("-- Polling slave %d...", ctx.piSlaveAddr[i]);
-          if (ctx.bIsPolling) {
+            vEndSlavePoll (&ctx.xSlaves[i], &ctx);
+          }
+        }
+        else {
+          for (i = 0; i < ctx.iSlaveCount; i++) {
 
-            printf (" Ctrl-C to stop)\n");
+            iPollSlaves (&ctx.xLinks[0], &ctx.xSlaves[i], 1, &ctx);
+            vEndSlavePoll (&ctx.xSlaves[i], &ctx);
           }
-          else {
+        }
+#ifdef MBPOLL_PTHREAD
+        if (ctx.xQueue) {
 
-            putchar ('\n');
+          if (bIsDue) {
+            vQueueCycle (&ctx);
           }
+        }
+        else {
+          vFlushOutput (&ctx);
+        }
+#else
+        vFlushOutput (&ctx);
+#endif
+#ifdef MBPOLL_SHM
+        if (bIsDue && ctx.xShm) {
+          vPublishSlaves (&ctx);
+        }
+#endif
+        if (bIsDue && ctx.xCapture) {
+          vCaptureSlaves (&ctx);
+        }
+        if ( (ctx.iReportPeriod > 0) && (ullTimeNowUs() >= ctx.ullNextReport)) {
 
-          int j;
-          for (j = 0; j < ctx.iStartCount; j++) {
-            // libmodbus utilise les adresses PDU !
-            iStartReg = ctx.piStartRef[j] - ctx.iPduOffset;
+          // la sortie standard appartient au thread d'écriture (--queue)
+          FILE * f = ( (ctx.eOutput == eOutputText) && (ctx.iQueueSize == 0)) ?
+                     stdout : stderr;
 
-            switch (ctx.eFunction) {
-              case eFuncDiscreteInput:
-                iRet = modbus_read_input_bits (ctx.xBus, iStartReg, iNbReg,
-                                               ctx.pvData);
-                break;
+          vPrintBuses (&ctx, "poll report", f);
+          ctx.ullNextReport += ctx.iReportPeriod * 1000000ULL;
+        }
+        if (ctx.bIsPolling) {
 
-              case eFuncCoil:
-                iRet = modbus_read_bits (ctx.xBus, iStartReg, iNbReg,
-                                         ctx.pvData);
-                break;
+          vWaitNextCycle (&ctx);
+        }
+        // Fin lecture ---------------------------------------------------------
+      }
+    }
+    while (ctx.bIsPolling);
+  }
 
-              case eFuncInputReg:
-                iRet = modbus_read_input_registers (ctx.xBus, iStartReg, iNbReg,
-                                                    ctx.pvData);
-                break;
+  vSigIntHandler (0);
+  return 0;
+}
 
-              case eFuncHoldingReg:
-                iRet = modbus_read_registers (ctx.xBus, iStartReg, iNbReg,
-                                              ctx.pvData);
-                break;
 
-              default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
-                break;
+/* private functions ======================================================== */
 
-            }
-            if (iRet == iNbReg) {
+// -----------------------------------------------------------------------------
+// Lecture de toutes les requêtes du plan de scrutation pour un esclave
+int
+iPollSlave (modbus_t * xBus, xSlave * xSlv, const xMbPollContext * ctx) {
+  const xPollPlan * xPlan = ctx->xPlan;
+  int r, iRet = 0, iErrors = 0;
 
-              ctx.iRxCount++;
-              vPrintReadValues (ctx.piStartRef[j], ctx.iCount, &ctx);
-            }
-            else {
-              ctx.iErrorCount++;
-              fprintf (stderr, "Read %s failed: %s\n",
-                       sFunctionToStr (ctx.eFunction),
-                       modbus_strerror (errno));
-            }
-          }
-          if (ctx.bIsPolling) {
+  if (xSlv->bIsSkipped) {
+    return 0;
+  }
+  modbus_set_slave (xBus, xSlv->iAddr);
 
-            mb_delay (ctx.iPollRate);
-          }
+  for (r = 0; r < xPlan->iReadCount; r++) {
+    const xPlanRead * xRead = &xPlan->xReads[r];
+    void * pvData = (uint8_t *) xSlv->pvImage +
+                    xRead->iOffset * ctx->iElemBits / 8;
+    // libmodbus lit un bit par octet, ils sont compactés ensuite dans l'image
+    uint8_t ucBits[MODBUS_MAX_READ_BITS];
+
+    uint64_t ullStart;
+
+    if (!POLL_PLAN_IS_DUE (xRead->iEvery, ctx->iCycleCount)) {
+      continue;
+    }
+    if (ctx->dRtoMin > 0) {
+      uint64_t ullRto = ullRtoValue (&xSlv->xRto);
+
+      modbus_set_response_timeout (xBus, ullRto / 1000000, ullRto % 1000000);
+    }
+
+    ullStart = ullTimeNowUs();
+    switch (ctx->eFunction) {
+      case eFuncDiscreteInput:
+        iRet = modbus_read_input_bits (xBus, xRead->iAddr, xRead->iCount,
+                                       ucBits);
+        break;
+
+      case eFuncCoil:
+        iRet = modbus_read_bits (xBus, xRead->iAddr, xRead->iCount, ucBits);
+        break;
+
+      case eFuncInputReg:
+        iRet = modbus_read_input_registers (xBus, xRead->iAddr, xRead->iCount,
+                                            pvData);
+        break;
+
+      case eFuncHoldingReg:
+        iRet = modbus_read_registers (xBus, xRead->iAddr, xRead->iCount,
+                                      pvData);
+        break;
+
+      default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
+        break;
+    }
+    if (iRet == xRead->iCount) {
+
+      if (ctx->iElemBits == 1) {
+
+        vBitsPack (xSlv->pvImage, xRead->iOffset, ucBits, xRead->iCount);
+      }
+      xSlv->piReadError[r] = 0;
+    }
+    else {
+
+      xSlv->piReadError[r] = errno;
+      iErrors++;
+    }
+    vRecordTransaction (xSlv, xRead->iCount, xSlv->piReadError[r],
+                        ullTimeNowUs() - ullStart, ctx);
+  }
+
+  // les valeurs de chaque référence de départ sont extraites de l'image
+  vPollPlanScatter (xPlan, xSlv->pvImage, xSlv->pvData,
+                    xSlv->piReadError, xSlv->piError, ctx->iCycleCount);
+  return iErrors;
+}
+
+// -----------------------------------------------------------------------------
+// Affichage des résultats de la lecture d'un esclave pendant le cycle iCycle
+void
+vPrintSlave (xSlave * xSlv, int iCycle, xMbPollContext * ctx) {
+  bool bIsText = (ctx->eOutput == eOutputText);
+  size_t ulMark = ctx->xOut.ulLen;
+  bool bIsEmpty = true;
+  int j;
+
+  if (bIsText && ctx->bIsBanner) {
+
+    if (ctx->iBusCount > 0) {
+
+      // les esclaves de plusieurs bus sont mélangés, l'heure est celle de
+      // la fin de leur scrutation
+      vOutBufPrintf (&ctx->xOut, "-- Polling slave %d on %s at "
+                     "%"PRIu64".%06u...%s\n", xSlv->iAddr,
+                     ctx->xBuses[xSlv->iBus].sName, xSlv->ullTime / 1000000,
+                     (unsigned) (xSlv->ullTime % 1000000),
+                     ctx->bIsPolling ? " Ctrl-C to stop)" : "");
+    }
+    else {
+
+      vOutBufPrintf (&ctx->xOut, "-- Polling slave %d...%s\n", xSlv->iAddr,
+                     ctx->bIsPolling ? " Ctrl-C to stop)" : "");
+    }
+  }
+
+  for (j = 0; j < ctx->iStartCount; j++) {
+    const void * pvData;
+    int iError = xSlv->piError[j];
+
+    if (!POLL_PLAN_IS_DUE (ctx->xPlan->piRefEvery[j], iCycle)) {
+      continue;
+    }
+    if (iError) {
+
+      if (ctx->bIsOnChange) {
+
+        // toutes les valeurs seront signalées au retour de l'esclave,
+        // l'erreur ne l'est qu'une fois
+        xSlv->pbIsReported[j] = false;
+        if (xSlv->piReportedError[j] == iError) {
+          continue;
         }
-        // Fin lecture ---------------------------------------------------------
+        xSlv->piReportedError[j] = iError;
       }
+      bIsEmpty = false;
+      if (bIsText) {
+
+        // les valeurs qui précèdent l'erreur sont affichées avant elle
+        vFlushOutput (ctx);
+        fprintf (stderr, "Read %s failed: %s\n",
+                 sFunctionToStr (ctx->eFunction), modbus_strerror (iError));
+      }
+      else {
+
+        vPrintRecord (xSlv, j, NULL, 0, 0, ctx);
+      }
+      continue;
+    }
+
+    pvData = pvDecodeBlock ( (uint8_t *) xSlv->pvData + j * ctx->ulDataSize,
+                             ctx);
+    if (ctx->bIsOnChange) {
+
+      xSlv->piReportedError[j] = 0;
+      if (iPrintChanges (xSlv, j, pvData, ctx) > 0) {
+        bIsEmpty = false;
+      }
+    }
+    else if (bIsText) {
+
+      vPrintReadValues (&ctx->xOut, ctx->piStartRef[j], ctx->iCount, pvData,
+                        ctx);
+    }
+    else {
+
+      vPrintRecord (xSlv, j, pvData, 0, ctx->iCount, ctx);
     }
-    while (ctx.bIsPolling);
   }
 
-  vSigIntHandler (SIGTERM);
-  return 0;
+  if (ctx->bIsOnChange && bIsEmpty) {
+
+    // rien à signaler, l'entête de l'esclave est retirée du tampon
+    ctx->xOut.ulLen = ulMark;
+  }
 }
 
+// -----------------------------------------------------------------------------
+// Indique si l'écart entre la valeur de rang i d'un bloc et la dernière
+// valeur signalée sort de la bande morte. Les bits, compactés quel que soit
+// le format, et les chaînes n'ont pas de bande morte, tout changement est
+// signalé.
+static bool
+bIsOutsideDeadband (const void * pvData, const void * pvLast, int i,
+                    const xDeadband * xDb, const xMbPollContext * ctx) {
+  double v, l, dLimit;
+
+  if ( (xDb == NULL) || (ctx->iElemBits == 1)) {
+    return true;
+  }
+  switch (ctx->eFormat) {
+
+    case eFormatDec:
+    case eFormatHex:
+      v = DUINT16 (pvData, i);
+      l = DUINT16 (pvLast, i);
+      break;
 
-/* private functions ======================================================== */
+    case eFormatInt16:
+      v = (int16_t) DUINT16 (pvData, i);
+      l = (int16_t) DUINT16 (pvLast, i);
+      break;
+
+    case eFormatInt:
+      v = DINT32 (pvData, i);
+      l = DINT32 (pvLast, i);
+      break;
+
+    case eFormatUInt32:
+      v = DUINT32 (pvData, i);
+      l = DUINT32 (pvLast, i);
+      break;
+
+    case eFormatInt64:
+      v = (double) DINT64 (pvData, i);
+      l = (double) DINT64 (pvLast, i);
+      break;
+
+    case eFormatFloat:
+      v = DFLOAT (pvData, i);
+      l = DFLOAT (pvLast, i);
+      break;
+
+    case eFormatDouble:
+      v = DDOUBLE (pvData, i);
+      l = DDOUBLE (pvLast, i);
+      break;
+
+    default:
+      return true;
+  }
+  dLimit = xDb->bIsPercent ? fabs (l) * xDb->dValue / 100. : xDb->dValue;
+  // nan n'est jamais dans la bande morte
+  return ! (fabs (v - l) <= dLimit);
+}
+
+// -----------------------------------------------------------------------------
+// Ajout au tampon de sortie d'une valeur signalée (--on-change) : une ligne
+// en mode texte, un enregistrement d'une valeur sinon
+static void
+vPrintChange (const xSlave * xSlv, int j, const void * pvData, int i,
+              xMbPollContext * ctx) {
+
+  if (ctx->eOutput == eOutputText) {
+
+    vPrintReadLine (&ctx->xOut, ctx->piStartRef[j], ctx->iCount, pvData, i,
+                    ctx);
+  }
+  else {
+
+    vPrintRecord (xSlv, j, pvData, i, 1, ctx);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Signalement des valeurs d'un bloc lu qui ont changé depuis le dernier
+// signalement (--on-change).
+// Le bloc est comparé 64 bits à la fois aux dernières valeurs signalées,
+// seules les valeurs qui diffèrent sont décodées et confrontées à la bande
+// morte. Une valeur signalée devient la nouvelle référence, une valeur
+// restée dans la bande morte ne l'est pas, sa dérive finit donc par être
+// signalée.
+// @return le nombre de valeurs signalées
+int
+iPrintChanges (xSlave * xSlv, int j, const void * pvData,
+               xMbPollContext * ctx) {
+  uint8_t * pucLast = (uint8_t *) xSlv->pvReported + j * ctx->ulDataSize;
+  const xDeadband * xDb = ctx->xDeadbands ? &ctx->xDeadbands[j] : NULL;
+  // une valeur signalée est une ligne affichée : 1 valeur, ou 16 bits
+  int iStep = iLineValues (ctx);
+  int iValueBits = (ctx->iElemBits == 1) ? 1 : 16 * ctx->iValueWords;
+  int iBits = ctx->iCount * iValueBits;
+  int i, iBit = 0, iChanges = 0;
+
+  if (!xSlv->pbIsReported[j]) {
+
+    // première lecture, ou retour après une erreur : tout est signalé
+    for (i = 0; i < ctx->iCount; i += iStep) {
+
+      vPrintChange (xSlv, j, pvData, i, ctx);
+      iChanges++;
+    }
+    memcpy (pucLast, pvData, ctx->ulDataSize);
+    xSlv->pbIsReported[j] = true;
+    return iChanges;
+  }
+
+  while (iBit < iBits) {
+    // la comparaison reprend au début de l'octet, les bits qui précèdent
+    // iBit dans cet octet sont égaux ou viennent d'être recopiés
+    int iByte = iBit / 8;
+    int iDiff = iBitsDiff ( (const uint8_t *) pvData + iByte, pucLast + iByte,
+                            iBits - iByte * 8);
+
+    if (iDiff < 0) {
+      break;
+    }
+    i = (iByte * 8 + iDiff) / (iStep * iValueBits) * iStep;
+    if ( (iStep > 1) || bIsOutsideDeadband (pvData, pucLast, i, xDb, ctx)) {
+
+      vPrintChange (xSlv, j, pvData, i, ctx);
+      if (ctx->iElemBits == 1) {
+
+        vBitsCopy (pucLast, i, pvData, i, MIN (iStep, ctx->iCount - i));
+      }
+      else {
+
+        memcpy (pucLast + i * iValueBits / 8,
+                (const uint8_t *) pvData + i * iValueBits / 8, iValueBits / 8);
+      }
+      iChanges++;
+    }
+    iBit = (i + iStep) * iValueBits;
+  }
+  return iChanges;
+}
 
 // -----------------------------------------------------------------------------
+// Une seule bande morte s'applique à toutes les références de départ,
+// sinon il en faut une par référence
 void
-vPrintReadValues (int iAddr, int iCount, xMbPollContext * ctx) {
+vSetDeadbands (xMbPollContext * ctx) {
   int i;
-  for (i = 0; i < iCount; i++) {
 
-    printf ("[%d]: \t", iAddr);
+  if (ctx->iDeadbandCount == 1) {
 
-    switch (ctx->eFormat) {
+    ctx->xDeadbands = realloc (ctx->xDeadbands,
+                               ctx->iStartCount * sizeof (xDeadband));
+    assert (ctx->xDeadbands);
+    for (i = 1; i < ctx->iStartCount; i++) {
+      ctx->xDeadbands[i] = ctx->xDeadbands[0];
+    }
+    ctx->iDeadbandCount = ctx->iStartCount;
+  }
+  if ( (ctx->xDeadbands) && (ctx->iDeadbandCount != ctx->iStartCount)) {
+    vSyntaxErrorExit ("--on-change needs one %s per start reference",
+                      sDeadbandStr);
+  }
+}
 
-      case eFormatBin:
-        printf ("%c", (DUINT8 (ctx->pvData, i) != FALSE) ? '1' : '0');
-        iAddr++;
-        break;
+// -----------------------------------------------------------------------------
+// Création du fichier de capture (--capture), l'entête décrit le plan de
+// scrutation pour que la relecture puisse le reconstruire
+void
+vCreateCapture (xMbPollContext * ctx) {
+  xCaptureHeader xHdr = {
+    .iMode = ctx->eMode,
+    .iFunction = ctx->eFunction,
+    .iFormat = ctx->eFormat,
+    .iOrder = ctx->eOrder,
+    .iPduOffset = ctx->iPduOffset,
+    .iPollRate = ctx->iPollRate,
+    .iElemBits = ctx->iElemBits,
+    .iBlockSize = ctx->iNbReg,
+    .iCount = ctx->iCount,
+    .iRefCount = ctx->iStartCount,
+    .piRef = ctx->piStartRef,
+    .piEvery = ctx->xPlan->piRefEvery,
+    .iSlaveCount = ctx->iSlaveCount,
+    .piSlave = ctx->piSlaveAddr,
+    .sDevice = ctx->sDevice,
+    .ullStartTime = ullTimeRealUs ()
+  };
+
+  ctx->xCapture = xCaptureCreate (ctx->sCaptureFile, &xHdr);
+  if (ctx->xCapture == NULL) {
+
+    vIoErrorExit ("Unable to create %s: %s", ctx->sCaptureFile,
+                  strerror (errno));
+  }
+}
 
-      case eFormatDec: {
-        uint16_t v = DUINT16 (ctx->pvData, i);
-        if (v & 0x8000) {
+// -----------------------------------------------------------------------------
+// Enregistrement du cycle qui vient de se terminer dans la capture, les
+// blocs sont ceux lus, avant décodage des valeurs de 32 et 64 bits
+void
+vCaptureSlaves (xMbPollContext * ctx) {
+  int i, j;
 
-          printf ("%u (%d)", v, (int) (int16_t) v);
-        }
-        else {
+  vCaptureCycle (ctx->xCapture, ctx->iCycleCount);
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    const xSlave * xSlv = &ctx->xSlaves[i];
 
-          printf ("%u", v);
-        }
-        iAddr++;
+    vCaptureSlave (ctx->xCapture, !xSlv->bIsSkipped, xSlv->ullTime);
+    if (xSlv->bIsSkipped) {
+      continue;
+    }
+    for (j = 0; j < ctx->iStartCount; j++) {
+
+      if (POLL_PLAN_IS_DUE (ctx->xPlan->piRefEvery[j], ctx->iCycleCount)) {
 
+        vCaptureBlock (ctx->xCapture, i, j, xSlv->piError[j],
+                       (uint8_t *) xSlv->pvData + j * ctx->ulDataSize);
       }
-      break;
+    }
+  }
+  if (iCaptureFlush (ctx->xCapture) != 0) {
 
-      case eFormatInt16:
-        printf ("%d", (int) (int16_t) (DUINT16 (ctx->pvData, i)));
-        iAddr++;
-        break;
+    vIoErrorExit ("Capture failed: %s", strerror (errno));
+  }
+}
 
-      case eFormatHex:
-        printf ("0x%04X", DUINT16 (ctx->pvData, i));
-        iAddr++;
-        break;
+#ifdef MBPOLL_SHM
+// -----------------------------------------------------------------------------
+// Création du segment de mémoire partagée (--shm), décrit dans shm.h
+void
+vCreateShm (xMbPollContext * ctx) {
+  xShmHeader xHdr = {
+    .ulFunction = iFunctionCode (ctx->eFunction),
+    .ulElemBits = ctx->iElemBits,
+    .ulValueWords = ctx->iValueWords,
+    .ulOrder = ctx->eOrder,
+    .ulPollRate = ctx->iPollRate,
+    .ulBlockSize = ctx->iNbReg,
+    .ulRefCount = ctx->iStartCount,
+    .ulSlaveCount = ctx->iSlaveCount
+  };
+
+  ctx->xShm = xShmCreate (ctx->sShmName, &xHdr, ctx->piStartRef,
+                          ctx->piSlaveAddr);
+  if (ctx->xShm == NULL) {
+
+    vIoErrorExit ("Unable to create shared memory %s: %s", ctx->sShmName,
+                  (errno == EEXIST) ? "used by another process" :
+                  strerror (errno));
+  }
+}
 
-      case eFormatString:
-        printf ("%c%c", (char) ((int) (DUINT16 (ctx->pvData, i) / 256)), (char) (DUINT16 (ctx->pvData, i) % 256));
-        iAddr++;
-        break;
+// -----------------------------------------------------------------------------
+// Publication du cycle qui vient de se terminer dans la mémoire partagée :
+// seuls les esclaves scrutés et les références à échéance sont mis à jour,
+// chaque esclave sous son verrou de séquence
+void
+vPublishSlaves (xMbPollContext * ctx) {
+  int i, j;
 
-      case eFormatInt:
-        printf ("%d", lSwapLong (DINT32 (ctx->pvData, i)));
-        iAddr += 2;
-        break;
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    const xSlave * xSlv = &ctx->xSlaves[i];
 
-      case eFormatFloat:
-        printf ("%g", fSwapFloat (DFLOAT (ctx->pvData, i)));
-        iAddr += 2;
-        break;
+    if (xSlv->bIsSkipped) {
+      continue;
+    }
+    vShmBegin (ctx->xShm, i, xSlv->ullTime, ctx->iCycleCount);
+    for (j = 0; j < ctx->iStartCount; j++) {
 
-      default:  // Impossible normalement
-        break;
+      if (POLL_PLAN_IS_DUE (ctx->xPlan->piRefEvery[j], ctx->iCycleCount)) {
+
+        vShmUpdate (ctx->xShm, i, j, xSlv->piError[j],
+                    (uint8_t *) xSlv->pvData + j * ctx->ulDataSize);
+      }
+    }
+    vShmEnd (ctx->xShm, i);
+  }
+}
+#endif
+
+#ifdef MBPOLL_PTHREAD
+// -----------------------------------------------------------------------------
+// Ecriture d'un cycle sorti de la file d'affichage, dans le thread d'écriture.
+// Une entrée contient le numéro du cycle, un xQueuedSlave par esclave, les
+// erreurs puis les blocs de données, dans l'ordre de la liste des esclaves.
+static void
+vWriteQueuedCycle (void * pvEntry, void * pvUser) {
+  xMbPollContext * ctx = (xMbPollContext *) pvUser;
+  uint8_t * pucEntry = (uint8_t *) pvEntry;
+  const xQueuedSlave * xQs;
+  int iCycle = (int) * (uint64_t *) pucEntry;
+  int i;
+
+  xQs = (const xQueuedSlave *) (pucEntry + sizeof (uint64_t));
+
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    const xSlave * xSlv = &ctx->xSlaves[i];
+    // les valeurs viennent de l'entrée, l'état de --on-change de l'esclave,
+    // qui n'est utilisé que par ce thread
+    xSlave xView = {
+      .iAddr = xSlv->iAddr,
+      .pvData = pucEntry + ctx->ulQueueDataOffset +
+      (size_t) i * ctx->iStartCount * ctx->ulDataSize,
+      .piError = (int *) (pucEntry + ctx->ulQueueErrorOffset) +
+      i * ctx->iStartCount,
+      .ullTime = xQs[i].ullTime,
+      .pvReported = xSlv->pvReported,
+      .pbIsReported = xSlv->pbIsReported,
+      .piReportedError = xSlv->piReportedError
+    };
+
+    if (!xQs[i].bIsSkipped) {
+      vPrintSlave (&xView, iCycle, ctx);
     }
-    putchar ('\n');
   }
+  vFlushOutput (ctx);
 }
 
 // -----------------------------------------------------------------------------
+// Démarrage du thread d'écriture (--queue) : la boucle de scrutation ne fait
+// plus que copier les résultats de chaque cycle dans la file
 void
-vReportSlaveID (const xMbPollContext * ctx) {
-  uint8_t ucReport[256];
+vCreateQueue (xMbPollContext * ctx) {
+  size_t ulEntrySize;
+
+  ctx->ulQueueErrorOffset = sizeof (uint64_t) +
+                            ctx->iSlaveCount * sizeof (xQueuedSlave);
+  ctx->ulQueueDataOffset = (ctx->ulQueueErrorOffset +
+                            ctx->iSlaveCount * ctx->iStartCount * sizeof (int) +
+                            7) & ~ (size_t) 7;
+  ulEntrySize = ctx->ulQueueDataOffset +
+                ctx->iSlaveCount * ctx->iStartCount * ctx->ulDataSize;
+
+  ctx->xQueue = xRingNew (ctx->iQueueSize, ulEntrySize, ctx->eOverflow,
+                          vWriteQueuedCycle, ctx);
+  if (ctx->xQueue == NULL) {
+
+    vIoErrorExit ("Unable to start the output thread");
+  }
+}
 
-  modbus_set_slave (ctx->xBus, ctx->piSlaveAddr[0]);
-  // Affichage de la configuration
-  printf ("Protocol configuration: ModBus %s\n", sModeList[ctx->eMode]);
-  printf ("Slave configuration...: address = %d, report slave id\n",
-          ctx->piSlaveAddr[0]);
+// -----------------------------------------------------------------------------
+// Copie du cycle qui vient de se terminer dans la file d'affichage. Selon
+// --overflow, attend une place libre si la file est pleine, écrase le plus
+// ancien cycle en attente ou abandonne celui-ci.
+void
+vQueueCycle (xMbPollContext * ctx) {
+  uint8_t * pucEntry = pvRingAcquire (ctx->xQueue);
+  xQueuedSlave * xQs;
+  sigset_t xAll, xOld;
+  int i;
 
-  vPrintCommunicationSetup (ctx);
+  if (pucEntry == NULL) {
+    return;
+  }
+  * (uint64_t *) pucEntry = ctx->iCycleCount;
+  xQs = (xQueuedSlave *) (pucEntry + sizeof (uint64_t));
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    const xSlave * xSlv = &ctx->xSlaves[i];
+
+    xQs[i].ullTime = xSlv->ullTime;
+    xQs[i].bIsSkipped = xSlv->bIsSkipped;
+    memcpy ( (int *) (pucEntry + ctx->ulQueueErrorOffset) +
+             i * ctx->iStartCount, xSlv->piError, ctx->iStartCount * sizeof (int));
+    memcpy (pucEntry + ctx->ulQueueDataOffset +
+            (size_t) i * ctx->iStartCount * ctx->ulDataSize,
+            xSlv->pvData, ctx->iStartCount * ctx->ulDataSize);
+  }
 
-  int iRet = modbus_report_slave_id (ctx->xBus, 256, ucReport);
+  // le réveil du thread d'écriture prend un verrou que vSigIntHandler()
+  // reprend pour l'arrêter, un Ctrl+C ne doit pas l'interrompre
+  sigfillset (&xAll);
+  pthread_sigmask (SIG_BLOCK, &xAll, &xOld);
+  vRingCommit (ctx->xQueue);
+  pthread_sigmask (SIG_SETMASK, &xOld, NULL);
+}
+#endif /* MBPOLL_PTHREAD defined */
+
+// -----------------------------------------------------------------------------
+// Relecture d'une capture (--replay) : les cycles enregistrés passent par
+// l'affichage habituel, aussi vite que possible ou au rythme de la capture
+// (--realtime). Ne retourne pas.
+void
+vReplay (xMbPollContext * ctx) {
+  xCaptureHeader xHdr;
+  bool bIsValid = false;
+  uint64_t ullOrigin = 0, ullStart = 0;
+  size_t ulIndex;
+  int i, j, iRet, iCycles = 0;
+
+  ctx->xCapture = xCaptureOpen (ctx->sReplayFile, &xHdr);
+  if (ctx->xCapture == NULL) {
+
+    vIoErrorExit ("Unable to read %s: %s", ctx->sReplayFile, strerror (errno));
+  }
+  for (ulIndex = 0; ulIndex < SIZEOF_ILIST (iFunctionList); ulIndex++) {
+
+    bIsValid |= (xHdr.iFunction == iFunctionList[ulIndex]);
+  }
+  if ( (!bIsValid) || (xHdr.iMode > eModeTcp) ||
+       (xHdr.iFormat > eFormatDouble) || (xHdr.iOrder > eOrderDcba)) {
+
+    vIoErrorExit ("Unable to read %s: %s", ctx->sReplayFile, strerror (EINVAL));
+  }
+
+  ctx->eMode = xHdr.iMode;
+  ctx->eFunction = xHdr.iFunction;
+  ctx->eFormat = xHdr.iFormat;
+  ctx->eOrder = xHdr.iOrder;
+  ctx->iPduOffset = xHdr.iPduOffset;
+  ctx->iPollRate = xHdr.iPollRate;
+  ctx->iCount = xHdr.iCount;
+  free (ctx->piStartRef);
+  ctx->piStartRef = xHdr.piRef;
+  ctx->iStartCount = xHdr.iRefCount;
+  free (ctx->piEvery);
+  ctx->piEvery = xHdr.piEvery;
+  ctx->iEveryCount = xHdr.iRefCount;
+  free (ctx->piSlaveAddr);
+  ctx->piSlaveAddr = xHdr.piSlave;
+  ctx->iSlaveCount = xHdr.iSlaveCount;
+  ctx->sDevice = xHdr.sDevice;
+  ctx->bIsWrite = false;
+  ctx->iCoalesceGap = -1;
+  if (ctx->eOutput != eOutputText) {
+
+    // seuls les enregistrements sont écrits sur la sortie standard
+    ctx->bIsQuiet = true;
+  }
+  for (i = 0; (i < ctx->iEveryCount) && (ctx->piEvery[i] == 1); i++)
+    ;
+  if (i == ctx->iEveryCount) {
+
+    // toutes les références étaient lues à chaque cycle
+    free (ctx->piEvery);
+    ctx->piEvery = NULL;
+  }
+  vSetDeadbands (ctx);
+
+  vAllocate (ctx);
+  if ( (ctx->iElemBits != xHdr.iElemBits) || (ctx->iNbReg != xHdr.iBlockSize)) {
+
+    vIoErrorExit ("Unable to read %s: %s", ctx->sReplayFile, strerror (EINVAL));
+  }
+  vBuildPlan (ctx);
+  vAllocateSlaves (ctx);
+  if (false == ctx->bIsQuiet) {
+    vPrintConfig (ctx);
+  }
+  vSetSignals();
+  if (ctx->eOutput == eOutputCsv) {
+
+    vPrintCsvHeader (ctx);
+  }
+
+  while ( (iRet = iCaptureReadCycle (ctx->xCapture, &ctx->iCycleCount)) > 0) {
+    uint64_t ullTime = 0;
+
+    for (i = 0; (i < ctx->iSlaveCount) && (iRet > 0); i++) {
+      xSlave * xSlv = &ctx->xSlaves[i];
+      bool bIsPolled;
+
+      if (iCaptureReadSlave (ctx->xCapture, &bIsPolled, &xSlv->ullTime) != 0) {
+
+        iRet = -1;
+        break;
+      }
+      xSlv->bIsSkipped = !bIsPolled;
+      if (xSlv->bIsSkipped) {
+        continue;
+      }
+      ullTime = xSlv->ullTime;
+      for (j = 0; j < ctx->iStartCount; j++) {
+
+        if ( (POLL_PLAN_IS_DUE (ctx->xPlan->piRefEvery[j], ctx->iCycleCount)) &&
+             (iCaptureReadBlock (ctx->xCapture, i, j, &xSlv->piError[j],
+                                 (uint8_t *) xSlv->pvData +
+                                 j * ctx->ulDataSize) != 0)) {
+
+          iRet = -1;
+          break;
+        }
+      }
+    }
+    if (iRet < 0) {
+      break;
+    }
+
+    if ( (ctx->bIsRealtime) && (ullTime != 0)) {
+
+      // les cycles sont affichés aux mêmes intervalles que pendant la capture
+      if (ullOrigin == 0) {
+
+        ullOrigin = ullTime;
+        ullStart = ullTimeNowUs ();
+      }
+      vTimeSleepUntilUs (ullStart + (ullTime - ullOrigin));
+    }
+    for (i = 0; i < ctx->iSlaveCount; i++) {
+
+      vEndSlavePoll (&ctx->xSlaves[i], ctx);
+    }
+    vFlushOutput (ctx);
+    iCycles++;
+  }
 
   if (iRet < 0) {
 
-    fprintf (stderr, "Report slave ID failed(%d): %s\n", iRet,
-             modbus_strerror (errno));
+    vIoErrorExit ("Unable to read %s after %d cycles: %s", ctx->sReplayFile,
+                  iCycles, (errno == EINVAL) ?
+                  "truncated or corrupted capture" : strerror (errno));
   }
-  else {
+  if (false == ctx->bIsQuiet) {
 
-    if (iRet > 1) {
-      int iLen = iRet - 2;
+    fprintf ( (ctx->eOutput == eOutputText) ? stdout : stderr,
+              "--- %s replay ---\n%d cycles replayed\n", ctx->sReplayFile,
+              iCycles);
+  }
+  vSigIntHandler (0);
+}
 
-      printf (
-        "Length: %d\n"
-        "Id    : 0x%02X\n"
-        "Status: %s\n"
-        , iRet
-        , ucReport[0]
-        , (ucReport[1]) ? "On" : "Off"
-      );
+// -----------------------------------------------------------------------------
+// Ecriture en une fois des résultats accumulés, après ce qui attend encore
+// dans le tampon de stdout
+void
+vFlushOutput (xMbPollContext * ctx) {
 
-      if (iLen > 0) {
-        int i;
-        printf ("Data  : ");
-        for (i = 2; i < (iLen + 2); i++) {
+  fflush (stdout);
+  if (iOutBufFlush (&ctx->xOut, fileno (stdout)) != 0) {
 
-          if (isprint (ucReport[i])) {
+    vIoErrorExit ("Output failed: %s", strerror (errno));
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ajout d'une chaîne entre guillemets, échappée selon les règles JSON ou CSV
+// (RFC 8259 et RFC 4180), les octets nuls sont ignorés
+static void
+vPrintQuoted (xOutBuf * b, const char * s, size_t ulLen, bool bIsJson) {
+  size_t i;
+
+  vOutBufPutc (b, '"');
+  for (i = 0; i < ulLen; i++) {
+    unsigned char c = s[i];
+
+    if (c == 0) {
+      continue;
+    }
+    if (bIsJson) {
+
+      if ( (c == '"') || (c == '\\')) {
+
+        vOutBufPutc (b, '\\');
+      }
+      else if ( (c < 0x20) || (c >= 0x7F)) {
+
+        // les octets non ASCII sont pris comme des caractères latin-1
+        vOutBufPrintf (b, "\\u%04x", c);
+        continue;
+      }
+    }
+    else if (c == '"') {
+
+      vOutBufPutc (b, '"');
+    }
+    vOutBufPutc (b, c);
+  }
+  vOutBufPutc (b, '"');
+}
+
+// -----------------------------------------------------------------------------
+// Ajout de la valeur de rang i d'un bloc lu, décodée selon le format
+static void
+vPrintValue (xOutBuf * b, const void * pvData, int i, bool bIsJson,
+             const xMbPollContext * ctx) {
+
+  switch (ctx->eFormat) {
+
+    case eFormatBin:
+    case eFormatMask:
+      vOutBufPutc (b, bBitsGet (pvData, i) ? '1' : '0');
+      break;
+
+    case eFormatDec:
+      PUT_FMT (b, iFmtU32, DUINT16 (pvData, i));
+      break;
+
+    case eFormatInt16:
+      PUT_FMT (b, iFmtI32, (int16_t) DUINT16 (pvData, i));
+      break;
+
+    case eFormatHex:
+      if (ctx->iElemBits == 1) {
+
+        // les bits ne sont pas regroupés en mots dans les enregistrements
+        vOutBufPutc (b, bBitsGet (pvData, i) ? '1' : '0');
+      }
+      else {
+
+        if (bIsJson) {
+          vOutBufPutc (b, '"');
+        }
+        PUT_FMT (b, iFmtHex16, DUINT16 (pvData, i));
+        if (bIsJson) {
+          vOutBufPutc (b, '"');
+        }
+      }
+      break;
+
+    case eFormatString: {
+      char c[2];
+
+      c[0] = (char) (DUINT16 (pvData, i) / 256);
+      c[1] = (char) (DUINT16 (pvData, i) % 256);
+      vPrintQuoted (b, c, 2, bIsJson);
+    }
+    break;
+
+    case eFormatInt:
+      PUT_FMT (b, iFmtI32, DINT32 (pvData, i));
+      break;
+
+    case eFormatUInt32:
+      PUT_FMT (b, iFmtU32, DUINT32 (pvData, i));
+      break;
+
+    case eFormatInt64:
+      PUT_FMT (b, iFmtI64, DINT64 (pvData, i));
+      break;
+
+    case eFormatFloat:
+    case eFormatDouble: {
+      double v = (ctx->eFormat == eFormatFloat) ?
+                 DFLOAT (pvData, i) : DDOUBLE (pvData, i);
+
+      // JSON n'a pas de représentation pour nan et inf
+      if (!isfinite (v)) {
+
+        if (bIsJson) {
+          vOutBufPuts (b, "null");
+        }
+      }
+      else if (ctx->eFormat == eFormatFloat) {
+
+        PUT_FMT (b, iFmtFloat, DFLOAT (pvData, i));
+      }
+      else {
+
+        PUT_FMT (b, iFmtDouble, v);
+      }
+    }
+    break;
+
+    default:  // Impossible normalement
+      break;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ajout au tampon de sortie de l'entête CSV
+void
+vPrintCsvHeader (xMbPollContext * ctx) {
+  int i;
+
+  vOutBufPuts (&ctx->xOut, (ctx->iBusCount > 0) ?
+               "time,bus,slave,function,reference,error" :
+               "time,slave,function,reference,error");
+  if (ctx->bIsOnChange) {
+
+    // une valeur par enregistrement
+    vOutBufPuts (&ctx->xOut, ",value");
+  }
+  else {
+
+    for (i = 0; i < ctx->iCount; i++) {
+
+      vOutBufPrintf (&ctx->xOut, ",value%d", i + 1);
+    }
+  }
+  vOutBufPutc (&ctx->xOut, '\n');
+}
+
+// -----------------------------------------------------------------------------
+// Ajout au tampon de sortie de l'enregistrement JSON Lines ou CSV d'une
+// référence de départ lue : heure, esclave, fonction, référence, erreur et
+// iNum valeurs décodées à partir du rang iFirst de pvData. La référence est
+// celle de la première valeur.
+void
+vPrintRecord (const xSlave * xSlv, int j, const void * pvData,
+              int iFirst, int iNum, xMbPollContext * ctx) {
+  xOutBuf * b = &ctx->xOut;
+  bool bIsJson = (ctx->eOutput == eOutputJsonl);
+  int i, iError = xSlv->piError[j];
+  int iRef = ctx->piStartRef[j] + iFirst * ctx->iValueWords;
+  // toutes les lignes CSV ont le même nombre de colonnes
+  int iColumns = ctx->bIsOnChange ? 1 : ctx->iCount;
+  const char * sError = iError ? modbus_strerror (iError) : NULL;
+
+  if (bIsJson) {
+
+    vOutBufPrintf (b, "{\"time\":%"PRIu64".%06u,",
+                   xSlv->ullTime / 1000000,
+                   (unsigned) (xSlv->ullTime % 1000000));
+    if (ctx->iBusCount > 0) {
+      const char * sDevice = ctx->xBuses[xSlv->iBus].sName;
+
+      vOutBufPuts (b, "\"bus\":");
+      vPrintQuoted (b, sDevice, strlen (sDevice), true);
+      vOutBufPutc (b, ',');
+    }
+    vOutBufPrintf (b, "\"slave\":%d,\"function\":%d,\"reference\":%d,"
+                   "\"error\":", xSlv->iAddr, iFunctionCode (ctx->eFunction),
+                   iRef);
+    if (sError) {
+
+      vPrintQuoted (b, sError, strlen (sError), true);
+    }
+    else {
+
+      vOutBufPuts (b, "null,\"values\":[");
+      for (i = 0; i < iNum; i++) {
+
+        if (i) {
+          vOutBufPutc (b, ',');
+        }
+        vPrintValue (b, pvData, iFirst + i, true, ctx);
+      }
+      vOutBufPutc (b, ']');
+    }
+    vOutBufPuts (b, "}\n");
+  }
+  else {
+
+    vOutBufPrintf (b, "%"PRIu64".%06u,", xSlv->ullTime / 1000000,
+                   (unsigned) (xSlv->ullTime % 1000000));
+    if (ctx->iBusCount > 0) {
+      const char * sDevice = ctx->xBuses[xSlv->iBus].sName;
+
+      vPrintQuoted (b, sDevice, strlen (sDevice), false);
+      vOutBufPutc (b, ',');
+    }
+    vOutBufPrintf (b, "%d,%d,%d,", xSlv->iAddr, iFunctionCode (ctx->eFunction),
+                   iRef);
+    if (sError) {
+
+      vPrintQuoted (b, sError, strlen (sError), false);
+    }
+    for (i = 0; i < iColumns; i++) {
+
+      vOutBufPutc (b, ',');
+      if ( (!sError) && (i < iNum)) {
+        vPrintValue (b, pvData, iFirst + i, false, ctx);
+      }
+    }
+    vOutBufPutc (b, '\n');
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Fin de la scrutation d'un esclave : affichage et mise à jour de son état
+void
+vEndSlavePoll (xSlave * xSlv, xMbPollContext * ctx) {
+  int j;
+
+  if (xSlv->bIsSkipped) {
+    return;
+  }
+  // les erreurs sont comptées ici, même si leur cycle n'est pas affiché
+  for (j = 0; j < ctx->iStartCount; j++) {
+
+    if ( (xSlv->piError[j]) &&
+         (POLL_PLAN_IS_DUE (ctx->xPlan->piRefEvery[j], ctx->iCycleCount))) {
+      ctx->iErrorCount++;
+    }
+  }
+#ifdef MBPOLL_PTHREAD
+  if (ctx->xQueue == NULL) {
+    vPrintSlave (xSlv, ctx->iCycleCount, ctx);
+  }
+#else
+  vPrintSlave (xSlv, ctx->iCycleCount, ctx);
+#endif
+  if (ctx->iDownAfter > 0) {
+    vUpdateHealth (xSlv, ctx);
+  }
+}
+
+#ifdef MBPOLL_PIPELINE
+// -----------------------------------------------------------------------------
+// Préparation des requêtes d'une suite d'esclaves pour le moteur
+// d'évènements, une par esclave et par requête du plan à échéance
+void
+vPrepareBatch (xMbBatch * xBatch, xLink * xLnk, xSlave * xSlv, int iCount,
+               const xMbPollContext * ctx) {
+  const xPollPlan * xPlan = ctx->xPlan;
+  int i, r, n = 0;
+
+  for (i = 0; i < iCount; i++) {
+
+    if (xSlv[i].bIsSkipped) {
+      continue;
+    }
+    for (r = 0; r < xPlan->iReadCount; r++) {
+      xMbRequest * xReq;
+
+      if (!POLL_PLAN_IS_DUE (xPlan->xReads[r].iEvery, ctx->iCycleCount)) {
+        continue;
+      }
+      xReq = &xLnk->xReq[n++];
+
+      xReq->iSlave = xSlv[i].iAddr;
+      xReq->iFunction = iFunctionCode (ctx->eFunction);
+      xReq->iAddr = xPlan->xReads[r].iAddr;
+      xReq->iCount = xPlan->xReads[r].iCount;
+      if (ctx->iElemBits == 1) {
+
+        xReq->pvDest = xSlv[i].pvImage;
+        xReq->iBit = xPlan->xReads[r].iOffset;
+      }
+      else {
+
+        xReq->pvDest = (uint8_t *) xSlv[i].pvImage +
+                       xPlan->xReads[r].iOffset * ctx->iElemBits / 8;
+        xReq->iBit = 0;
+      }
+      xReq->ullTimeout = (ctx->dRtoMin > 0) ? ullRtoValue (&xSlv[i].xRto) : 0;
+      xReq->iError = 0;
+    }
+  }
+  xBatch->xPipe = xLnk->xPipe;
+#ifdef MBPOLL_RTU
+  xBatch->xRtu = xLnk->xRtu;
+#else
+  xBatch->xRtu = NULL;
+#endif
+  xBatch->xReq = xLnk->xReq;
+  xBatch->iCount = n;
+}
+
+// -----------------------------------------------------------------------------
+// Résultats des requêtes d'une suite d'esclaves exécutées par le moteur
+void
+vEndBatch (const xMbBatch * xBatch, xLink * xLnk, xSlave * xSlv, int iCount,
+           const xMbPollContext * ctx) {
+  const xPollPlan * xPlan = ctx->xPlan;
+  uint64_t ullTime = ullTimeRealUs();
+  int i, r, n = 0;
+
+  if ( (xBatch->iResult < 0) && (xBatch->xPipe || xBatch->xRtu)) {
+
+    vLinkDown (xLnk, xBatch->iError, ctx);
+  }
+  for (i = 0; i < iCount; i++) {
+
+    if (xSlv[i].bIsSkipped) {
+      continue;
+    }
+    xSlv[i].ullTime = ullTime;
+    for (r = 0; r < xPlan->iReadCount; r++) {
+
+      if (POLL_PLAN_IS_DUE (xPlan->xReads[r].iEvery, ctx->iCycleCount)) {
+        const xMbRequest * xReq = &xBatch->xReq[n++];
+
+        xSlv[i].piReadError[r] = xReq->iError;
+        vRecordTransaction (&xSlv[i], xReq->iCount, xReq->iError,
+                            xReq->ullRtt, ctx);
+      }
+    }
+    vPollPlanScatter (xPlan, xSlv[i].pvImage, xSlv[i].pvData,
+                      xSlv[i].piReadError, xSlv[i].piError,
+                      ctx->iCycleCount);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Lecture de tous les esclaves sur toutes les connexions à la fois, depuis
+// le thread principal : chaque connexion reçoit une part contiguë de la liste
+// des esclaves, ceux de sa passerelle avec --gateway ou de son bus avec
+// --bus, et le moteur d'évènements les fait avancer ensemble
+void
+vPollLinks (xMbPollContext * ctx) {
+  xMbBatch xBatch[WORKERS_MAX];
+  int iFirst[WORKERS_MAX + 1];
+  bool bIsUp[WORKERS_MAX];
+  int i, k, n = 0;
+
+  vLinkRanges (ctx, iFirst);
+  for (k = 0; k < ctx->iWorkers; k++) {
+    xLink * xLnk = &ctx->xLinks[k];
+    xSlave * xSlv = &ctx->xSlaves[iFirst[k]];
+    int iCount = iFirst[k + 1] - iFirst[k];
+
+    bIsUp[k] = bLinkIsUp (xLnk, ctx);
+    if (bIsUp[k]) {
+
+      vPrepareBatch (&xBatch[n++], xLnk, xSlv, iCount, ctx);
+    }
+    else {
+
+      // connexion rompue, les requêtes échouent sans être envoyées
+      for (i = 0; i < iCount; i++) {
+        vFailSlave (&xSlv[i], ENOTCONN, ctx);
+        xSlv[i].ullTime = ullTimeRealUs();
+      }
+    }
+  }
+
+  iMbEngineRun (ctx->xEngine, xBatch, n);
+
+  for (k = 0, n = 0; k < ctx->iWorkers; k++) {
+
+    if (bIsUp[k]) {
+
+      vEndBatch (&xBatch[n++], &ctx->xLinks[k], &ctx->xSlaves[iFirst[k]],
+                 iFirst[k + 1] - iFirst[k], ctx);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Préparation des écritures d'une suite d'esclaves pour le moteur
+// d'évènements ou le port série, une requête par esclave
+void
+vPrepareWrites (xMbBatch * xBatch, xLink * xLnk, xTarget * xTgt, int iCount,
+                const xMbPollContext * ctx) {
+  int i;
+
+  for (i = 0; i < iCount; i++) {
+    xMbRequest * xReq = &xLnk->xReq[i];
+
+    memset (xReq, 0, sizeof (xMbRequest));
+    xReq->iSlave = xTgt[i].iAddr;
+    xReq->iFunction = iWriteFunctionCode (ctx);
+    xReq->iAddr = ctx->piStartRef[0] - ctx->iPduOffset;
+    xReq->iCount = ctx->iNbReg;
+    xReq->pvSrc = ctx->pvData;
+  }
+  xBatch->xPipe = xLnk->xPipe;
+#ifdef MBPOLL_RTU
+  xBatch->xRtu = xLnk->xRtu;
+#else
+  xBatch->xRtu = NULL;
+#endif
+  xBatch->xReq = xLnk->xReq;
+  xBatch->iCount = iCount;
+}
+
+// -----------------------------------------------------------------------------
+// Résultats des écritures d'une suite d'esclaves
+void
+vEndWrites (const xMbBatch * xBatch, xLink * xLnk, xTarget * xTgt,
+            int iCount, const xMbPollContext * ctx) {
+  int i;
+
+  if ( (xBatch->iResult < 0) && (xBatch->xPipe || xBatch->xRtu)) {
+
+    vLinkDown (xLnk, xBatch->iError, ctx);
+  }
+  for (i = 0; i < iCount; i++) {
+
+    xTgt[i].iError = xBatch->xReq[i].iError;
+    xTgt[i].ullRtt = xBatch->xReq[i].ullRtt;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture vers tous les esclaves sur toutes les connexions à la fois,
+// répartis comme pour la scrutation
+void
+vWriteLinks (xMbPollContext * ctx) {
+  xMbBatch xBatch[WORKERS_MAX];
+  int iFirst[WORKERS_MAX + 1];
+  bool bIsUp[WORKERS_MAX];
+  int k, n = 0;
+
+  vLinkRanges (ctx, iFirst);
+  for (k = 0; k < ctx->iWorkers; k++) {
+    xTarget * xTgt = &ctx->xTargets[iFirst[k]];
+    int iCount = iFirst[k + 1] - iFirst[k];
+
+    bIsUp[k] = bLinkIsUp (&ctx->xLinks[k], ctx);
+    if (bIsUp[k]) {
+
+      vPrepareWrites (&xBatch[n++], &ctx->xLinks[k], xTgt, iCount, ctx);
+    }
+    else {
+
+      // connexion rompue, les écritures échouent sans être envoyées
+      vFailTargets (xTgt, iCount, ENOTCONN);
+    }
+  }
+
+  iMbEngineRun (ctx->xEngine, xBatch, n);
+
+  for (k = 0, n = 0; k < ctx->iWorkers; k++) {
+
+    if (bIsUp[k]) {
+
+      vEndWrites (&xBatch[n++], &ctx->xLinks[k], &ctx->xTargets[iFirst[k]],
+                  iFirst[k + 1] - iFirst[k], ctx);
+    }
+  }
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Lecture d'une suite d'esclaves sur une connexion
+int
+iPollSlaves (xLink * xLnk, xSlave * xSlv, int iCount,
+             const xMbPollContext * ctx) {
+  int i, iErrors = 0;
+
+#ifdef MBPOLL_PIPELINE
+  if (ctx->iPipeline > 0) {
+    xMbBatch xBatch;
+
+    if (!bLinkIsUp (xLnk, ctx)) {
+
+      // connexion rompue, les requêtes échouent sans être envoyées
+      for (i = 0; i < iCount; i++) {
+        vFailSlave (&xSlv[i], ENOTCONN, ctx);
+        xSlv[i].ullTime = ullTimeRealUs();
+      }
+      return iCount;
+    }
+    vPrepareBatch (&xBatch, xLnk, xSlv, iCount, ctx);
+    iMbEngineRun (ctx->xEngine, &xBatch, 1);
+    vEndBatch (&xBatch, xLnk, xSlv, iCount, ctx);
+    return xBatch.iResult;
+  }
+#endif
+#ifdef MBPOLL_RTU
+  if (ctx->bIsNativeRtu) {
+    xMbBatch xBatch;
+
+    if (!bLinkIsUp (xLnk, ctx)) {
+
+      // port fermé après une erreur, les requêtes échouent sans être envoyées
+      for (i = 0; i < iCount; i++) {
+        vFailSlave (&xSlv[i], ENOTCONN, ctx);
+        xSlv[i].ullTime = ullTimeRealUs();
+      }
+      return iCount;
+    }
+    vPrepareBatch (&xBatch, xLnk, xSlv, iCount, ctx);
+    iMbEngineRun (ctx->xEngine, &xBatch, 1);
+    vEndBatch (&xBatch, xLnk, xSlv, iCount, ctx);
+    return xBatch.iResult;
+  }
+#endif
+
+  for (i = 0; i < iCount; i++) {
+    int r;
+
+    if ( (ctx->eMode == eModeTcp) && (!bLinkIsUp (xLnk, ctx))) {
+
+      vFailSlave (&xSlv[i], ENOTCONN, ctx);
+      xSlv[i].ullTime = ullTimeRealUs();
+      iErrors++;
+      continue;
+    }
+    iErrors += iPollSlave (xLnk->xBus, &xSlv[i], ctx);
+    xSlv[i].ullTime = ullTimeRealUs();
+
+    for (r = 0; (r < ctx->xPlan->iReadCount) && !xLnk->bIsDown; r++) {
+
+      if (bIsLinkError (xSlv[i].piReadError[r])) {
+
+        vLinkDown (xLnk, xSlv[i].piReadError[r], ctx);
+      }
+    }
+  }
+  return iErrors;
+}
+
+// -----------------------------------------------------------------------------
+// Mise en erreur de toutes les requêtes d'un esclave
+void
+vFailSlave (xSlave * xSlv, int iError, const xMbPollContext * ctx) {
+  const xPollPlan * xPlan = ctx->xPlan;
+  int r;
+
+  if (xSlv->bIsSkipped) {
+    return;
+  }
+  for (r = 0; r < xPlan->iReadCount; r++) {
+
+    xSlv->piReadError[r] = iError;
+  }
+  vPollPlanScatter (xPlan, xSlv->pvImage, xSlv->pvData,
+                    xSlv->piReadError, xSlv->piError, ctx->iCycleCount);
+}
+
+// -----------------------------------------------------------------------------
+// Indique si l'erreur d'une requête signifie que la connexion est rompue
+bool
+bIsLinkError (int iError) {
+
+  switch (iError) {
+    case ECONNRESET:
+    case ECONNABORTED:
+    case ENOTCONN:
+    case EPIPE:
+    case EBADF:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Fermeture d'une connexion rompue, la reconnexion sera tentée dès la
+// prochaine scrutation
+void
+vLinkDown (xLink * xLnk, int iError, const xMbPollContext * ctx) {
+
+#ifdef MBPOLL_PIPELINE
+  if (xLnk->xPipe) {
+
+    vMbPipeClose (xLnk->xPipe);
+    xLnk->xPipe = NULL;
+  }
+#endif
+#ifdef MBPOLL_RTU
+  if (xLnk->xRtu) {
+
+    vMbRtuClose (xLnk->xRtu);
+    xLnk->xRtu = NULL;
+  }
+#endif
+  if (xLnk->xBus) {
+    modbus_close (xLnk->xBus);
+  }
+
+  xLnk->bIsDown = true;
+  xLnk->ullDownSince = ullTimeNowUs();
+  xLnk->ullNextAttempt = xLnk->ullDownSince;
+  xLnk->ullBackoff = RECONNECT_DELAY_MIN * 1000ULL;
+  fprintf (stderr, "-- Connection to %s lost: %s\n", xLnk->sName,
+           modbus_strerror (iError));
+}
+
+// -----------------------------------------------------------------------------
+// Vérifie qu'une connexion est établie, une connexion rompue est rétablie si
+// l'échéance de la tentative suivante est atteinte, les tentatives sont
+// espacées de RECONNECT_DELAY_MIN à RECONNECT_DELAY_MAX ms (x2 à chaque échec)
+bool
+bLinkIsUp (xLink * xLnk, const xMbPollContext * ctx) {
+  uint64_t ullNow;
+  bool bIsConnected;
+
+  if (!xLnk->bIsDown) {
+    return true;
+  }
+  ullNow = ullTimeNowUs();
+  if (ullNow < xLnk->ullNextAttempt) {
+    return false;
+  }
+
+#ifdef MBPOLL_PIPELINE
+  if (ctx->iPipeline > 0) {
+
+    xLnk->xPipe = xMbPipeOpen (xLnk->sDevice, xLnk->sTcpPort, ctx->iPipeline,
+                               ctx->dTimeout, ctx->bIsVerbose);
+    bIsConnected = (xLnk->xPipe != NULL);
+  }
+  else
+#endif
+#ifdef MBPOLL_RTU
+  if (ctx->bIsNativeRtu) {
+
+    xLnk->xRtu = xMbRtuOpen (xLnk->sDevice, xLnk->xIos, ctx->dTimeout,
+                             ctx->iRtuGap, ctx->bIsVerbose);
+    bIsConnected = (xLnk->xRtu != NULL);
+  }
+  else
+#endif
+  {
+    bIsConnected = (modbus_connect (xLnk->xBus) == 0);
+  }
+
+  ullNow = ullTimeNowUs();
+  if (bIsConnected) {
+    uint64_t ullDown = ullNow - xLnk->ullDownSince;
+
+    xLnk->bIsDown = false;
+    xLnk->ullDownTime += ullDown;
+    xLnk->iReconnectCount++;
+    fprintf (stderr, "-- Reconnected to %s after %.1f s\n", xLnk->sName,
+             ullDown / 1E6);
+    return true;
+  }
+
+  xLnk->ullNextAttempt = ullNow + xLnk->ullBackoff;
+  xLnk->ullBackoff = MIN (xLnk->ullBackoff * 2, RECONNECT_DELAY_MAX * 1000ULL);
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// Ouverture des connexions de scrutation, une par thread de travail, la
+// première réutilise le contexte libmodbus principal
+void
+vOpenLinks (xMbPollContext * ctx) {
+  // une requête par esclave et par lecture du plan, une seule en écriture
+  int iReqCount = ctx->iSlaveCount *
+                  (ctx->bIsWrite ? 1 : ctx->xPlan->iReadCount);
+  int i;
+
+  ctx->xLinks = calloc (ctx->iWorkers, sizeof (xLink));
+  assert (ctx->xLinks);
+#ifdef MBPOLL_PIPELINE
+  if ( (ctx->iPipeline > 0) || (ctx->bIsNativeRtu)) {
+
+    ctx->xEngine = xMbEngineNew();
+    if (ctx->xEngine == NULL) {
+
+      vIoErrorExit ("Unable to create the event engine: %s", strerror (errno));
+    }
+  }
+#endif
+
+  for (i = 0; i < ctx->iWorkers; i++) {
+    xLink * xLnk = &ctx->xLinks[i];
+
+    if (ctx->iBusCount > 0) {
+
+      // chaque bus ou passerelle a son lien
+      xLnk->sDevice = ctx->xBuses[i].sDevice;
+      xLnk->sTcpPort = ctx->xBuses[i].sTcpPort;
+      xLnk->sName = ctx->xBuses[i].sName;
+    }
+    else {
+
+      xLnk->sDevice = ctx->sDevice;
+      xLnk->sTcpPort = ctx->sTcpPort;
+      xLnk->sName = ctx->sDevice;
+    }
+#ifdef MBPOLL_PIPELINE
+    if (ctx->iPipeline > 0) {
+
+      xLnk->xPipe = xMbPipeOpen (xLnk->sDevice, xLnk->sTcpPort,
+                                 ctx->iPipeline, ctx->dTimeout,
+                                 ctx->bIsVerbose);
+      if (xLnk->xPipe == NULL) {
+
+        vIoErrorExit ("Connection to %s failed: %s", xLnk->sName,
+                      modbus_strerror (errno));
+      }
+      xLnk->xReq = calloc (iReqCount, sizeof (xMbRequest));
+      assert (xLnk->xReq);
+    }
+#endif
+#ifdef MBPOLL_RTU
+    if (ctx->bIsNativeRtu) {
+      const xSerialIos * xIos = &ctx->xRtu;
+
+      if (ctx->iBusCount > 0) {
+
+        // un port par lien, chacun avec sa configuration de ligne
+        xIos = &ctx->xBuses[i].xIos;
+      }
+      xLnk->xIos = xIos;
+      // t3.5 de silence sont respectés avant la première trame
+      xLnk->xRtu = xMbRtuOpen (xLnk->sDevice, xIos, ctx->dTimeout,
+                               ctx->iRtuGap, ctx->bIsVerbose);
+      if (xLnk->xRtu == NULL) {
+
+        vIoErrorExit ("Connection to %s failed: %s", xLnk->sName,
+                      modbus_strerror (errno));
+      }
+      xLnk->xReq = calloc (iReqCount, sizeof (xMbRequest));
+      assert (xLnk->xReq);
+    }
+#endif
+
+    if (i == 0) {
+
+      xLnk->xBus = ctx->xBus;
+    }
+    else if (ctx->iBusCount == 0) {
+
+      xLnk->xBus = modbus_new_tcp_pi (ctx->sDevice, ctx->sTcpPort);
+      if (xLnk->xBus == NULL) {
+
+        vIoErrorExit ("Unable to create the libmodbus context");
+      }
+      modbus_set_debug (xLnk->xBus, ctx->bIsVerbose);
+      vSetResponseTimeout (xLnk->xBus, ctx->dTimeout);
+      if ( (ctx->iPipeline == 0) && (modbus_connect (xLnk->xBus) == -1)) {
+
+        vIoErrorExit ("Connection %d failed: %s", i + 1,
+                      modbus_strerror (errno));
+      }
+    }
+  }
+
+#ifdef MBPOLL_PTHREAD
+  // les connexions pipelinées et les bus sont tous menés par le thread
+  // principal
+  if ( (ctx->iWorkers > 1) && (ctx->iPipeline == 0) && (ctx->iBusCount == 0)) {
+    void * pvWorker[WORKERS_MAX];
+
+    for (i = 0; i < ctx->iWorkers; i++) {
+
+      pvWorker[i] = &ctx->xLinks[i];
+    }
+    ctx->xPool = xWorkerPoolNew (ctx->iWorkers, pvWorker);
+    if (ctx->xPool == NULL) {
+
+      vIoErrorExit ("Unable to start %d workers", ctx->iWorkers);
+    }
+  }
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Arrêt des threads et fermeture des connexions de scrutation
+void
+vCloseLinks (xMbPollContext * ctx) {
+
+#ifdef MBPOLL_PTHREAD
+  vWorkerPoolDelete (ctx->xPool);
+  ctx->xPool = NULL;
+#endif
+  if (ctx->xLinks) {
+    int i;
+
+    for (i = 0; i < ctx->iWorkers; i++) {
+      xLink * xLnk = &ctx->xLinks[i];
+
+#ifdef MBPOLL_PIPELINE
+      vMbPipeClose (xLnk->xPipe);
+      free (xLnk->xReq);
+#endif
+#ifdef MBPOLL_RTU
+      vMbRtuClose (xLnk->xRtu);
+#endif
+      if ( (i > 0) && (xLnk->xBus)) {
+
+        modbus_close (xLnk->xBus);
+        modbus_free (xLnk->xBus);
+      }
+    }
+    free (ctx->xLinks);
+    ctx->xLinks = NULL;
+  }
+#ifdef MBPOLL_PIPELINE
+  vMbEngineDelete (ctx->xEngine);
+  ctx->xEngine = NULL;
+#endif
+}
+
+#ifdef MBPOLL_PTHREAD
+// -----------------------------------------------------------------------------
+// Tâche d'un thread de travail, pvWorker est sa connexion
+void
+vPollSlaveJob (void * pvWorker, int iIndex, void * pvUser) {
+  xMbPollContext * ctx = (xMbPollContext *) pvUser;
+
+  iPollSlaves ( (xLink *) pvWorker, &ctx->xSlaves[iIndex], 1, ctx);
+}
+
+// -----------------------------------------------------------------------------
+// Tâche d'écriture d'un thread de travail, pvWorker est sa connexion
+void
+vWriteSlaveJob (void * pvWorker, int iIndex, void * pvUser) {
+  xMbPollContext * ctx = (xMbPollContext *) pvUser;
+
+  vWriteSlaves ( (xLink *) pvWorker, &ctx->xTargets[iIndex], 1, ctx);
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// Rang du premier esclave de chaque connexion dans la liste des esclaves,
+// piFirst[iWorkers] est le nombre d'esclaves : une part contiguë par
+// connexion, ou les esclaves de sa passerelle avec --gateway
+void
+vLinkRanges (const xMbPollContext * ctx, int * piFirst) {
+  int k;
+
+  for (k = 0; k <= ctx->iWorkers; k++) {
+
+    if (ctx->iBusCount > 0) {
+
+      // chaque passerelle a sa connexion (--gateway)
+      piFirst[k] = (k < ctx->iBusCount) ? ctx->xBuses[k].iFirst :
+                   ctx->iSlaveCount;
+    }
+    else {
+
+      piFirst[k] = k * ctx->iSlaveCount / ctx->iWorkers;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Code fonction de l'écriture, une seule requête écrit toutes les valeurs
+int
+iWriteFunctionCode (const xMbPollContext * ctx) {
+
+  if (ctx->eFunction == eFuncCoil) {
+
+    return (ctx->iNbReg == 1) ? 5 : 15;
+  }
+  return ( (ctx->iNbReg == 1) && (!ctx->bWriteSingleAsMany)) ? 6 : 16;
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture des valeurs vers un esclave par libmodbus
+void
+vWriteSlave (modbus_t * xBus, xTarget * xTgt, const xMbPollContext * ctx) {
+  // libmodbus utilise les adresses PDU !
+  int iStartReg = ctx->piStartRef[0] - ctx->iPduOffset;
+  int iNbReg = ctx->iNbReg;
+  uint64_t ullStart;
+  int iRet = -1;
+
+  modbus_set_slave (xBus, xTgt->iAddr);
+  ullStart = ullTimeNowUs();
+  switch (ctx->eFunction) {
+
+    case eFuncCoil:
+      if (iNbReg == 1) {
+
+        // Ecriture d'un seul bit
+        iRet = modbus_write_bit (xBus, iStartReg, bBitsGet (ctx->pvData, 0));
+      }
+      else {
+        // libmodbus attend un bit par octet
+        uint8_t * pucBits = malloc (iNbReg);
+
+        assert (pucBits);
+        vBitsUnpack (pucBits, ctx->pvData, 0, iNbReg);
+        iRet = modbus_write_bits (xBus, iStartReg, iNbReg, pucBits);
+        free (pucBits);
+      }
+      break;
+
+    case eFuncHoldingReg:
+      if (iNbReg == 1 && (!ctx->bWriteSingleAsMany)) {
+
+        // Ecriture d'un seul registre
+        iRet = modbus_write_register (xBus, iStartReg, DUINT16 (ctx->pvData, 0));
+      }
+      else {
+
+        iRet =  modbus_write_registers (xBus, iStartReg, iNbReg, ctx->pvData);
+      }
+      break;
+
+    default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
+      break;
+  }
+  if (iRet == iNbReg) {
+
+    xTgt->iError = 0;
+    xTgt->ullRtt = ullTimeNowUs() - ullStart;
+  }
+  else {
+
+    xTgt->iError = (iRet < 0) ? errno : EMBBADDATA;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Mise en erreur des écritures d'une suite d'esclaves
+void
+vFailTargets (xTarget * xTgt, int iCount, int iError) {
+  int i;
+
+  for (i = 0; i < iCount; i++) {
+
+    xTgt[i].iError = iError;
+    xTgt[i].ullRtt = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture vers une suite d'esclaves sur une connexion
+void
+vWriteSlaves (xLink * xLnk, xTarget * xTgt, int iCount,
+              const xMbPollContext * ctx) {
+  int i;
+
+#ifdef MBPOLL_PIPELINE
+  if (ctx->iPipeline > 0) {
+    xMbBatch xBatch;
+
+    if (!bLinkIsUp (xLnk, ctx)) {
+
+      vFailTargets (xTgt, iCount, ENOTCONN);
+      return;
+    }
+    vPrepareWrites (&xBatch, xLnk, xTgt, iCount, ctx);
+    iMbEngineRun (ctx->xEngine, &xBatch, 1);
+    vEndWrites (&xBatch, xLnk, xTgt, iCount, ctx);
+    return;
+  }
+#endif
+#ifdef MBPOLL_RTU
+  if (ctx->bIsNativeRtu) {
+    xMbBatch xBatch;
+
+    if (!bLinkIsUp (xLnk, ctx)) {
+
+      vFailTargets (xTgt, iCount, ENOTCONN);
+      return;
+    }
+    vPrepareWrites (&xBatch, xLnk, xTgt, iCount, ctx);
+    iMbEngineRun (ctx->xEngine, &xBatch, 1);
+    vEndWrites (&xBatch, xLnk, xTgt, iCount, ctx);
+    return;
+  }
+#endif
+
+  for (i = 0; i < iCount; i++) {
+
+    vWriteSlave (xLnk->xBus, &xTgt[i], ctx);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ecriture vers tous les esclaves, en parallèle quand le transport le
+// permet : un thread par connexion (--workers), ou toutes les connexions
+// pipelinées et tous les bus (--bus) menés ensemble par le moteur
+// d'évènements. Sur un même port série, les esclaves sont écrits l'un après
+// l'autre.
+void
+vWriteTargets (xMbPollContext * ctx) {
+
+#ifdef MBPOLL_PTHREAD
+  if (ctx->xPool) {
+
+    iWorkerPoolRun (ctx->xPool, ctx->iSlaveCount, vWriteSlaveJob, ctx);
+    return;
+  }
+#endif
+#ifdef MBPOLL_PIPELINE
+  if ( (ctx->iPipeline > 0) || (ctx->iBusCount > 0)) {
+
+    vWriteLinks (ctx);
+    return;
+  }
+#endif
+  vWriteSlaves (&ctx->xLinks[0], ctx->xTargets, ctx->iSlaveCount, ctx);
+}
+
+// -----------------------------------------------------------------------------
+// Affichage du résultat de l'écriture vers chaque esclave, les échecs sont
+// comptés dans iErrorCount. Le résultat d'un esclave seul est affiché sans
+// son adresse ni son temps de réponse.
+void
+vPrintWrites (xMbPollContext * ctx, uint64_t ullElapsed) {
+  bool bIsList = (ctx->iSlaveCount > 1) || (ctx->iBusCount > 0);
+  // avec --bus, une même adresse peut être utilisée sur plusieurs bus
+  const char * sOn = (ctx->iBusCount > 0) ? " on " : "";
+  int i, iWritten = 0;
+
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    const xTarget * xTgt = &ctx->xTargets[i];
+    const char * sDevice = (ctx->iBusCount > 0) ?
+                           ctx->xBuses[xTgt->iBus].sName : "";
+
+    if (xTgt->iError) {
+
+      ctx->iErrorCount++;
+      if (bIsList) {
+
+        fprintf (stderr, "Write %s to slave %d%s%s failed: %s\n",
+                 sFunctionToStr (ctx->eFunction), xTgt->iAddr, sOn, sDevice,
+                 modbus_strerror (xTgt->iError));
+      }
+      else {
+
+        fprintf (stderr, "Write %s failed: %s\n",
+                 sFunctionToStr (ctx->eFunction),
+                 modbus_strerror (xTgt->iError));
+      }
+      continue;
+    }
+
+    iWritten++;
+    if (ctx->bIsBroadcast) {
+
+      // aucun esclave ne confirme une diffusion
+      printf ("Broadcast %d references.\n", ctx->iCount);
+    }
+    else if (bIsList) {
+
+      printf ("Written %d references to slave %d%s%s in %.1f ms\n",
+              ctx->iCount, xTgt->iAddr, sOn, sDevice, xTgt->ullRtt / 1000.0);
+    }
+    else {
+
+      printf ("Written %d references.\n", ctx->iCount);
+    }
+  }
+  if (bIsList) {
+
+    printf ("-- %d of %d slaves written in %.1f ms\n", iWritten,
+            ctx->iSlaveCount, ullElapsed / 1000.0);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Ajout d'un bus (--bus=DEVICE@SLAVES[@LINE]) ou d'une passerelle
+// (--gateway=HOST[:PORT]@SLAVES), le premier est celui de la ligne de
+// commande, complété par vMergeBuses()
+void
+vAddBus (xMbPollContext * ctx, char * sSpec, bool bIsGateway) {
+  const char * sName = bIsGateway ? sGatewayStr : sBusStr;
+  xSerialBus * xBus;
+  char * sSlaves, * sLine;
+
+  sSlaves = strchr (sSpec, '@');
+  if ( (sSlaves == NULL) || (sSlaves == sSpec) || (sSlaves[1] == 0)) {
+
+    vSyntaxErrorExit ("Illegal %s: %s", sName, sSpec);
+  }
+  if (ctx->iBusCount == 0) {
+
+    // l'emplacement 0 est celui du port principal, complété par vMergeBuses()
+    ctx->xBuses = calloc (1, sizeof (xSerialBus));
+    assert (ctx->xBuses);
+    ctx->iBusCount = 1;
+  }
+  if (ctx->iBusCount >= BUS_MAX) {
+
+    vSyntaxErrorExit ("Too many buses, %d max.", BUS_MAX);
+  }
+  ctx->xBuses = realloc (ctx->xBuses,
+                         (ctx->iBusCount + 1) * sizeof (xSerialBus));
+  assert (ctx->xBuses);
+  xBus = &ctx->xBuses[ctx->iBusCount++];
+  memset (xBus, 0, sizeof (xSerialBus));
+
+  // le nom du port et la liste des esclaves restent dans argv
+  *sSlaves++ = 0;
+  sLine = strchr (sSlaves, '@');
+  if (sLine) {
+
+    if (bIsGateway) {
+      vSyntaxErrorExit ("Illegal %s: %s", sName, sLine);
+    }
+    *sLine++ = 0;
+    vGetSerialLine (sName, sLine, &xBus->xIos);
+    xBus->bHasIos = true;
+  }
+  xBus->sDevice = sSpec;
+  if (bIsGateway) {
+    char * p;
+
+    // une adresse IPv6 suivie d'un port est entre crochets : [::1]:502
+    xBus->bIsGateway = true;
+    p = (*sSpec == '[') ? strchr (sSpec, ']') : sSpec;
+    if (p == NULL) {
+
+      vSyntaxErrorExit ("Illegal %s: %s", sName, sSpec);
+    }
+    if (p != sSpec) {
+
+      *p++ = 0;
+      xBus->sDevice = sSpec + 1;
+    }
+    p = strchr (p, ':');
+    if (p) {
+
+      *p++ = 0;
+      vCheckIntRange (sTcpPortStr, iGetInt (sTcpPortStr, p, 10),
+                      TCP_PORT_MIN, TCP_PORT_MAX);
+      xBus->sTcpPort = p;
+    }
+    if (*xBus->sDevice == 0) {
+
+      vSyntaxErrorExit ("Illegal %s: no host", sName);
+    }
+  }
+  xBus->piSlaveAddr = iGetIntList (sSlaveAddrStr, sSlaves, &xBus->iSlaveCount);
+  if (xBus->piSlaveAddr == NULL) {
+
+    vSyntaxErrorExit ("Illegal %s: no slave on %s", sName, xBus->sDevice);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Le port de la ligne de commande devient le premier bus, les listes
+// d'esclaves des bus sont mises bout à bout dans piSlaveAddr, dans l'ordre
+// des bus
+void
+vMergeBuses (xMbPollContext * ctx) {
+  int i, k, iCount = 0;
+  int * piSlaveAddr;
+
+  ctx->xBuses[0].sDevice = ctx->sDevice;
+  ctx->xBuses[0].xIos = ctx->xRtu;
+  ctx->xBuses[0].piSlaveAddr = ctx->piSlaveAddr;
+  ctx->xBuses[0].iSlaveCount = ctx->iSlaveCount;
+  ctx->xBuses[0].bIsGateway = ctx->xBuses[1].bIsGateway;
+  // le port principal prend le port TCP et la ligne série par défaut
+  ctx->xBuses[0].sTcpPort = NULL;
+  ctx->xBuses[0].bHasIos = false;
+  ctx->xBuses[0].sName = NULL;
+
+  for (k = 0; k < ctx->iBusCount; k++) {
+    xSerialBus * xBus = &ctx->xBuses[k];
+
+    if (xBus->bIsGateway != ctx->xBuses[0].bIsGateway) {
+      vSyntaxErrorExit ("--bus and --gateway can not be used together");
+    }
+    if (xBus->bIsGateway) {
+      // une adresse IPv6 est mise entre crochets devant le port
+      const char * sFormat = strchr (xBus->sDevice, ':') ? "[%s]:%s" : "%s:%s";
+      size_t ulSize;
+
+      if (xBus->sTcpPort == NULL) {
+        xBus->sTcpPort = ctx->sTcpPort;
+      }
+      ulSize = strlen (xBus->sDevice) + strlen (xBus->sTcpPort) + 4;
+      xBus->sName = malloc (ulSize);
+      assert (xBus->sName);
+      snprintf (xBus->sName, ulSize, sFormat, xBus->sDevice, xBus->sTcpPort);
+    }
+    else {
+
+      xBus->sName = strdup (xBus->sDevice);
+      assert (xBus->sName);
+    }
+    if (!xBus->bHasIos) {
+
+      xBus->xIos = ctx->xRtu;
+    }
+    else if (xBus->xIos.dbits == SERIAL_DATABIT_UNKNOWN) {
+
+      // seule la vitesse est propre au bus
+      xBus->xIos.dbits = ctx->xRtu.dbits;
+      xBus->xIos.parity = ctx->xRtu.parity;
+      xBus->xIos.sbits = ctx->xRtu.sbits;
+    }
+    for (i = 0; i < k; i++) {
+
+      if ( (strcmp (ctx->xBuses[i].sDevice, xBus->sDevice) == 0) &&
+           ( (!xBus->bIsGateway) ||
+             (strcmp (ctx->xBuses[i].sTcpPort, xBus->sTcpPort) == 0))) {
+        vSyntaxErrorExit ("%s is given twice", xBus->sName);
+      }
+    }
+    xBus->iFirst = iCount;
+    iCount += xBus->iSlaveCount;
+  }
+
+  piSlaveAddr = malloc (iCount * sizeof (int));
+  assert (piSlaveAddr);
+  for (k = 0; k < ctx->iBusCount; k++) {
+    xSerialBus * xBus = &ctx->xBuses[k];
+
+    memcpy (&piSlaveAddr[xBus->iFirst], xBus->piSlaveAddr,
+            xBus->iSlaveCount * sizeof (int));
+    free (xBus->piSlaveAddr);
+    xBus->piSlaveAddr = NULL;
+  }
+  ctx->piSlaveAddr = piSlaveAddr;
+  ctx->iSlaveCount = iCount;
+}
+
+// -----------------------------------------------------------------------------
+// Nombre de valeurs affichées sur une ligne : les bits sont affichés par
+// mots de 16 en mode texte, sauf au format binaire
+int
+iLineValues (const xMbPollContext * ctx) {
+
+  return ( (ctx->iElemBits == 1) && (ctx->eFormat != eFormatBin) &&
+           (ctx->eOutput == eOutputText)) ? 16 : 1;
+}
+
+// -----------------------------------------------------------------------------
+void
+vPrintReadValues (xOutBuf * b, int iAddr, int iCount, const void * pvData,
+                  const xMbPollContext * ctx) {
+  int i, iStep = iLineValues (ctx);
+
+  for (i = 0; i < iCount; i += iStep) {
+
+    vPrintReadLine (b, iAddr, iCount, pvData, i, ctx);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Affichage de la ligne qui commence à la valeur de rang i d'un bloc lu à
+// partir de la référence iAddr
+void
+vPrintReadLine (xOutBuf * b, int iAddr, int iCount, const void * pvData,
+                int i, const xMbPollContext * ctx) {
+
+  vOutBufPutc (b, '[');
+  PUT_FMT (b, iFmtI32, iAddr + i * ctx->iValueWords);
+  vOutBufPuts (b, "]: \t");
+
+  if (iLineValues (ctx) > 1) {
+    // bits affichés par mots de 16, le premier bit est le poids faible
+    int n = MIN (16, iCount - i);
+    uint16_t usWord = usBitsWord (pvData, i, n);
+
+    if (ctx->eFormat == eFormatHex) {
+
+      PUT_FMT (b, iFmtHex16, usWord);
+    }
+    else {
+
+      while (n--) {
+        vOutBufPutc (b, (usWord & (1 << n)) ? '1' : '0');
+      }
+    }
+    vOutBufPutc (b, '\n');
+    return;
+  }
+
+  switch (ctx->eFormat) {
+
+    case eFormatBin:
+      vOutBufPutc (b, bBitsGet (pvData, i) ? '1' : '0');
+      break;
+
+    case eFormatDec: {
+      uint16_t v = DUINT16 (pvData, i);
+
+      PUT_FMT (b, iFmtU32, v);
+      if (v & 0x8000) {
+
+        vOutBufPuts (b, " (");
+        PUT_FMT (b, iFmtI32, (int16_t) v);
+        vOutBufPutc (b, ')');
+      }
+    }
+    break;
+
+    case eFormatInt16:
+      PUT_FMT (b, iFmtI32, (int16_t) DUINT16 (pvData, i));
+      break;
+
+    case eFormatHex:
+      PUT_FMT (b, iFmtHex16, DUINT16 (pvData, i));
+      break;
+
+    case eFormatString:
+      vOutBufPutc (b, (char) (DUINT16 (pvData, i) / 256));
+      vOutBufPutc (b, (char) (DUINT16 (pvData, i) % 256));
+      break;
+
+    case eFormatInt:
+      PUT_FMT (b, iFmtI32, DINT32 (pvData, i));
+      break;
+
+    case eFormatUInt32:
+      PUT_FMT (b, iFmtU32, DUINT32 (pvData, i));
+      break;
+
+    case eFormatFloat:
+      PUT_FMT (b, iFmtFloat, DFLOAT (pvData, i));
+      break;
+
+    case eFormatInt64:
+      PUT_FMT (b, iFmtI64, DINT64 (pvData, i));
+      break;
+
+    case eFormatDouble:
+      PUT_FMT (b, iFmtDouble, DDOUBLE (pvData, i));
+      break;
+
+    default:  // Impossible normalement
+      break;
+  }
+  vOutBufPutc (b, '\n');
+}
+
+// -----------------------------------------------------------------------------
+void
+vReportSlaveID (const xMbPollContext * ctx) {
+  uint8_t ucReport[256];
+
+  modbus_set_slave (ctx->xBus, ctx->piSlaveAddr[0]);
+  // Affichage de la configuration
+  printf ("Protocol configuration: ModBus %s\n", sModeList[ctx->eMode]);
+  printf ("Slave configuration...: address = %d, report slave id\n",
+          ctx->piSlaveAddr[0]);
+
+  vPrintCommunicationSetup (ctx);
+
+  int iRet = modbus_report_slave_id (ctx->xBus, 256, ucReport);
+
+  if (iRet < 0) {
+
+    fprintf (stderr, "Report slave ID failed(%d): %s\n", iRet,
+             modbus_strerror (errno));
+  }
+  else {
+
+    if (iRet > 1) {
+      int iLen = iRet - 2;
+
+      printf (
+        "Length: %d\n"
+        "Id    : 0x%02X\n"
+        "Status: %s\n"
+        , iRet
+        , ucReport[0]
+        , (ucReport[1]) ? "On" : "Off"
+      );
+
+      if (iLen > 0) {
+        int i;
+        printf ("Data  : ");
+        for (i = 2; i < (iLen + 2); i++) {
+
+          if (isprint (ucReport[i])) {
+
+            putchar (ucReport[i]);
+          }
+          else {
+
+            printf ("\\%02X", ucReport[i]);
+          }
+        }
+        putchar ('\n');
+      }
+    }
+    else {
+
+      fprintf (stderr, "no data available\n");
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vPrintCommunicationSetup (const xMbPollContext * ctx) {
+
+  if (ctx->sReplayFile) {
+
+    printf ("Communication.........: replay of %s, captured from %s\n"
+            "                        poll rate %d ms\n"
+            , ctx->sReplayFile
+            , ctx->sDevice
+            , ctx->iPollRate);
+  }
+  else if (ctx->iBusCount > 0) {
+    int k;
+
+    for (k = 0; k < ctx->iBusCount; k++) {
+      const xSerialBus * xBus = &ctx->xBuses[k];
+
+      if (xBus->bIsGateway) {
+
+        printf ("%s%s, port %s, slaves ",
+                k ? "                        " : "Communication.........: ",
+                xBus->sDevice, xBus->sTcpPort);
+      }
+      else {
+
+        printf ("%s%s, %s, slaves ",
+                k ? "                        " : "Communication.........: ",
+                xBus->sDevice, sSerialAttrToStr (&xBus->xIos));
+      }
+      vPrintIntList (&ctx->piSlaveAddr[xBus->iFirst], xBus->iSlaveCount);
+      putchar ('\n');
+    }
+    printf ("                        t/o %.2f s, poll rate %d ms\n"
+            , ctx->dTimeout
+            , ctx->iPollRate);
+  }
+  else if (ctx->eMode == eModeRtu) {
+#ifndef USE_CHIPIO
+// -----------------------------------------------------------------------------
+    const char sAddStr[] = "";
+#else /* USE_CHIPIO defined */
+// -----------------------------------------------------------------------------
+    const char * sAddStr;
+    if (ctx->bIsChipIo) {
+      sAddStr = " via ChipIo serial port";
+    }
+    else {
+
+      sAddStr = "";
+    }
+// -----------------------------------------------------------------------------
+#endif /* USE_CHIPIO defined */
+
+    printf ("Communication.........: %s%s, %s\n"
+            "                        t/o %.2f s, poll rate %d ms\n"
+            , ctx->sDevice
+            , sAddStr
+            , sSerialAttrToStr (&ctx->xRtu)
+            , ctx->dTimeout
+            , ctx->iPollRate);
+  }
+  else {
+
+    printf ("Communication.........: %s, port %s, t/o %.2f s, poll rate %d ms\n"
+            , ctx->sDevice
+            , ctx->sTcpPort
+            , ctx->dTimeout
+            , ctx->iPollRate);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vPrintConfig (const xMbPollContext * ctx) {
+
+  // Affichage de la configuration
+  printf ("Protocol configuration: ModBus %s\n", sModeList[ctx->eMode]);
+  printf ("Slave configuration...: address = ");
+  vPrintIntList (ctx->piSlaveAddr, ctx->iSlaveCount);
+  if (ctx->bIsBroadcast) {
+    printf (" (broadcast)");
+  }
+  if (ctx->iStartCount > 1) {
+    printf ("\n                        start reference = ");
+    vPrintIntList (ctx->piStartRef, ctx->iStartCount);
+    printf ("\n");
+  }
+  else {
+    printf ("\n                        start reference = %d, count = %d\n",
+            ctx->piStartRef[0], ctx->iCount);
+  }
+  if (ctx->piEvery) {
+    printf ("                        every %d ms x ", ctx->iPollRate);
+    vPrintIntList (ctx->piEvery, ctx->iEveryCount);
+    putchar ('\n');
+  }
+  if (ctx->bIsOnChange) {
+    printf ("                        on change");
+    if (ctx->xDeadbands) {
+      int i;
+
+      printf (", deadband = [");
+      for (i = 0; i < ctx->iDeadbandCount; i++) {
+        printf ("%s%g%s", i ? "," : "", ctx->xDeadbands[i].dValue,
+                ctx->xDeadbands[i].bIsPercent ? "%" : "");
+      }
+      putchar (']');
+    }
+    putchar ('\n');
+  }
+  if ( (ctx->xPlan) && (ctx->iCoalesceGap >= 0)) {
+    printf ("                        %d request(s) per slave, coalesced with gap <= %d\n",
+            ctx->xPlan->iReadCount, ctx->iCoalesceGap);
+  }
+  vPrintCommunicationSetup (ctx);
+  printf ("Data type.............: ");
+  switch (ctx->eFunction) {
+
+    case eFuncDiscreteInput:
+      printf ("discrete input\n");
+      break;
+
+    case eFuncCoil:
+      printf ("discrete output (coil)\n");
+      break;
+
+    case eFuncInputReg:
+      vPrintValueType (ctx);
+      printf (", input register table\n");
+      break;
+
+    case eFuncHoldingReg:
+      vPrintValueType (ctx);
+      printf (", output (holding) register table\n");
+      break;
+
+    default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
+      break;
+  }
+  putchar ('\n');
+}
+
+// -----------------------------------------------------------------------------
+// Nombre de registres de 16 bits occupés par une valeur
+int
+iFormatWords (eFormats eFormat) {
+
+  switch (eFormat) {
+
+    case eFormatInt:
+    case eFormatUInt32:
+    case eFormatFloat:
+      return 2;
+
+    case eFormatInt64:
+    case eFormatDouble:
+      return 4;
+
+    default:
+      return 1;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Affichage du type des valeurs lues dans une table de registres
+void
+vPrintValueType (const xMbPollContext * ctx) {
+  const char * sType;
+
+  switch (ctx->eFormat) {
+
+    case eFormatInt:
+      sType = sIntStr;
+      break;
+
+    case eFormatUInt32:
+      sType = sUInt32Str;
+      break;
+
+    case eFormatFloat:
+      sType = sFloatStr;
+      break;
+
+    case eFormatInt64:
+      sType = sInt64Str;
+      break;
+
+    case eFormatDouble:
+      sType = sDoubleStr;
+      break;
+
+    default:
+      printf ("%s", sWordStr);
+      return;
+  }
+  printf ("%s (%s)", sType, sOrderList[ctx->eOrder]);
+}
+
+// -----------------------------------------------------------------------------
+// Conversion d'un bloc lu en valeurs de l'hôte, en une seule passe pour tout
+// le bloc. Le bloc n'est pas modifié, le résultat est dans pvDecoded.
+const void *
+pvDecodeBlock (const void * pvBlock, const xMbPollContext * ctx) {
+
+  if (ctx->iValueWords == 1) {
+    return pvBlock;
+  }
+  memcpy (ctx->pvDecoded, pvBlock, ctx->ulDataSize);
+  vDecodeWords (ctx->pvDecoded, ctx->iCount, ctx->iValueWords, ctx->eOrder);
+  return ctx->pvDecoded;
+}
+
+// -----------------------------------------------------------------------------
+// Allocation de la mémoire pour les données à écrire ou à lire
+void
+vAllocate (xMbPollContext * ctx) {
+
+  size_t ulDataSize = ctx->iCount;
+  switch (ctx->eFunction) {
+
+    case eFuncCoil:
+    case eFuncDiscreteInput:
+      // 8 bits sont stockés dans un octet
+      ulDataSize = BITS_SIZE (ctx->iCount);
+      break;
+
+    case eFuncInputReg:
+    case eFuncHoldingReg:
+      // Registres 16-bits, 2 ou 4 par valeur pour les formats 32 ou 64 bits
+      ctx->iValueWords = iFormatWords (ctx->eFormat);
+      ulDataSize *= 2 * ctx->iValueWords;
+      break;
+
+    default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
+      break;
+  }
+  ctx->pvData = calloc (1, ulDataSize);
+  assert (ctx->pvData);
+  ctx->ulDataSize = ulDataSize;
+  if (ctx->iValueWords > 1) {
+
+    ctx->pvDecoded = malloc (ulDataSize);
+    assert (ctx->pvDecoded);
+  }
+
+  // bits compactés, un registre par mot de 16 bits
+  if ( (ctx->eFunction == eFuncCoil) || (ctx->eFunction == eFuncDiscreteInput)) {
+
+    ctx->iElemBits = 1;
+    ctx->iNbReg = ctx->iCount;
+  }
+  else {
+
+    ctx->iElemBits = 16;
+    ctx->iNbReg = ulDataSize / 2;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Construction du plan de scrutation : requêtes à envoyer pour lire toutes
+// les références de départ
+void
+vBuildPlan (xMbPollContext * ctx) {
+  int i, * piAddr;
+  int iMaxPerRead = (ctx->iElemBits == 1) ? MODBUS_MAX_READ_BITS :
+                    MODBUS_MAX_READ_REGISTERS;
+
+  piAddr = calloc (ctx->iStartCount, sizeof (int));
+  assert (piAddr);
+  for (i = 0; i < ctx->iStartCount; i++) {
+
+    // libmodbus utilise les adresses PDU !
+    piAddr[i] = ctx->piStartRef[i] - ctx->iPduOffset;
+    if (piAddr[i] + ctx->iNbReg > STARTREF_MAX) {
+
+      vSyntaxErrorExit ("%s %d + %s exceeds the address space",
+                        sStartRefStr, ctx->piStartRef[i], sNumOfValuesStr);
+    }
+  }
+  ctx->xPlan = xPollPlanNew (piAddr, ctx->piEvery, ctx->iStartCount,
+                             ctx->iNbReg, ctx->iElemBits, iMaxPerRead,
+                             ctx->iCoalesceGap);
+  assert (ctx->xPlan);
+  free (piAddr);
+}
+
+// -----------------------------------------------------------------------------
+// Allocation des résultats de lecture, un bloc de données par esclave et par
+// référence de départ
+void
+vAllocateSlaves (xMbPollContext * ctx) {
+  int i, k;
+
+  ctx->xSlaves = calloc (ctx->iSlaveCount, sizeof (xSlave));
+  assert (ctx->xSlaves);
+
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    xSlave * xSlv = &ctx->xSlaves[i];
+
+    xSlv->iAddr = ctx->piSlaveAddr[i];
+    vRtoInit (&xSlv->xRto, (uint64_t) (ctx->dRtoMin * 1E6),
+              (uint64_t) (ctx->dTimeout * 1E6));
+    vHistoClear (&xSlv->xLatency);
+    xSlv->pvData = calloc (ctx->iStartCount, ctx->ulDataSize);
+    assert (xSlv->pvData);
+    xSlv->piError = calloc (ctx->iStartCount, sizeof (int));
+    assert (xSlv->piError);
+    xSlv->piReadError = calloc (ctx->xPlan->iReadCount, sizeof (int));
+    assert (xSlv->piReadError);
+    if (ctx->xPlan->bIsIdentity) {
+
+      xSlv->pvImage = xSlv->pvData;
+    }
+    else {
+
+      xSlv->pvImage = calloc (1, ctx->xPlan->ulImageBytes);
+      assert (xSlv->pvImage);
+    }
+    if (ctx->bIsOnChange) {
+
+      xSlv->pvReported = calloc (ctx->iStartCount, ctx->ulDataSize);
+      assert (xSlv->pvReported);
+      xSlv->pbIsReported = calloc (ctx->iStartCount, sizeof (bool));
+      assert (xSlv->pbIsReported);
+      xSlv->piReportedError = calloc (ctx->iStartCount, sizeof (int));
+      assert (xSlv->piReportedError);
+    }
+  }
+
+  for (k = 0; k < ctx->iBusCount; k++) {
+
+    for (i = 0; i < ctx->xBuses[k].iSlaveCount; i++) {
+      ctx->xSlaves[ctx->xBuses[k].iFirst + i].iBus = k;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vFreeSlaves (xMbPollContext * ctx) {
+
+  if (ctx->xSlaves) {
+    int i;
+
+    for (i = 0; i < ctx->iSlaveCount; i++) {
+
+      if (ctx->xSlaves[i].pvImage != ctx->xSlaves[i].pvData) {
+
+        free (ctx->xSlaves[i].pvImage);
+      }
+      free (ctx->xSlaves[i].pvData);
+      free (ctx->xSlaves[i].piError);
+      free (ctx->xSlaves[i].piReadError);
+      free (ctx->xSlaves[i].pvReported);
+      free (ctx->xSlaves[i].pbIsReported);
+      free (ctx->xSlaves[i].piReportedError);
+    }
+    free (ctx->xSlaves);
+    ctx->xSlaves = NULL;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Allocation des résultats d'écriture, un par esclave
+void
+vAllocateTargets (xMbPollContext * ctx) {
+  int i, k;
+
+  ctx->xTargets = calloc (ctx->iSlaveCount, sizeof (xTarget));
+  assert (ctx->xTargets);
+
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+
+    ctx->xTargets[i].iAddr = ctx->piSlaveAddr[i];
+  }
+  for (k = 0; k < ctx->iBusCount; k++) {
+
+    for (i = 0; i < ctx->xBuses[k].iSlaveCount; i++) {
+      ctx->xTargets[ctx->xBuses[k].iFirst + i].iBus = k;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Indique si l'esclave a répondu à une requête, même par une exception
+bool
+bIsResponse (int iError) {
+
+  return (iError == 0) ||
+         ( (iError > MODBUS_ENOBASE) && (iError <= EMBXGTAR));
+}
+
+// -----------------------------------------------------------------------------
+// Sélection des esclaves à scruter dans le cycle courant, un esclave hors
+// service n'est interrogé qu'à l'échéance de son prochain sondage
+void
+vSelectSlaves (xMbPollContext * ctx) {
+  int i;
+
+  for (i = 0; i < ctx->iSlaveCount; i++) {
+    xSlave * xSlv = &ctx->xSlaves[i];
+
+    xSlv->bIsSkipped = xSlv->bIsDown && (ctx->iCycleCount < xSlv->iNextProbe);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Mise à jour de l'état de santé d'un esclave après sa scrutation
+// Après iDownAfter scrutations consécutives sans aucune réponse, l'esclave
+// est mis hors service, il est alors sondé après 1, 2, 4... cycles (au plus
+// DOWN_BACKOFF_MAX) et revient en service à la première réponse.
+void
+vUpdateHealth (xSlave * xSlv, const xMbPollContext * ctx) {
+  const xPollPlan * xPlan = ctx->xPlan;
+  bool bHasAnswered = false, bIsLinkDown = false;
+  // avec --bus, une même adresse peut être utilisée sur plusieurs bus
+  const char * sOn = (ctx->iBusCount > 0) ? " on " : "";
+  const char * sDevice = (ctx->iBusCount > 0) ?
+                         ctx->xBuses[xSlv->iBus].sName : "";
+  int r;
+
+  for (r = 0; (r < xPlan->iReadCount) && !bHasAnswered; r++) {
+
+    if (POLL_PLAN_IS_DUE (xPlan->xReads[r].iEvery, ctx->iCycleCount)) {
+      bHasAnswered = bIsResponse (xSlv->piReadError[r]);
+      bIsLinkDown |= bIsLinkError (xSlv->piReadError[r]);
+    }
+  }
+  if ( (!bHasAnswered) && bIsLinkDown) {
+
+    // l'esclave n'est pas en cause si la connexion est rompue
+    return;
+  }
+
+  if (bHasAnswered) {
+
+    if (xSlv->bIsDown) {
+
+      fprintf (stderr, "-- Slave %d%s%s is back after %d failed polls\n",
+               xSlv->iAddr, sOn, sDevice, xSlv->iFailures);
+    }
+    xSlv->bIsDown = false;
+    xSlv->iFailures = 0;
+    return;
+  }
+
+  xSlv->iFailures++;
+  if (xSlv->bIsDown) {
+
+    xSlv->iBackoff = MIN (xSlv->iBackoff * 2, DOWN_BACKOFF_MAX);
+  }
+  else if (xSlv->iFailures >= ctx->iDownAfter) {
+
+    xSlv->bIsDown = true;
+    xSlv->iBackoff = 1;
+    xSlv->iDownCount++;
+  }
+  else {
+    return;
+  }
+  xSlv->iNextProbe = ctx->iCycleCount + xSlv->iBackoff + 1;
+  fprintf (stderr, "-- Slave %d%s%s is down, next probe in %d cycles\n",
+           xSlv->iAddr, sOn, sDevice, xSlv->iBackoff + 1);
+}
+
+// -----------------------------------------------------------------------------
+// Enregistrement du résultat d'une requête de iCount éléments : compteurs,
+// histogramme des temps de réponse et timeout adaptatif
+void
+vRecordTransaction (xSlave * xSlv, int iCount, int iError, uint64_t ullRtt,
+                    const xMbPollContext * ctx) {
+
+  vCountersRecordRead (&xSlv->xCounters, iFunctionCode (ctx->eFunction),
+                       iCount, iError,
+                       (ctx->eMode == eModeTcp) ? COUNTERS_TCP_OVERHEAD :
+                       COUNTERS_RTU_OVERHEAD);
+
+  if (bIsResponse (iError)) {
+
+    // une exception est une réponse, son temps est représentatif
+    vHistoRecord (&xSlv->xLatency, ullRtt);
+    if (ctx->dRtoMin > 0) {
+      vRtoSample (&xSlv->xRto, ullRtt);
+    }
+  }
+  else if ( (iError == ETIMEDOUT) && (ctx->dRtoMin > 0)) {
+
+    vRtoTimeout (&xSlv->xRto);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Affichage des compteurs de requêtes des iCount esclaves à partir du rang
+// iFirst, du débit depuis le début de la scrutation et, en RTU, du taux
+// d'occupation de leur bus configuré par xIos
+void
+vPrintTraffic (const xMbPollContext * ctx, int iFirst, int iCount,
+               const xSerialIos * xIos, FILE * f) {
+  xCounters xAll;
+  uint64_t ullReplies, ullExceptions;
+  double dElapsed = (ullTimeNowUs() - ctx->ullStartTime) / 1E6;
+  int i;
 
-            putchar (ucReport[i]);
-          }
-          else {
+  memset (&xAll, 0, sizeof (xAll));
+  for (i = iFirst; i < iFirst + iCount; i++) {
 
-            printf ("\\%02X", ucReport[i]);
-          }
-        }
-        putchar ('\n');
-      }
+    vCountersMerge (&xAll, &ctx->xSlaves[i].xCounters);
+  }
+  ullExceptions = ullCountersExceptions (&xAll);
+  // une réponse d'exception est une trame reçue
+  ullReplies = xAll.ullResponses + ullExceptions;
+
+  fprintf (f, "%"PRIu64" frames transmitted, %"PRIu64" received, "
+          "%"PRIu64" errors, %.1f%% frame loss\n",
+          xAll.ullRequests, ullReplies, xAll.ullRequests - xAll.ullResponses,
+          xAll.ullRequests ? (double) (xAll.ullRequests - ullReplies) * 100.0 /
+          (double) xAll.ullRequests : 0.0);
+  fprintf (f, "%"PRIu64" timeouts, %"PRIu64" exceptions, %"PRIu64" CRC errors, "
+          "%"PRIu64" other errors\n", xAll.ullTimeouts, ullExceptions,
+          xAll.ullCrcErrors, xAll.ullOtherErrors);
+  for (i = 1; i <= COUNTERS_EXCEPTION_MAX; i++) {
+
+    if (xAll.ullExceptions[i]) {
+      fprintf (f, "  exception %d: %"PRIu64" (%s)\n", i, xAll.ullExceptions[i],
+              modbus_strerror (MODBUS_ENOBASE + i));
     }
-    else {
+  }
 
-      fprintf (stderr, "no data available\n");
+  if (dElapsed > 0) {
+
+    fprintf (f, "%.1f requests/s, %.0f bytes/s out, %.0f bytes/s in\n",
+            xAll.ullRequests / dElapsed, xAll.ullBytesOut / dElapsed,
+            xAll.ullBytesIn / dElapsed);
+    if (ctx->eMode == eModeRtu) {
+      // start, données, parité et stop
+      double dCharBits = 1 + xIos->dbits +
+                         (xIos->parity != SERIAL_PARITY_NONE) +
+                         ( (xIos->sbits == SERIAL_STOPBIT_ONEHALF) ? 1.5 :
+                           xIos->sbits);
+
+      fprintf (f, "%.1f%% bus utilization at %ld bauds\n",
+              dCountersLineTime (&xAll, xIos->baud, dCharBits) * 100.0 /
+              dElapsed, xIos->baud);
     }
   }
 }
 
 // -----------------------------------------------------------------------------
+// Affichage des temps de réponse de chacun des iCount esclaves à partir du
+// rang iFirst et de leur ensemble
 void
-vPrintCommunicationSetup (const xMbPollContext * ctx) {
+vPrintLatency (const xMbPollContext * ctx, int iFirst, int iCount, FILE * f) {
+  static const double dQuantile[] = { 0.5, 0.9, 0.99, 0.999 };
+  xHisto xAll;
+  int i, q;
 
-  if (ctx->eMode == eModeRtu) {
-#ifndef USE_CHIPIO
-// -----------------------------------------------------------------------------
-    const char sAddStr[] = "";
-#else /* USE_CHIPIO defined */
-// -----------------------------------------------------------------------------
-    const char * sAddStr;
-    if (ctx->bIsChipIo) {
-      sAddStr = " via ChipIo serial port";
+  vHistoClear (&xAll);
+  fprintf (f, "%-16s %8s %8s %8s %8s %8s %8s %8s\n", "latency (ms)", "count",
+          "min", "p50", "p90", "p99", "p99.9", "max");
+
+  for (i = iFirst; i <= iFirst + iCount; i++) {
+    const xHisto * h;
+    char sName[32];
+
+    if (i < iFirst + iCount) {
+
+      h = &ctx->xSlaves[i].xLatency;
+      snprintf (sName, sizeof (sName), "slave %d", ctx->xSlaves[i].iAddr);
+      vHistoMerge (&xAll, h);
     }
     else {
 
-      sAddStr = "";
+      // la ligne de synthèse est inutile pour un seul esclave
+      if (iCount == 1) {
+        break;
+      }
+      h = &xAll;
+      snprintf (sName, sizeof (sName), "all");
     }
-// -----------------------------------------------------------------------------
-#endif /* USE_CHIPIO defined */
 
-    printf ("Communication.........: %s%s, %s\n"
-            "                        t/o %.2f s, poll rate %d ms\n"
-            , ctx->sDevice
-            , sAddStr
-            , sSerialAttrToStr (&ctx->xRtu)
-            , ctx->dTimeout
-            , ctx->iPollRate);
-  }
-  else {
+    fprintf (f, "%-16s %8"PRIu64, sName, h->ullCount);
+    if (h->ullCount) {
 
-    printf ("Communication.........: %s, port %s, t/o %.2f s, poll rate %d ms\n"
-            , ctx->sDevice
-            , ctx->sTcpPort
-            , ctx->dTimeout
-            , ctx->iPollRate);
+      fprintf (f, " %8.3f", h->ullMin / 1000.0);
+      for (q = 0; q < (int) (sizeof (dQuantile) / sizeof (double)); q++) {
+
+        fprintf (f, " %8.3f", ullHistoQuantile (h, dQuantile[q]) / 1000.0);
+      }
+      fprintf (f, " %8.3f", h->ullMax / 1000.0);
+    }
+    fputc ('\n', f);
   }
 }
 
 // -----------------------------------------------------------------------------
+// Affichage des compteurs et des temps de réponse de chaque bus, ou du seul
+// port scruté sans --bus
 void
-vPrintConfig (const xMbPollContext * ctx) {
+vPrintBuses (const xMbPollContext * ctx, const char * sTitle, FILE * f) {
+  int k;
 
-  // Affichage de la configuration
-  printf ("Protocol configuration: ModBus %s\n", sModeList[ctx->eMode]);
-  printf ("Slave configuration...: address = ");
-  vPrintIntList (ctx->piSlaveAddr, ctx->iSlaveCount);
-  if (ctx->iStartCount > 1) {
-    printf ("\n                        start reference = ");
-    vPrintIntList (ctx->piStartRef, ctx->iStartCount);
-    printf ("\n");
-  }
-  else {
-    printf ("\n                        start reference = %d, count = %d\n",
-            ctx->piStartRef[0], ctx->iCount);
+  if (ctx->iBusCount == 0) {
+
+    fprintf (f, "--- %s %s ---\n", ctx->sDevice, sTitle);
+    vPrintTraffic (ctx, 0, ctx->iSlaveCount, &ctx->xRtu, f);
+    vPrintLatency (ctx, 0, ctx->iSlaveCount, f);
+    return;
   }
-  vPrintCommunicationSetup (ctx);
-  printf ("Data type.............: ");
-  switch (ctx->eFunction) {
+  for (k = 0; k < ctx->iBusCount; k++) {
+    const xSerialBus * xBus = &ctx->xBuses[k];
 
-    case eFuncDiscreteInput:
-      printf ("discrete input\n");
-      break;
+    fprintf (f, "--- %s %s ---\n", xBus->sName, sTitle);
+    vPrintTraffic (ctx, xBus->iFirst, xBus->iSlaveCount, &xBus->xIos, f);
+    vPrintLatency (ctx, xBus->iFirst, xBus->iSlaveCount, f);
+  }
+}
 
-    case eFuncCoil:
-      printf ("discrete output (coil)\n");
-      break;
+// -----------------------------------------------------------------------------
+// Nom d'un esclave dans les statistiques, précédé de son bus avec --bus
+const char *
+sSlaveName (const xSlave * xSlv, const xMbPollContext * ctx) {
+  static char sName[256];
 
-    case eFuncInputReg:
-      if (ctx->eFormat == eFormatInt) {
-        printf ("%s %s", sIntStr, ctx->bIsBigEndian ? sBigEndianStr : sLittleEndianStr);
-      }
-      else if (ctx->eFormat == eFormatFloat) {
-        printf ("%s %s", sFloatStr, ctx->bIsBigEndian ? sBigEndianStr : sLittleEndianStr);
-      }
-      else {
-        printf ("%s", sWordStr);
-      }
-      printf (", input register table\n");
-      break;
+  if (ctx->iBusCount > 0) {
 
-    case eFuncHoldingReg:
-      if (ctx->eFormat == eFormatInt) {
-        printf ("%s %s", sIntStr, ctx->bIsBigEndian ? sBigEndianStr : sLittleEndianStr);
-      }
-      else if (ctx->eFormat == eFormatFloat) {
-        printf ("%s %s", sFloatStr, ctx->bIsBigEndian ? sBigEndianStr : sLittleEndianStr);
-      }
-      else {
-        printf ("%s", sWordStr);
-      }
-      printf (", output (holding) register table\n");
-      break;
+    snprintf (sName, sizeof (sName), "%s slave %d",
+              ctx->xBuses[xSlv->iBus].sName, xSlv->iAddr);
+  }
+  else {
 
-    default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
-      break;
+    snprintf (sName, sizeof (sName), "slave %d", xSlv->iAddr);
   }
-  putchar ('\n');
+  return sName;
 }
 
 // -----------------------------------------------------------------------------
-// Allocation de la mémoire pour les données à écrire ou à lire
 void
-vAllocate (xMbPollContext * ctx) {
+vSetResponseTimeout (modbus_t * xBus, double dTimeout) {
+  uint32_t  sec, usec;
 
-  size_t ulDataSize = ctx->iCount;
-  switch (ctx->eFunction) {
+  sec = (uint32_t) dTimeout;
+  usec = (uint32_t) ( (dTimeout - sec) * 1E6);
+  modbus_set_response_timeout (xBus, sec, usec);
+  PDEBUG ("Set response timeout to %"PRIu32" sec, %"PRIu32" us\n", sec, usec);
+}
 
-    case eFuncCoil:
-    case eFuncDiscreteInput:
-      // 1 bit est stocké dans un octet
-      break;
+// -----------------------------------------------------------------------------
+// Indique si au moins une requête du plan est à échéance dans le cycle courant
+bool
+bIsCycleDue (const xMbPollContext * ctx) {
+  int r;
 
-    case eFuncInputReg:
-    case eFuncHoldingReg:
-      if ( (ctx->eFormat == eFormatInt) || (ctx->eFormat == eFormatFloat)) {
-        // Registres 32-bits
-        ulDataSize *= 4;
-      }
-      else {
-        // Registres 16-bits
-        ulDataSize *= 2;
-      }
-      break;
+  for (r = 0; r < ctx->xPlan->iReadCount; r++) {
 
-    default: // Impossible, la valeur a été vérifiée, évite un warning de gcc
-      break;
+    if (POLL_PLAN_IS_DUE (ctx->xPlan->xReads[r].iEvery, ctx->iCycleCount)) {
+      return true;
+    }
   }
-  ctx->pvData = calloc (1, ulDataSize);
-  assert (ctx->pvData);
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// Attente du début du cycle suivant
+// Les échéances sont absolues (multiples de la période depuis le premier
+// cycle), la durée des échanges ne décale donc pas la scrutation. Un cycle
+// qui dépasse son échéance est compté, les échéances manquées sont abandonnées
+// et le cycle suivant démarre sur la prochaine échéance de la grille.
+void
+vWaitNextCycle (xMbPollContext * ctx) {
+  uint64_t ullPeriod = ctx->iPollRate * 1000ULL;
+  uint64_t ullNow = ullTimeNowUs ();
+
+  ctx->iCycleCount++;
+  ctx->ullNextCycle += ullPeriod;
+  if (ullNow > ctx->ullNextCycle) {
+    uint64_t ullLate = ullNow - ctx->ullNextCycle;
+
+    ctx->iOverrunCount++;
+    ctx->ullMaxOverrun = MAX (ctx->ullMaxOverrun, ullLate);
+    ctx->ullNextCycle += (ullLate / ullPeriod + 1) * ullPeriod;
+    if (ctx->bIsVerbose) {
+
+      fprintf (stderr, "Cycle %d overrun by %.1f ms\n",
+               ctx->iCycleCount, ullLate / 1000.0);
+    }
+  }
+  vTimeSleepUntilUs (ctx->ullNextCycle);
+}
+
+// -----------------------------------------------------------------------------
+void
+vSetSignals (void) {
+
+  signal (SIGINT, vSigIntHandler);
+  signal (SIGTERM, vSigIntHandler);
+#ifdef SIGHUP
+  signal (SIGHUP, vSigIntHandler);
+#endif
 }
 
 // -----------------------------------------------------------------------------
+// sig est 0 pour la fin normale du programme
 void
 vSigIntHandler (int sig) {
+  bool bIsBusy = false;
+  uint64_t ullOverflows = 0;
+  int k;
+  // la sortie standard est réservée aux enregistrements (--output)
+  FILE * f = (ctx.eOutput == eOutputText) ? stdout : stderr;
+
+#ifdef MBPOLL_PTHREAD
+  if (ctx.xQueue) {
+
+    // les cycles en attente sont affichés avant les statistiques
+    ullOverflows = ullRingOverflows (ctx.xQueue);
+    vRingDelete (ctx.xQueue);
+    ctx.xQueue = NULL;
+  }
+#endif
+
+  if ( (ctx.bIsPolling) && (!ctx.bIsWrite) && (!ctx.sReplayFile)) {
+
+    if ( (ctx.iBusCount > 0) && (ctx.xSlaves)) {
+
+      // chaque bus a ses statistiques, la scrutation est commune
+      vPrintBuses (&ctx, "poll statistics", f);
+      fprintf (f, "--- poll statistics ---\n");
+    }
+    else {
+
+      fprintf (f, "--- %s poll statistics ---\n", ctx.sDevice);
+      if (ctx.xSlaves) {
+        vPrintTraffic (&ctx, 0, ctx.iSlaveCount, &ctx.xRtu, f);
+      }
+    }
+    fprintf (f, "%d cycles of %d ms, %d overruns",
+            ctx.iCycleCount, ctx.iPollRate, ctx.iOverrunCount);
+    if (ctx.iOverrunCount) {
+
+      fprintf (f, " (%.1f ms max)", ctx.ullMaxOverrun / 1000.0);
+    }
+    fputc ('\n', f);
+    if (ctx.iQueueSize > 0) {
+
+      fprintf (f, "%"PRIu64" output overflows (%s)\n", ullOverflows,
+               sOverflowList[ctx.eOverflow]);
+    }
+    if ( (ctx.eMode == eModeTcp) && (ctx.xLinks)) {
+      int i, iReconnects = 0;
+      uint64_t ullDownTime = 0;
+
+      for (i = 0; i < ctx.iWorkers; i++) {
+        const xLink * xLnk = &ctx.xLinks[i];
 
-  if ( (ctx.bIsPolling) && (!ctx.bIsWrite)) {
+        iReconnects += xLnk->iReconnectCount;
+        ullDownTime += xLnk->ullDownTime;
+        if (xLnk->bIsDown) {
+          ullDownTime += ullTimeNowUs() - xLnk->ullDownSince;
+        }
+      }
+      fprintf (f, "%d reconnections, %.1f s without connection\n",
+              iReconnects, ullDownTime / 1E6);
+    }
+    if ( (ctx.xSlaves) && (ctx.iBusCount == 0)) {
+      vPrintLatency (&ctx, 0, ctx.iSlaveCount, f);
+    }
+    if ( (ctx.iDownAfter > 0) && (ctx.xSlaves)) {
+      int i;
+
+      for (i = 0; i < ctx.iSlaveCount; i++) {
+
+        if (ctx.xSlaves[i].iDownCount) {
+          fprintf (f, "%s: down %d time(s)%s\n",
+                  sSlaveName (&ctx.xSlaves[i], &ctx),
+                  ctx.xSlaves[i].iDownCount,
+                  ctx.xSlaves[i].bIsDown ? ", still down" : "");
+        }
+      }
+    }
+    if ( (ctx.dRtoMin > 0) && (ctx.xSlaves)) {
+      int i;
+
+      for (i = 0; i < ctx.iSlaveCount; i++) {
+        const xRto * xEst = &ctx.xSlaves[i].xRto;
 
-    printf ("--- %s poll statistics ---\n"
-            "%d frames transmitted, %d received, %d errors, %.1f%% frame loss\n",
-            ctx.sDevice,
-            ctx.iTxCount,
-            ctx.iRxCount,
-            ctx.iErrorCount,
-            (double) (ctx.iTxCount - ctx.iRxCount) * 100.0 /
-            (double) ctx.iTxCount);
+        fprintf (f, "%s: rtt %.1f ms, rttvar %.1f ms, time-out %.1f ms\n",
+                sSlaveName (&ctx.xSlaves[i], &ctx), xEst->ullSrtt / 1000.0,
+                xEst->ullRttVar / 1000.0, ullRtoValue (xEst) / 1000.0);
+      }
+    }
   }
 
-  free (ctx.pvData);
-  free (ctx.piSlaveAddr);
-  modbus_close (ctx.xBus);
-  modbus_free (ctx.xBus);
+#ifdef MBPOLL_PTHREAD
+  // les threads peuvent être en cours de lecture lors d'un signal, leurs
+  // connexions et leurs données seront libérées à la sortie du programme
+  bIsBusy = (sig != 0) && (ctx.xPool != NULL);
+#endif
+#ifdef MBPOLL_SHM
+  // seul le thread principal écrit dans le segment, il est supprimé même
+  // si des threads sont occupés, sinon il resterait dans /dev/shm
+  vShmDelete (ctx.xShm);
+  ctx.xShm = NULL;
+#endif
+  if (!bIsBusy) {
+
+    vCloseLinks (&ctx);
+    if ( (iCaptureClose (ctx.xCapture) != 0) && (sig != SIGINT)) {
+
+      fprintf (stderr, "%s: capture failed: %s\n", progname, strerror (errno));
+    }
+    ctx.xCapture = NULL;
+    vFreeSlaves (&ctx);
+    free (ctx.xTargets);
+    vOutBufFree (&ctx.xOut);
+    vPollPlanDelete (ctx.xPlan);
+    free (ctx.pvData);
+    free (ctx.pvDecoded);
+    free (ctx.piSlaveAddr);
+    free (ctx.piEvery);
+    free (ctx.xDeadbands);
+    for (k = 0; k < ctx.iBusCount; k++) {
+      free (ctx.xBuses[k].sName);
+    }
+    free (ctx.xBuses);
+    modbus_close (ctx.xBus);
+    modbus_free (ctx.xBus);
+  }
 #ifdef USE_CHIPIO
 // -----------------------------------------------------------------------------
   vChipIoSerialDelete (xChipSerial);
@@ -1304,10 +4714,10 @@ vSigIntHandler (int sig) {
 // -----------------------------------------------------------------------------
 #endif /* USE_CHIPIO defined */
   if (sig == SIGINT) {
-    printf ("\neverything was closed.\nHave a nice day !\n");
+    fprintf (f, "\neverything was closed.\nHave a nice day !\n");
   }
   else {
-    putchar ('\n');
+    fputc ('\n', f);
   }
   fflush (stdout);
   exit (ctx.iErrorCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
@@ -1414,17 +4824,25 @@ vUsage (FILE * stream, int exit_msg) {
            "General options : \n"
            "  -m #          mode (rtu or tcp, %s is default)\n"
            "  -a #          Slave address (%d-%d for rtu, %d-%d for tcp, %d is default)\n"
-           "                for reading, it is possible to give an address list\n"
-           "                separated by commas or colons, for example :\n"
+           "                it is possible to give an address list separated by\n"
+           "                commas or colons, for example :\n"
            "                -a 32,33,34,36:40 read [32,33,34,36,37,38,39,40]\n"
+           "                a write goes to each slave of the list, its result and\n"
+           "                response time are printed\n"
            "  -r #          Start reference (%d is default)\n"
            "                for reading, it is possible to give a reference list\n"
            "                separated by commas or colons\n"
            "  -c #          Number of values to read (%d-%d, %d is default)\n"
+           "                large reads are split into requests of %d registers\n"
+           "                or %d bits\n"
            "  -u            Read the description of the type, the current status, and other\n"
            "                information specific to a remote device (RTU only)\n"
            "  -t 0          Discrete output (coil) data type (binary 0 or 1)\n"
+           "  -t 0:hex      Discrete output (coil) data type, 16 per line in hex\n"
+           "  -t 0:mask     Discrete output (coil) data type, 16 per line as a bit mask\n"
            "  -t 1          Discrete input data type (binary 0 or 1)\n"
+           "  -t 1:hex      Discrete input data type, 16 per line in hex\n"
+           "  -t 1:mask     Discrete input data type, 16 per line as a bit mask\n"
            "  -t 3          16-bit input register data type\n"
            "  -t 3:int16    16-bit input register data type with signed int display\n"
            "  -t 3:hex      16-bit input register data type with hex display\n"
@@ -1432,6 +4850,11 @@ vUsage (FILE * stream, int exit_msg) {
            "  -t 3:int      32-bit integer data type in input register table\n"
 #ifndef MBPOLL_FLOAT_DISABLE
            "  -t 3:float    32-bit float data type in input register table\n"
+#endif
+           "  -t 3:uint32   32-bit unsigned integer data type in input register table\n"
+           "  -t 3:int64    64-bit integer data type in input register table\n"
+#ifndef MBPOLL_FLOAT_DISABLE
+           "  -t 3:double   64-bit float data type in input register table\n"
 #endif
            "  -t 4          16-bit output (holding) register data type (default)\n"
            "  -t 4:int16    16-bit output (holding) register data type with signed int display\n"
@@ -1441,20 +4864,93 @@ vUsage (FILE * stream, int exit_msg) {
 #ifndef MBPOLL_FLOAT_DISABLE
            "  -t 4:float    32-bit float data type in output (holding) register table\n"
 #endif
+           "  -t 4:uint32   32-bit unsigned integer data type in output (holding) register table\n"
+           "  -t 4:int64    64-bit integer data type in output (holding) register table\n"
+#ifndef MBPOLL_FLOAT_DISABLE
+           "  -t 4:double   64-bit float data type in output (holding) register table\n"
+#endif
+           "  --coalesce[=#] Merge the start references into as few read requests as\n"
+           "                possible, bridging gaps up to # values (%d-%d, %d is default)\n"
            "  -0            First reference is 0 (PDU addressing) instead 1\n"
            "  -W            Using function 10 for write a single register\n"
-           "  -B            Big endian word order for 32-bit integer and float\n"
+           "  -B            Big endian word order for 32 and 64-bit values (--order=abcd)\n"
+           "  --order=#     Byte order of 32 and 64-bit values in the registers, abcd,\n"
+           "                cdab (default), badc or dcba, A is the most significant byte\n"
            "  -1            Poll only once only, otherwise every poll rate interval\n"
-           "  -l #          Poll rate in ms, ( > %d, %d is default)\n"
+           "  -l #          Poll rate in ms, ( >= %d, %d is default), cycles start at a\n"
+           "                fixed period regardless of the time spent polling\n"
+           "  --every #[,#...] Read each start reference only every # poll cycles,\n"
+           "                one value per start reference or one for all (%d-%d)\n"
            "  -o #          Time-out in seconds (%.2f - %.2f, %.2f s is default)\n"
+           "  --adaptive-timeout[=#] Adapt the time-out of each slave to its measured\n"
+           "                response time, between # seconds (%.2f is default) and -o\n"
+           "  --down-after # Mark a slave down after # polls without any response\n"
+           "                (%d-%d), then probe it after 1, 2, 4... up to %d cycles\n"
+           "  --report #    Print the traffic counters and response time percentiles\n"
+           "                every # seconds (%d-%d), they are always printed with\n"
+           "                the statistics, on stderr with --queue\n"
+           "  --output=#    Output format of the read values, text (default), jsonl\n"
+           "                (one JSON object per line) or csv, records hold the\n"
+           "                time, slave, function, reference, error and values,\n"
+           "                the statistics are printed on stderr\n"
+           "  --no-banner   Do not print the \"-- Polling slave\" line of each poll\n"
+           "  --on-change[=#[,#...]] Print only the values that changed since they\n"
+           "                were last printed, or moved by more than the deadband #,\n"
+           "                absolute or in percent (e.g. 0.5 or 2%%), one per start\n"
+           "                reference or one for all, errors are printed once\n"
+           "  --capture=#   Record the read values in the binary capture file #,\n"
+           "                unchanged values take one byte per start reference\n"
+           "  --replay=#    Print the values recorded in the capture file # instead\n"
+           "                of polling, with the output options of this run\n"
+           "  --realtime    Replay at the pace of the capture, instead of as fast\n"
+           "                as possible\n"
+#ifdef MBPOLL_SHM
+           "  --shm=#       Publish the last read values in the POSIX shared memory\n"
+           "                segment #, for local readers (layout in src/shm.h)\n"
+#endif
+#ifdef MBPOLL_PTHREAD
+           "  --queue=#     Print the values in a separate thread, up to # cycles\n"
+           "                (%d-%d) wait there so that a slow output does not delay\n"
+           "                the polling\n"
+           "  --overflow=#  What to do when the queue is full, block (default) the\n"
+           "                polling, drop-oldest waiting cycle or count and drop the\n"
+           "                new one, overflows are printed with the statistics\n"
+#endif
            "  -q            Quiet mode.  Minimum output only\n"
            "Options for ModBus / TCP : \n"
            "  -p #          TCP port number (%s is default)\n"
+#if defined (MBPOLL_PTHREAD) || defined (MBPOLL_PIPELINE)
+           "  --workers #   Number of connections used to poll or write a slave list\n"
+           "                in parallel (%d-%d, %d is default)\n"
+#endif
+#ifdef MBPOLL_PIPELINE
+           "  --pipeline #  Keep up to # requests in flight on each connection\n"
+           "                (%d-%d), replies are matched by transaction id, all the\n"
+           "                connections are then driven by a single thread\n"
+           "  --gateway=#   Poll or write HOST[:PORT]@SLAVES, a TCP to RTU gateway,\n"
+           "                with the host argument, e.g. 10.0.0.2:502@1:8. May be\n"
+           "                repeated. Each gateway gets one request at a time\n"
+           "                (--pipeline sets another limit), the gateways are\n"
+           "                served in parallel by a single thread\n"
+#endif
            "Options for ModBus RTU : \n"
            "  -b #          Baudrate (%d-%d, %d is default)\n"
            "  -d #          Databits (7 or 8, %s for RTU)\n"
            "  -s #          Stopbits (1 or 2, %s is default)\n"
            "  -P #          Parity (none, even, odd, %s is default)\n"
+#ifdef MBPOLL_RTU
+           "  --bus=#       Poll or write DEVICE@SLAVES[@BAUD-DPS] in parallel with\n"
+           "                the device argument, all the buses by a single thread,\n"
+           "                e.g. /dev/ttyUSB1@1:8@9600-8N1. May be repeated.\n"
+           "                Records and statistics give the bus of each slave\n"
+#endif
+#ifdef MBPOLL_RTU
+           "  --broadcast   Write to all the slaves at once (address 0), no slave\n"
+           "                confirms it\n"
+           "  --rtu-gap #   Longest silence inside a reply, in t1.5 units (%d-%d,\n"
+           "                %d is default), raise it for USB adapters that deliver\n"
+           "                the bytes by packets\n"
+#endif
 #ifdef MBPOLL_GPIO_RTS
            "  -R [#]        RS-485 mode (/RTS on (0) after sending)\n"
            "                 Optional parameter for the GPIO RTS pin number\n"
@@ -1486,18 +4982,49 @@ vUsage (FILE * stream, int exit_msg) {
            , NUMOFVALUES_MIN
            , NUMOFVALUES_MAX
            , DEFAULT_NUMOFVALUES
+           , MODBUS_MAX_READ_REGISTERS
+           , MODBUS_MAX_READ_BITS
+           , COALESCE_GAP_MIN
+           , COALESCE_GAP_MAX
+           , DEFAULT_COALESCE_GAP
            , POLLRATE_MIN
            , DEFAULT_POLLRATE
+           , EVERY_MIN
+           , EVERY_MAX
            , TIMEOUT_MIN
            , TIMEOUT_MAX
            , DEFAULT_TIMEOUT
+           , DEFAULT_RTO_MIN
+           , DOWN_AFTER_MIN
+           , DOWN_AFTER_MAX
+           , DOWN_BACKOFF_MAX
+           , REPORT_PERIOD_MIN
+           , REPORT_PERIOD_MAX
+#ifdef MBPOLL_PTHREAD
+           , QUEUE_SIZE_MIN
+           , QUEUE_SIZE_MAX
+#endif
            , DEFAULT_TCP_PORT
+#if defined (MBPOLL_PTHREAD) || defined (MBPOLL_PIPELINE)
+           , WORKERS_MIN
+           , WORKERS_MAX
+           , DEFAULT_WORKERS
+#endif
+#ifdef MBPOLL_PIPELINE
+           , PIPELINE_MIN
+           , PIPELINE_MAX
+#endif
            , RTU_BAUDRATE_MIN
            , RTU_BAUDRATE_MAX
            , DEFAULT_RTU_BAUDRATE
            , sSerialDataBitsToStr (DEFAULT_RTU_DATABITS)
            , sSerialStopBitsToStr (DEFAULT_RTU_STOPBITS)
            , sSerialParityToStr (DEFAULT_RTU_PARITY)
+#ifdef MBPOLL_RTU
+           , RTU_GAP_MIN
+           , RTU_GAP_MAX
+           , DEFAULT_RTU_GAP
+#endif
 #ifdef USE_CHIPIO
 // -----------------------------------------------------------------------------
            , CHIPIO_SLAVEADDR_MIN
@@ -1590,6 +5117,26 @@ sFunctionToStr (eFunctions eFunction) {
                      SIZEOF_ILIST (iFunctionList));
 }
 
+// -----------------------------------------------------------------------------
+// Code fonction ModBus de lecture correspondant au type de données
+int
+iFunctionCode (eFunctions eFunction) {
+
+  switch (eFunction) {
+    case eFuncCoil:
+      return 0x01;
+    case eFuncDiscreteInput:
+      return 0x02;
+    case eFuncHoldingReg:
+      return 0x03;
+    case eFuncInputReg:
+      return 0x04;
+    default:
+      break;
+  }
+  return -1;
+}
+
 // -----------------------------------------------------------------------------
 void
 vPrintIntList (int * iList, int iLen) {
@@ -1606,6 +5153,101 @@ vPrintIntList (int * iList, int iLen) {
   }
 }
 
+// -----------------------------------------------------------------------------
+// Liste de bandes mortes séparées par des virgules, chacune est un écart
+// absolu ou un pourcentage : 0.5,2%,10
+xDeadband *
+xGetDeadbandList (const char * name, const char * sList, int * iLen) {
+  xDeadband * xList;
+  const char * p;
+  char * endptr;
+  int iCount = 1;
+
+  for (p = sList; *p; p++) {
+    if (*p == ',') {
+      iCount++;
+    }
+  }
+  xList = calloc (iCount, sizeof (xDeadband));
+  assert (xList);
+
+  for (*iLen = 0, p = sList; *iLen < iCount; (*iLen)++) {
+    xDeadband * xDb = &xList[*iLen];
+
+    xDb->dValue = strtod (p, &endptr);
+    if ( (endptr == p) || (xDb->dValue < 0) || !isfinite (xDb->dValue)) {
+
+      vSyntaxErrorExit ("Illegal %s value: %s", name, p);
+    }
+    p = endptr;
+    if (*p == '%') {
+
+      xDb->bIsPercent = true;
+      p++;
+    }
+    if ( (*p != ',') && (*p != 0)) {
+
+      vSyntaxErrorExit ("Illegal %s delimiter: '%c'", name, *p);
+    }
+    PDEBUG ("Deadband found: %g%s\n", xDb->dValue, xDb->bIsPercent ? "%" : "");
+    if (*p) {
+
+      p++; // On passe le délimiteur
+    }
+  }
+  return xList;
+}
+
+// -----------------------------------------------------------------------------
+// Configuration d'une ligne série sous la forme BAUD[-DPS] : 9600, 9600-8N1,
+// 19200-7E2. Sans DPS, les champs correspondants sont inconnus.
+void
+vGetSerialLine (const char * name, const char * sLine, xSerialIos * xIos) {
+  char * endptr;
+  long lBaud;
+
+  xIos->dbits = SERIAL_DATABIT_UNKNOWN;
+  xIos->parity = SERIAL_PARITY_UNKNOWN;
+  xIos->sbits = SERIAL_STOPBIT_UNKNOWN;
+  xIos->flow = SERIAL_FLOW_NONE;
+
+  lBaud = strtol (sLine, &endptr, 10);
+  if ( (endptr == sLine) || ( (*endptr != '-') && (*endptr != 0))) {
+
+    vSyntaxErrorExit ("Illegal %s line: %s", name, sLine);
+  }
+  vCheckIntRange (sRtuBaudrateStr, lBaud, RTU_BAUDRATE_MIN, RTU_BAUDRATE_MAX);
+  xIos->baud = lBaud;
+  if (*endptr == 0) {
+    return;
+  }
+
+  sLine = endptr + 1;
+  if (strlen (sLine) != 3) {
+
+    vSyntaxErrorExit ("Illegal %s line: %s", name, sLine);
+  }
+  switch (sLine[0]) {
+    case '7': xIos->dbits = SERIAL_DATABIT_7; break;
+    case '8': xIos->dbits = SERIAL_DATABIT_8; break;
+    default:
+      vSyntaxErrorExit ("Illegal %s: %c", sRtuDatabitsStr, sLine[0]);
+  }
+  switch (toupper ( (unsigned char) sLine[1])) {
+    case 'N': xIos->parity = SERIAL_PARITY_NONE; break;
+    case 'E': xIos->parity = SERIAL_PARITY_EVEN; break;
+    case 'O': xIos->parity = SERIAL_PARITY_ODD; break;
+    default:
+      vSyntaxErrorExit ("Illegal %s: %c", sRtuParityStr, sLine[1]);
+  }
+  switch (sLine[2]) {
+    case '1': xIos->sbits = SERIAL_STOPBIT_ONE; break;
+    case '2': xIos->sbits = SERIAL_STOPBIT_TWO; break;
+    default:
+      vSyntaxErrorExit ("Illegal %s: %c", sRtuStopbitsStr, sLine[2]);
+  }
+}
+
 // -----------------------------------------------------------------------------
 int *
 iGetIntList (const char * name, const char * sList, int * iLen) {
@@ -1742,48 +5384,33 @@ iGetInt (const char * name, const char * num, int base) {
 }
 
 // -----------------------------------------------------------------------------
-double
-dGetDouble (const char * name, const char * num) {
+int64_t
+llGetInt64 (const char * name, const char * num) {
   char * endptr;
 
-  double d = strtod (num, &endptr);
+  int64_t ll = strtoll (num, &endptr, 10);
   if (endptr == num) {
 
     vSyntaxErrorExit ("Illegal %s value: %s", name, num);
   }
 
-  PDEBUG ("Set %s=%g\n", name, d);
-  return d;
+  PDEBUG ("Set %s=%"PRId64"\n", name, ll);
+  return ll;
 }
 
 // -----------------------------------------------------------------------------
-float
-fSwapFloat (float f) {
-  float ret = f;
+double
+dGetDouble (const char * name, const char * num) {
+  char * endptr;
 
-  if (ctx.bIsBigEndian) {
+  double d = strtod (num, &endptr);
+  if (endptr == num) {
 
-    uint16_t *in = (uint16_t *) &f;
-    uint16_t *out = (uint16_t *) &ret;
-    out[0] = in[1];
-    out[1] = in[0];
+    vSyntaxErrorExit ("Illegal %s value: %s", name, num);
   }
-  return ret;
-}
-
-// -----------------------------------------------------------------------------
-int32_t
-lSwapLong (int32_t l) {
-  int32_t ret = l;
 
-  if (ctx.bIsBigEndian) {
-
-    uint16_t *in = (uint16_t *) &l;
-    uint16_t *out = (uint16_t *) &ret;
-    out[0] = in[1];
-    out[1] = in[0];
-  }
-  return ret;
+  PDEBUG ("Set %s=%g\n", name, d);
+  return d;
 }
 
 // -----------------------------------------------------------------------------
@@ -0,0 +1,580 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mbrtu.h"
+#ifdef MBPOLL_RTU
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <modbus.h>
+#include "timing.h"
+
+/* constants ================================================================ */
+#define RTU_ADU_MAX       (1 + MB_PDU_MAX + 2)
+// taille minimale d'une réponse : esclave, fonction | 0x80, code, CRC
+#define RTU_EXCEPTION_SIZE 5
+// réponse à une écriture : esclave, fonction, adresse, valeur ou nombre, CRC
+#define RTU_ECHO_SIZE     8
+// délai de retournement après une diffusion, le temps laissé aux esclaves
+// pour la traiter, en µs
+#define RTU_TURNAROUND    100000
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+
+/* structures =============================================================== */
+/*
+ * Etat d'un port pendant l'exécution d'un lot :
+ * - silence (bIsWaiting faux), la requête iNext part à ullDeadline, t3.5
+ *   après la dernière activité sur la ligne,
+ * - réponse attendue (bIsWaiting vrai), ullDeadline est la fin du timeout de
+ *   réponse, puis ullGap après chaque octet reçu.
+ * Le lot est terminé quand xBatch est NULL.
+ */
+struct xMbRtu {
+  int iFd;
+  uint64_t ullTimeout; // µs
+  uint64_t ullT15; // µs
+  uint64_t ullT35; // µs
+  uint64_t ullGap; // silence maximal dans une réponse, en µs
+  uint64_t ullCharTime; // durée d'un caractère en ns
+  uint64_t ullIdle; // fin de la dernière activité sur la ligne
+  bool bDebug;
+  // lot en cours
+  xMbBatch * xBatch;
+  int iNext; // requête en cours
+  bool bIsWaiting;
+  uint64_t ullDeadline; // µs
+  uint64_t ullStart; // début de l'envoi de la requête
+  size_t ulRxLen;
+  size_t ulExpected;
+  uint8_t ucRx[RTU_ADU_MAX];
+};
+
+/* private variables ======================================================== */
+// usCrcTable[k][b] : CRC de l'octet b suivi de k octets nuls
+static uint16_t usCrcTable[8][256];
+static bool bIsCrcReady;
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static void
+vCrcInit (void) {
+  int i, k;
+
+  for (i = 0; i < 256; i++) {
+    uint16_t usCrc = i;
+
+    for (k = 0; k < 8; k++) {
+
+      usCrc = (usCrc & 1) ? (usCrc >> 1) ^ 0xA001 : usCrc >> 1;
+    }
+    usCrcTable[0][i] = usCrc;
+  }
+  for (k = 1; k < 8; k++) {
+    for (i = 0; i < 256; i++) {
+      uint16_t usCrc = usCrcTable[k - 1][i];
+
+      usCrcTable[k][i] = (usCrc >> 8) ^ usCrcTable[0][usCrc & 0xFF];
+    }
+  }
+  bIsCrcReady = true;
+}
+
+// -----------------------------------------------------------------------------
+static void
+vPrintFrame (const char * sFmt, const uint8_t * ucFrame, size_t ulLen) {
+  size_t i;
+
+  for (i = 0; i < ulLen; i++) {
+
+    printf (sFmt, ucFrame[i]);
+  }
+  putchar ('\n');
+}
+
+// -----------------------------------------------------------------------------
+static speed_t
+xBaudToSpeed (long lBaud) {
+
+  switch (lBaud) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B500000
+    case 500000: return B500000;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default:
+      break;
+  }
+  return (speed_t) - 1;
+}
+
+// -----------------------------------------------------------------------------
+// Configuration du port en mode brut
+static int
+iSetAttr (int iFd, const xSerialIos * xIos) {
+  speed_t xSpeed = xBaudToSpeed (xIos->baud);
+  struct termios xTio;
+
+  if ( (xSpeed == (speed_t) - 1) || (tcgetattr (iFd, &xTio) != 0)) {
+
+    errno = EINVAL;
+    return -1;
+  }
+  cfmakeraw (&xTio);
+  xTio.c_cflag |= CLOCAL | CREAD;
+  xTio.c_cflag &= ~ (CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS);
+  switch (xIos->dbits) {
+    case SERIAL_DATABIT_5: xTio.c_cflag |= CS5; break;
+    case SERIAL_DATABIT_6: xTio.c_cflag |= CS6; break;
+    case SERIAL_DATABIT_7: xTio.c_cflag |= CS7; break;
+    default: xTio.c_cflag |= CS8; break;
+  }
+  switch (xIos->parity) {
+    case SERIAL_PARITY_EVEN: xTio.c_cflag |= PARENB; break;
+    case SERIAL_PARITY_ODD: xTio.c_cflag |= PARENB | PARODD; break;
+#ifdef CMSPAR
+    case SERIAL_PARITY_SPACE: xTio.c_cflag |= PARENB | CMSPAR; break;
+    case SERIAL_PARITY_MARK: xTio.c_cflag |= PARENB | CMSPAR | PARODD; break;
+#endif
+    case SERIAL_PARITY_NONE: break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  // termios ne connaît pas 1,5 bit de stop
+  if (xIos->sbits != SERIAL_STOPBIT_ONE) {
+    xTio.c_cflag |= CSTOPB;
+  }
+  // read() retourne immédiatement ce qui est disponible
+  xTio.c_cc[VMIN] = 0;
+  xTio.c_cc[VTIME] = 0;
+  cfsetispeed (&xTio, xSpeed);
+  cfsetospeed (&xTio, xSpeed);
+  if (tcsetattr (iFd, TCSANOW, &xTio) != 0) {
+    return -1;
+  }
+  return tcflush (iFd, TCIOFLUSH);
+}
+
+// -----------------------------------------------------------------------------
+// Attente d'un évènement sur le port, retourne 0 si timeout
+static int
+iWait (int iFd, short sEvents, uint64_t ullDeadline) {
+  uint64_t ullNow = ullTimeNowUs();
+  struct pollfd xPfd = { .fd = iFd, .events = sEvents };
+  int iMs, iRet;
+
+  iMs = (ullDeadline > ullNow) ? (int) ( (ullDeadline - ullNow + 999) / 1000) : 0;
+  do {
+    iRet = poll (&xPfd, 1, iMs);
+  }
+  while ( (iRet < 0) && (errno == EINTR));
+  return iRet;
+}
+
+// -----------------------------------------------------------------------------
+// Envoi d'une trame, qui tient dans le tampon du pilote, sans attendre que
+// son dernier octet soit sur la ligne
+static int
+iSend (xMbRtu * x, const uint8_t * ucFrame, size_t ulLen) {
+  uint64_t ullDeadline = ullTimeNowUs() + x->ullTimeout;
+
+  while (ulLen > 0) {
+    ssize_t n = write (x->iFd, ucFrame, ulLen);
+
+    if (n < 0) {
+
+      if ( (errno == EAGAIN) || (errno == EINTR)) {
+        int iRet = iWait (x->iFd, POLLOUT, ullDeadline);
+
+        if (iRet == 0) {
+          errno = ETIMEDOUT;
+        }
+        if (iRet <= 0) {
+          return -1;
+        }
+        continue;
+      }
+      return -1;
+    }
+    ucFrame += n;
+    ulLen -= n;
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Taille de la réponse attendue, connue dès son 2e octet pour une exception
+// ou un écho d'écriture, dès son 3e octet pour une lecture
+static void
+vUpdateExpected (xMbRtu * x) {
+
+  if ( (x->ulRxLen >= 2) && (x->ucRx[1] & 0x80)) {
+
+    x->ulExpected = RTU_EXCEPTION_SIZE;
+  }
+  else if ( (x->ulRxLen >= 2) && (x->ucRx[1] >= 5)) {
+
+    x->ulExpected = RTU_ECHO_SIZE;
+  }
+  else if (x->ulRxLen >= 3) {
+
+    x->ulExpected = MIN (3U + x->ucRx[2] + 2U, RTU_ADU_MAX);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Vérification d'une réponse complète, retourne 0 ou le code d'erreur de la
+// requête
+static int
+iCheckReply (const xMbRtu * x, const xMbRequest * r) {
+  size_t ulLen = x->ulRxLen;
+
+  if (usMbRtuCrc (x->ucRx, ulLen - 2) !=
+      (x->ucRx[ulLen - 2] | (x->ucRx[ulLen - 1] << 8))) {
+    return EMBBADCRC;
+  }
+  if (x->ucRx[0] != r->iSlave) {
+    return EMBBADSLAVE;
+  }
+  return iMbPduDecode (r, x->ucRx + 1, ulLen - 3);
+}
+
+// -----------------------------------------------------------------------------
+// Fin du lot, toutes ses requêtes sont terminées
+static uint64_t
+ullDone (xMbRtu * x) {
+
+  x->xBatch = NULL;
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Port inutilisable, les requêtes restantes ne sont pas envoyées
+static uint64_t
+ullBreak (xMbRtu * x, int iError) {
+  xMbBatch * b = x->xBatch;
+  int i;
+
+  for (i = x->iNext; i < b->iCount; i++) {
+
+    b->xReq[i].iError = iError;
+  }
+  b->iResult = -1;
+  b->iError = iError;
+  return ullDone (x);
+}
+
+// -----------------------------------------------------------------------------
+// Fin de la requête en cours, la suivante partira après t3.5 de silence
+static uint64_t
+ullEndRequest (xMbRtu * x, int iError) {
+  xMbBatch * b = x->xBatch;
+
+  b->xReq[x->iNext].iError = iError;
+  if (iError) {
+    b->iResult++;
+  }
+  x->bIsWaiting = false;
+  if (++x->iNext >= b->iCount) {
+    return ullDone (x);
+  }
+  x->ullDeadline = x->ullIdle + x->ullT35;
+  return x->ullDeadline;
+}
+
+// -----------------------------------------------------------------------------
+// Envoi de la requête en cours, au terme du silence qui la précède
+static uint64_t
+ullSendRequest (xMbRtu * x) {
+  xMbRequest * r = &x->xBatch->xReq[x->iNext];
+  uint8_t ucFrame[RTU_ADU_MAX];
+  size_t ulLen = ulMbPduEncode (r, ucFrame + 1);
+  uint16_t usCrc;
+
+  if (ulLen == 0) {
+    return ullEndRequest (x, EMBMDATA);
+  }
+  ulLen++;
+  ucFrame[0] = r->iSlave;
+  usCrc = usMbRtuCrc (ucFrame, ulLen);
+  ucFrame[ulLen++] = usCrc & 0xFF;
+  ucFrame[ulLen++] = usCrc >> 8;
+
+  // ce qui reste d'une réponse précédente est abandonné
+  tcflush (x->iFd, TCIFLUSH);
+  if (x->bDebug) {
+    vPrintFrame ("[%.2X]", ucFrame, ulLen);
+  }
+  x->ullStart = ullTimeNowUs();
+  if (iSend (x, ucFrame, ulLen) != 0) {
+    return ullBreak (x, errno);
+  }
+  // fin de la trame sur la ligne
+  x->ullIdle = x->ullStart + (ulLen * x->ullCharTime + 999) / 1000;
+
+  if (r->iSlave == 0) {
+
+    // diffusion, aucun esclave ne répond : la trame suivante attend que
+    // tous aient pu la traiter
+    x->ullIdle += RTU_TURNAROUND;
+    r->ullRtt = 0;
+    return ullEndRequest (x, 0);
+  }
+  x->bIsWaiting = true;
+  x->ulRxLen = 0;
+  x->ulExpected = RTU_EXCEPTION_SIZE;
+  x->ullDeadline = x->ullIdle + (r->ullTimeout ? r->ullTimeout :
+                                 x->ullTimeout);
+  return x->ullDeadline;
+}
+
+// -----------------------------------------------------------------------------
+// Lecture des octets disponibles, ceux qui arrivent hors d'une réponse sont
+// abandonnés mais repoussent l'envoi de la requête suivante
+static uint64_t
+ullReceive (xMbRtu * x) {
+  uint8_t ucTrash[RTU_ADU_MAX];
+  xMbRequest * r;
+  ssize_t n;
+
+  if (x->bIsWaiting) {
+
+    n = read (x->iFd, x->ucRx + x->ulRxLen, x->ulExpected - x->ulRxLen);
+  }
+  else {
+
+    n = read (x->iFd, ucTrash, sizeof (ucTrash));
+  }
+  if (n < 0) {
+
+    if ( (errno == EAGAIN) || (errno == EINTR)) {
+      return x->ullDeadline;
+    }
+    return ullBreak (x, errno);
+  }
+  if (n == 0) {
+
+    // port débranché
+    return ullBreak (x, EIO);
+  }
+  x->ullIdle = ullTimeNowUs();
+  if (!x->bIsWaiting) {
+
+    x->ullDeadline = x->ullIdle + x->ullT35;
+    return x->ullDeadline;
+  }
+
+  x->ulRxLen += n;
+  // le reste de la trame doit suivre sans silence de plus de ullGap
+  x->ullDeadline = x->ullIdle + x->ullGap;
+  vUpdateExpected (x);
+  if (x->ulRxLen < x->ulExpected) {
+    return x->ullDeadline;
+  }
+
+  r = &x->xBatch->xReq[x->iNext];
+  r->ullRtt = x->ullIdle - x->ullStart;
+  if (x->bDebug) {
+    vPrintFrame ("<%.2X>", x->ucRx, x->ulRxLen);
+  }
+  return ullEndRequest (x, iCheckReply (x, r));
+}
+
+// -----------------------------------------------------------------------------
+// Echéance de la réponse : rien n'est arrivé à temps ou la trame s'est
+// interrompue, ce qui en est reçu n'est pas vérifié
+static uint64_t
+ullExpire (xMbRtu * x) {
+
+  if (x->ulRxLen > 0) {
+
+    if (x->bDebug) {
+      vPrintFrame ("<%.2X>", x->ucRx, x->ulRxLen);
+    }
+  }
+  else {
+
+    x->ullIdle = ullTimeNowUs();
+  }
+  return ullEndRequest (x, ETIMEDOUT);
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+uint16_t
+usMbRtuCrc (const uint8_t * b, size_t ulLen) {
+  uint16_t usCrc = 0xFFFF;
+
+  if (!bIsCrcReady) {
+    vCrcInit();
+  }
+  // 8 octets par tour : les 2 premiers modifient le CRC courant, les 6
+  // suivants sont indépendants
+  while (ulLen >= 8) {
+
+    usCrc ^= b[0] | (b[1] << 8);
+    usCrc = usCrcTable[7][usCrc & 0xFF] ^ usCrcTable[6][usCrc >> 8] ^
+            usCrcTable[5][b[2]] ^ usCrcTable[4][b[3]] ^
+            usCrcTable[3][b[4]] ^ usCrcTable[2][b[5]] ^
+            usCrcTable[1][b[6]] ^ usCrcTable[0][b[7]];
+    b += 8;
+    ulLen -= 8;
+  }
+  while (ulLen--) {
+
+    usCrc = (usCrc >> 8) ^ usCrcTable[0][ (usCrc ^ *b++) & 0xFF];
+  }
+  return usCrc;
+}
+
+// -----------------------------------------------------------------------------
+xMbRtu *
+xMbRtuOpen (const char * sDevice, const xSerialIos * xIos, double dTimeout,
+            int iGap, bool bDebug) {
+  double dCharBits;
+  xMbRtu * x;
+
+  if (!bIsCrcReady) {
+    vCrcInit();
+  }
+  x = calloc (1, sizeof (xMbRtu));
+  if (x == NULL) {
+
+    errno = ENOMEM;
+    return NULL;
+  }
+  x->iFd = open (sDevice, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if ( (x->iFd < 0) || (iSetAttr (x->iFd, xIos) != 0)) {
+    int iErr = errno;
+
+    vMbRtuClose (x);
+    errno = iErr;
+    return NULL;
+  }
+  x->ullTimeout = (uint64_t) (dTimeout * 1E6);
+  x->bDebug = bDebug;
+
+  // un caractère : start, données, parité et stop
+  dCharBits = 1 + xIos->dbits + (xIos->parity != SERIAL_PARITY_NONE) +
+              ( (xIos->sbits == SERIAL_STOPBIT_ONEHALF) ? 1.5 : xIos->sbits);
+  if (xIos->baud > 19200) {
+
+    // valeurs fixes recommandées par la spécification
+    x->ullT15 = 750;
+    x->ullT35 = 1750;
+  }
+  else {
+
+    x->ullT15 = (uint64_t) (1.5 * dCharBits * 1E6 / xIos->baud + 0.5);
+    x->ullT35 = (uint64_t) (3.5 * dCharBits * 1E6 / xIos->baud + 0.5);
+  }
+  x->ullGap = iGap * x->ullT15;
+  x->ullCharTime = (uint64_t) (dCharBits * 1E9 / xIos->baud + 0.5);
+  // l'impulsion produite par certains pilotes à l'ouverture du port est
+  // suivie d'un silence de t3.5 avant la première trame
+  x->ullIdle = ullTimeNowUs();
+  return x;
+}
+
+// -----------------------------------------------------------------------------
+int
+iMbRtuFd (const xMbRtu * x) {
+
+  return x->iFd;
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullMbRtuStart (xMbRtu * x, xMbBatch * xBatch) {
+
+  xBatch->iResult = 0;
+  xBatch->iError = 0;
+  x->xBatch = xBatch;
+  x->iNext = 0;
+  x->bIsWaiting = false;
+  if (xBatch->iCount == 0) {
+    return ullDone (x);
+  }
+  x->ullDeadline = x->ullIdle + x->ullT35;
+  return x->ullDeadline;
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullMbRtuStep (xMbRtu * x, bool bIsReadable) {
+
+  if (x->xBatch == NULL) {
+    return 0;
+  }
+  if (bIsReadable) {
+    return ullReceive (x);
+  }
+  return x->bIsWaiting ? ullExpire (x) : ullSendRequest (x);
+}
+
+// -----------------------------------------------------------------------------
+void
+vMbRtuCancel (xMbRtu * x, int iError) {
+
+  if (x->xBatch) {
+    ullBreak (x, iError);
+  }
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullMbRtuFrameGap (const xMbRtu * x) {
+
+  return x->ullT35;
+}
+
+// -----------------------------------------------------------------------------
+void
+vMbRtuClose (xMbRtu * x) {
+
+  if (x) {
+
+    if (x->iFd >= 0) {
+      close (x->iFd);
+    }
+    free (x);
+  }
+}
+
+#endif /* MBPOLL_RTU defined */
+/* ========================================================================== */
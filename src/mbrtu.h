@@ -0,0 +1,115 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_MBRTU_H_
+#define _MBPOLL_MBRTU_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "serial.h"
+#include "mbpipe.h"
+
+/*
+ * Client ModBus RTU sur un port série POSIX (termios)
+ *
+ * Les délais t1.5 et t3.5 sont calculés à partir de la configuration de la
+ * ligne (valeurs fixes de 750 et 1750 µs au-delà de 19200 bauds). Une
+ * requête part après un silence de t3.5 sur la ligne, une réponse qui
+ * s'interrompt plus longtemps qu'un multiple de t1.5 est en timeout (le noyau
+ * et les adaptateurs USB livrent les octets reçus par paquets, la
+ * spécification demanderait t1.5 exactement). La fin de la réponse
+ * est détectée à partir de sa longueur, connue dès ses 3 premiers octets :
+ * la requête suivante peut partir t3.5 après le dernier octet reçu, sans
+ * attendre de timeout. Le CRC16 est calculé par tables (slice-by-8).
+ * Les lots de requêtes sont exécutés par le moteur d'évènements (mbpipe.h),
+ * avec les connexions ModBus/TCP et les autres ports : chaque port est une
+ * machine à états que le moteur fait avancer à l'arrivée d'octets et aux
+ * échéances qu'elle lui donne, aucun appel ne bloque pendant un échange.
+ * Disponible sur les mêmes plateformes que le client ModBus/TCP pipeliné.
+ */
+#ifdef MBPOLL_PIPELINE
+#define MBPOLL_RTU
+
+/* internal public functions ================================================ */
+
+/**
+ * Ouverture et configuration d'un port série
+ *
+ * @param sDevice nom du port
+ * @param xIos configuration de la ligne, le contrôle de flux n'est pas géré
+ * @param dTimeout timeout de réponse en secondes
+ * @param iGap silence maximal à l'intérieur d'une réponse, en multiples de
+ * t1.5
+ * @param bDebug affiche les trames échangées
+ * @return le port, NULL si erreur (errno est positionné)
+ */
+xMbRtu * xMbRtuOpen (const char * sDevice, const xSerialIos * xIos,
+                     double dTimeout, int iGap, bool bDebug);
+
+/**
+ * Descripteur du port, surveillé en lecture par le moteur d'évènements
+ */
+int iMbRtuFd (const xMbRtu * xRtu);
+
+/**
+ * Départ d'un lot de requêtes, réservé au moteur d'évènements
+ *
+ * Les requêtes sont exécutées l'une après l'autre. Le résultat de chaque
+ * requête est stocké dans son champ iError, celui du lot dans iResult et
+ * iError. Une écriture diffusée (esclave 0) réussit dès que sa trame est
+ * envoyée, la trame suivante attend le délai de retournement des esclaves.
+ *
+ * @return l'échéance en µs où ullMbRtuStep() doit être appelée si aucun
+ * octet n'arrive, 0 si le lot est déjà terminé
+ */
+uint64_t ullMbRtuStart (xMbRtu * xRtu, xMbBatch * xBatch);
+
+/**
+ * Avancement du lot en cours, à l'arrivée d'octets ou à l'échéance
+ *
+ * @param bIsReadable des octets sont disponibles, sinon l'échéance est
+ * atteinte
+ * @return la nouvelle échéance, 0 quand le lot est terminé
+ */
+uint64_t ullMbRtuStep (xMbRtu * xRtu, bool bIsReadable);
+
+/**
+ * Abandon du lot en cours, ses requêtes non terminées sont en erreur et le
+ * port est considéré comme rompu
+ */
+void vMbRtuCancel (xMbRtu * xRtu, int iError);
+
+/**
+ * Durée de t3.5 en µs
+ */
+uint64_t ullMbRtuFrameGap (const xMbRtu * xRtu);
+
+/**
+ * Fermeture du port et libération des ressources
+ */
+void vMbRtuClose (xMbRtu * xRtu);
+
+/**
+ * CRC16 ModBus d'une trame
+ *
+ * @return le CRC, à transmettre octet de poids faible en premier
+ */
+uint16_t usMbRtuCrc (const uint8_t * ucFrame, size_t ulLen);
+
+#endif /* MBPOLL_PIPELINE defined */
+
+/* ========================================================================== */
+#endif /* _MBPOLL_MBRTU_H_ */
@@ -0,0 +1,173 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+#include "outbuf.h"
+
+/* constants ================================================================ */
+// taille minimale de l'allocation
+#define OUTBUF_CHUNK 4096
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vOutBufInit (xOutBuf * b) {
+
+  memset (b, 0, sizeof (xOutBuf));
+}
+
+// -----------------------------------------------------------------------------
+char *
+pcOutBufReserve (xOutBuf * b, size_t ulLen) {
+
+  if (b->ulLen + ulLen > b->ulSize) {
+    size_t ulSize = b->ulSize ? b->ulSize : OUTBUF_CHUNK;
+    char * pcData;
+
+    while (ulSize < b->ulLen + ulLen) {
+      ulSize *= 2;
+    }
+    pcData = realloc (b->pcData, ulSize);
+    if (pcData == NULL) {
+
+      if (b->iError == 0) {
+        b->iError = ENOMEM;
+      }
+      return NULL;
+    }
+    b->pcData = pcData;
+    b->ulSize = ulSize;
+  }
+  return b->pcData + b->ulLen;
+}
+
+// -----------------------------------------------------------------------------
+void
+vOutBufCommit (xOutBuf * b, size_t ulLen) {
+
+  b->ulLen += ulLen;
+}
+
+// -----------------------------------------------------------------------------
+void
+vOutBufWrite (xOutBuf * b, const void * pvData, size_t ulLen) {
+  char * p = pcOutBufReserve (b, ulLen);
+
+  if (p) {
+
+    memcpy (p, pvData, ulLen);
+    b->ulLen += ulLen;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vOutBufPuts (xOutBuf * b, const char * sStr) {
+
+  vOutBufWrite (b, sStr, strlen (sStr));
+}
+
+// -----------------------------------------------------------------------------
+void
+vOutBufPutc (xOutBuf * b, char c) {
+  char * p = pcOutBufReserve (b, 1);
+
+  if (p) {
+
+    *p = c;
+    b->ulLen++;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vOutBufPrintf (xOutBuf * b, const char * sFormat, ...) {
+  va_list va;
+  size_t ulFree = b->ulSize - b->ulLen;
+  int iLen;
+
+  va_start (va, sFormat);
+  iLen = vsnprintf (b->pcData ? b->pcData + b->ulLen : NULL, ulFree,
+                    sFormat, va);
+  va_end (va);
+  if (iLen < 0) {
+
+    return;
+  }
+  if ( (size_t) iLen >= ulFree) {
+    // place insuffisante (le zéro final compte), nouvel essai après
+    // agrandissement
+    char * p = pcOutBufReserve (b, iLen + 1);
+
+    if (p == NULL) {
+      return;
+    }
+    va_start (va, sFormat);
+    vsnprintf (p, iLen + 1, sFormat, va);
+    va_end (va);
+  }
+  b->ulLen += iLen;
+}
+
+// -----------------------------------------------------------------------------
+int
+iOutBufFlush (xOutBuf * b, int iFd) {
+  size_t ulDone = 0;
+  int iError = b->iError;
+
+  while ( (ulDone < b->ulLen) && (iError == 0)) {
+    int iRet = write (iFd, b->pcData + ulDone, b->ulLen - ulDone);
+
+    if (iRet < 0) {
+
+      if (errno != EINTR) {
+        iError = errno;
+      }
+    }
+    else {
+
+      ulDone += iRet;
+    }
+  }
+  b->ulLen = 0;
+  b->iError = 0;
+  if (iError) {
+
+    errno = iError;
+    return -1;
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+void
+vOutBufFree (xOutBuf * b) {
+
+  free (b->pcData);
+  vOutBufInit (b);
+}
+
+/* ========================================================================== */
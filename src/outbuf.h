@@ -0,0 +1,98 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_OUTBUF_H_
+#define _MBPOLL_OUTBUF_H_
+
+#include <stddef.h>
+
+/* structures =============================================================== */
+/**
+ * Tampon de sortie
+ *
+ * Le texte d'un cycle de scrutation est accumulé dans le tampon puis écrit
+ * en une seule fois. La mémoire est conservée d'un cycle à l'autre, elle
+ * n'est agrandie que si nécessaire.
+ * En cas de manque de mémoire, les données ajoutées sont perdues et
+ * iOutBufFlush() retourne une erreur.
+ */
+typedef struct xOutBuf {
+  char * pcData; /**< données */
+  size_t ulLen; /**< nombre d'octets utilisés */
+  size_t ulSize; /**< nombre d'octets alloués */
+  int iError; /**< 0, ou errno de la première erreur depuis le dernier vidage */
+} xOutBuf;
+
+/* internal public functions ================================================ */
+
+/**
+ * Initialisation d'un tampon vide
+ */
+void vOutBufInit (xOutBuf * xBuf);
+
+/**
+ * Réservation de place à la fin du tampon
+ *
+ * Les octets écrits sont validés par vOutBufCommit().
+ *
+ * @param ulLen nombre d'octets nécessaires
+ * @return pointeur sur la fin des données, NULL si erreur mémoire
+ */
+char * pcOutBufReserve (xOutBuf * xBuf, size_t ulLen);
+
+/**
+ * Validation de ulLen octets écrits après pcOutBufReserve()
+ */
+void vOutBufCommit (xOutBuf * xBuf, size_t ulLen);
+
+/**
+ * Ajout de ulLen octets
+ */
+void vOutBufWrite (xOutBuf * xBuf, const void * pvData, size_t ulLen);
+
+/**
+ * Ajout d'une chaîne
+ */
+void vOutBufPuts (xOutBuf * xBuf, const char * sStr);
+
+/**
+ * Ajout d'un caractère
+ */
+void vOutBufPutc (xOutBuf * xBuf, char c);
+
+/**
+ * Ajout d'un texte formaté comme par printf()
+ */
+void vOutBufPrintf (xOutBuf * xBuf, const char * sFormat, ...)
+#ifdef __GNUC__
+__attribute__ ( (format (printf, 2, 3)))
+#endif
+;
+
+/**
+ * Ecriture du contenu du tampon dans un fichier, puis vidage du tampon
+ *
+ * @param iFd descripteur de fichier
+ * @return 0, -1 si erreur (errno est positionné)
+ */
+int iOutBufFlush (xOutBuf * xBuf, int iFd);
+
+/**
+ * Libération de la mémoire du tampon
+ */
+void vOutBufFree (xOutBuf * xBuf);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_OUTBUF_H_ */
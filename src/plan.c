@@ -0,0 +1,240 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "plan.h"
+#include "bits.h"
+
+/* macros =================================================================== */
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+
+// nombre de requêtes nécessaires pour lire n éléments
+#define NB_READS(n,max) (((n) + (max) - 1) / (max))
+
+/* structures =============================================================== */
+typedef struct xRange {
+  int iEvery;
+  int iAddr;
+  int iIndex;
+} xRange;
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static int
+iCompareRange (const void * a, const void * b) {
+  const xRange * ra = (const xRange *) a;
+  const xRange * rb = (const xRange *) b;
+
+  if (ra->iEvery != rb->iEvery) {
+    return (ra->iEvery < rb->iEvery) ? -1 : 1;
+  }
+  if (ra->iAddr != rb->iAddr) {
+    return (ra->iAddr < rb->iAddr) ? -1 : 1;
+  }
+  return ra->iIndex - rb->iIndex;
+}
+
+// -----------------------------------------------------------------------------
+// Découpage d'une plage contiguë en requêtes de taille maximale
+static void
+vAddSpan (xPollPlan * p, int iStart, int iEnd, int iMaxPerRead, int iEvery) {
+  int iAddr;
+
+  for (iAddr = iStart; iAddr < iEnd; iAddr += iMaxPerRead) {
+    xPlanRead * r = &p->xReads[p->iReadCount++];
+
+    r->iAddr = iAddr;
+    r->iCount = MIN (iMaxPerRead, iEnd - iAddr);
+    r->iOffset = p->iImageSize + (iAddr - iStart);
+    r->iEvery = iEvery;
+  }
+  p->iImageSize += iEnd - iStart;
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+xPollPlan *
+xPollPlanNew (const int * piAddr, const int * piEvery,
+              int iRefCount, int iRefSize,
+              int iElemBits, int iMaxPerRead, int iMaxGap) {
+  xPollPlan * p;
+  int j;
+
+  p = calloc (1, sizeof (xPollPlan));
+  if (p == NULL) {
+    return NULL;
+  }
+  p->iRefCount = iRefCount;
+  p->iRefSize = iRefSize;
+  p->iElemBits = iElemBits;
+  p->ulBlockBytes = BITS_SIZE (iRefSize * iElemBits);
+  p->piRefOffset = calloc (iRefCount, sizeof (int));
+  p->piRefEvery = calloc (iRefCount, sizeof (int));
+  // le regroupement ne peut que diminuer le nombre de requêtes
+  p->xReads = calloc (iRefCount * NB_READS (iRefSize, iMaxPerRead),
+                      sizeof (xPlanRead));
+  if ( (p->piRefOffset == NULL) || (p->piRefEvery == NULL) ||
+       (p->xReads == NULL)) {
+
+    vPollPlanDelete (p);
+    return NULL;
+  }
+  for (j = 0; j < iRefCount; j++) {
+
+    p->piRefEvery[j] = piEvery ? piEvery[j] : 1;
+  }
+
+  if (iMaxGap < 0) {
+
+    // une plage, une requête (ou plus si elle dépasse iMaxPerRead)
+    for (j = 0; j < iRefCount; j++) {
+
+      p->piRefOffset[j] = p->iImageSize;
+      vAddSpan (p, piAddr[j], piAddr[j] + iRefSize, iMaxPerRead,
+                p->piRefEvery[j]);
+    }
+  }
+  else {
+    xRange * xSorted = calloc (iRefCount, sizeof (xRange));
+    int iStart = 0, iEnd = 0;
+
+    if (xSorted == NULL) {
+
+      vPollPlanDelete (p);
+      return NULL;
+    }
+    for (j = 0; j < iRefCount; j++) {
+
+      xSorted[j].iEvery = p->piRefEvery[j];
+      xSorted[j].iAddr = piAddr[j];
+      xSorted[j].iIndex = j;
+    }
+    qsort (xSorted, iRefCount, sizeof (xRange), iCompareRange);
+
+    for (j = 0; j < iRefCount; j++) {
+      int a = xSorted[j].iAddr;
+      int b = a + iRefSize;
+
+      // seules les plages de même période sont regroupées
+      if ( (j > 0) && (xSorted[j].iEvery == xSorted[j - 1].iEvery)) {
+        int iMerged = MAX (iEnd, b) - iStart;
+
+        if ( (a <= iEnd) ||
+             ( (a - iEnd <= iMaxGap) &&
+               (NB_READS (iMerged, iMaxPerRead) <
+                NB_READS (iEnd - iStart, iMaxPerRead) +
+                NB_READS (iRefSize, iMaxPerRead)))) {
+
+          // chevauchement, contiguïté ou écart qui économise une requête
+          iEnd = MAX (iEnd, b);
+          p->piRefOffset[xSorted[j].iIndex] = p->iImageSize + (a - iStart);
+          continue;
+        }
+      }
+      if (j > 0) {
+
+        vAddSpan (p, iStart, iEnd, iMaxPerRead, xSorted[j - 1].iEvery);
+      }
+      iStart = a;
+      iEnd = b;
+      p->piRefOffset[xSorted[j].iIndex] = p->iImageSize;
+    }
+    if (iRefCount > 0) {
+
+      vAddSpan (p, iStart, iEnd, iMaxPerRead, xSorted[iRefCount - 1].iEvery);
+    }
+    free (xSorted);
+  }
+
+  p->ulImageBytes = BITS_SIZE (p->iImageSize * iElemBits);
+
+  // l'image peut servir directement de blocs si les plages sont disjointes,
+  // déjà dans l'ordre croissant et chacune au début d'un bloc
+  p->bIsIdentity = (p->iImageSize == iRefCount * iRefSize);
+  for (j = 0; (j < iRefCount) && p->bIsIdentity; j++) {
+
+    p->bIsIdentity = ( (size_t) p->piRefOffset[j] * iElemBits ==
+                       j * p->ulBlockBytes * 8);
+  }
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+void
+vPollPlanScatter (const xPollPlan * p, const void * pvImage,
+                  void * pvBlocks,
+                  const int * piReadError, int * piRefError,
+                  int iCycle) {
+  int j, r;
+
+  for (j = 0; j < p->iRefCount; j++) {
+    int iOffset = p->piRefOffset[j];
+
+    if (!POLL_PLAN_IS_DUE (p->piRefEvery[j], iCycle)) {
+      continue;
+    }
+
+    piRefError[j] = 0;
+    for (r = 0; r < p->iReadCount; r++) {
+      const xPlanRead * xRead = &p->xReads[r];
+
+      if ( (piReadError[r] != 0) &&
+           (xRead->iOffset < iOffset + p->iRefSize) &&
+           (iOffset < xRead->iOffset + xRead->iCount)) {
+
+        piRefError[j] = piReadError[r];
+        break;
+      }
+    }
+
+    if (!p->bIsIdentity) {
+      uint8_t * pucBlock = (uint8_t *) pvBlocks + j * p->ulBlockBytes;
+
+      if (p->iElemBits == 1) {
+
+        vBitsCopy (pucBlock, 0, pvImage, iOffset, p->iRefSize);
+      }
+      else {
+
+        memcpy (pucBlock, (const uint8_t *) pvImage + iOffset * p->iElemBits / 8,
+                p->ulBlockBytes);
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vPollPlanDelete (xPollPlan * p) {
+
+  if (p) {
+
+    free (p->xReads);
+    free (p->piRefOffset);
+    free (p->piRefEvery);
+    free (p);
+  }
+}
+
+/* ========================================================================== */
@@ -0,0 +1,117 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_PLAN_H_
+#define _MBPOLL_PLAN_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* structures =============================================================== */
+/**
+ * Requête de lecture d'un plan de scrutation
+ */
+typedef struct xPlanRead {
+  int iAddr; /**< adresse PDU du premier élément */
+  int iCount; /**< nombre d'éléments (bits ou registres) */
+  int iOffset; /**< position du premier élément dans l'image */
+  int iEvery; /**< période de lecture, en nombre de cycles */
+} xPlanRead;
+
+/**
+ * Plan de scrutation
+ *
+ * Les plages demandées (une par référence de départ) sont regroupées en un
+ * minimum de requêtes. Les requêtes sont lues dans une image contiguë, les
+ * plages sont ensuite recopiées dans des blocs séparés, un par référence,
+ * dans l'ordre de la liste fournie.
+ * Les éléments de 1 bit sont compactés (voir bits.h), dans l'image comme
+ * dans les blocs, chaque bloc commence sur un octet.
+ * Chaque plage peut avoir sa propre période de lecture (classe de
+ * scrutation), exprimée en nombre de cycles : seules les plages de même
+ * période sont regroupées.
+ */
+typedef struct xPollPlan {
+  xPlanRead * xReads; /**< requêtes, par période puis par adresse croissante */
+  int iReadCount; /**< nombre de requêtes */
+  int * piRefOffset; /**< position de chaque plage demandée dans l'image */
+  int * piRefEvery; /**< période de lecture de chaque plage demandée */
+  int iRefCount; /**< nombre de plages demandées */
+  int iRefSize; /**< nombre d'éléments d'une plage demandée */
+  int iImageSize; /**< nombre d'éléments de l'image */
+  int iElemBits; /**< taille d'un élément en bits (1 ou 16) */
+  size_t ulImageBytes; /**< taille de l'image en octets */
+  size_t ulBlockBytes; /**< taille d'un bloc en octets */
+  bool bIsIdentity; /**< vrai si l'image est identique aux blocs */
+} xPollPlan;
+
+/* internal public functions ================================================ */
+
+/**
+ * Construction d'un plan de scrutation
+ *
+ * Les plages qui se chevauchent ou se touchent sont fusionnées, un écart de
+ * iMaxGap éléments au plus est comblé si cela économise une requête.
+ * Aucune requête ne dépasse iMaxPerRead éléments.
+ *
+ * @param piAddr adresses PDU des plages demandées
+ * @param iRefCount nombre de plages
+ * @param piEvery période de lecture de chaque plage en nombre de cycles,
+ * NULL si toutes les plages sont lues à chaque cycle
+ * @param iRefSize nombre d'éléments de chaque plage
+ * @param iElemBits taille d'un élément en bits, 1 pour les bits compactés,
+ * 16 pour les registres
+ * @param iMaxPerRead nombre maximal d'éléments par requête
+ * @param iMaxGap écart maximal comblé, -1 pour ne rien regrouper (une
+ * requête par plage demandée)
+ * @return le plan, NULL si erreur mémoire
+ */
+xPollPlan * xPollPlanNew (const int * piAddr, const int * piEvery,
+                          int iRefCount, int iRefSize,
+                          int iElemBits, int iMaxPerRead, int iMaxGap);
+
+/**
+ * Indique si une période de lecture arrive à échéance au cycle iCycle
+ *
+ * Le premier cycle (0) lit toutes les plages.
+ */
+#define POLL_PLAN_IS_DUE(iEvery, iCycle) (((iCycle) % (iEvery)) == 0)
+
+/**
+ * Recopie des plages demandées de l'image vers les blocs
+ *
+ * Une plage est en erreur si une des requêtes qui la couvre a échoué, le
+ * premier code d'erreur rencontré est retenu. Seules les plages à échéance
+ * au cycle iCycle sont traitées.
+ *
+ * @param pvImage image lue (ulImageBytes octets)
+ * @param pvBlocks blocs de destination (iRefCount * ulBlockBytes octets),
+ * peut être égal à pvImage si bIsIdentity est vrai
+ * @param piReadError code d'erreur de chaque requête (0 si succès)
+ * @param piRefError code d'erreur de chaque plage demandée
+ * @param iCycle numéro du cycle de scrutation
+ */
+void vPollPlanScatter (const xPollPlan * xPlan, const void * pvImage,
+                       void * pvBlocks,
+                       const int * piReadError, int * piRefError,
+                       int iCycle);
+
+/**
+ * Libération d'un plan
+ */
+void vPollPlanDelete (xPollPlan * xPlan);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_PLAN_H_ */
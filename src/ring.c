@@ -0,0 +1,262 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef MBPOLL_PTHREAD
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ring.h"
+#include "timing.h"
+
+/* constants ================================================================ */
+// attente du producteur entre deux essais quand la file est pleine, en µs
+#define RING_BLOCK_DELAY 1000
+
+/* structures =============================================================== */
+struct xRing {
+  uint8_t * pucSlots;
+  uint8_t * pucCopy; // copie de l'entrée traitée, propre au consommateur
+  size_t ulSlotSize;
+  uint32_t ulSlots;
+  eRingPolicy ePolicy;
+  // indices libres (modulo 2^32), l'entrée i est pucSlots[i % ulSlots]
+  uint32_t ulHead; // prochaine entrée à traiter, réservée par CAS
+  uint32_t ulTail; // prochaine entrée à remplir, modifié par le producteur
+  uint32_t ulDone; // entrée en cours de copie, les précédentes sont libres
+  uint64_t ullOverflows;
+  // réveil du consommateur
+  pthread_t xThread;
+  pthread_mutex_t xMutex;
+  pthread_cond_t xReady;
+  bool bIsWaiting;
+  bool bStop;
+  vRingConsumer vConsumer;
+  void * pvUser;
+};
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+// Réservation de l'entrée la plus ancienne par le consommateur, ou par le
+// producteur pour l'abandonner, un seul des deux y parvient
+static bool
+bRingClaim (xRing * r, uint32_t * pulIndex) {
+  uint32_t ulHead = __atomic_load_n (&r->ulHead, __ATOMIC_ACQUIRE);
+
+  do {
+    if (ulHead == __atomic_load_n (&r->ulTail, __ATOMIC_SEQ_CST)) {
+      return false;
+    }
+  }
+  while (!__atomic_compare_exchange_n (&r->ulHead, &ulHead, ulHead + 1, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  *pulIndex = ulHead;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+static void *
+pvRingThread (void * pvArg) {
+  xRing * r = (xRing *) pvArg;
+  uint32_t ulIndex;
+
+  for (;;) {
+
+    if (bRingClaim (r, &ulIndex)) {
+
+      // l'entrée est copiée puis libérée avant d'être traitée : le
+      // producteur n'attend jamais la fin d'une écriture
+      __atomic_store_n (&r->ulDone, ulIndex, __ATOMIC_SEQ_CST);
+      memcpy (r->pucCopy, r->pucSlots + (ulIndex % r->ulSlots) * r->ulSlotSize,
+              r->ulSlotSize);
+      __atomic_store_n (&r->ulDone, ulIndex + 1, __ATOMIC_SEQ_CST);
+      r->vConsumer (r->pucCopy, r->pvUser);
+      continue;
+    }
+
+    pthread_mutex_lock (&r->xMutex);
+    __atomic_store_n (&r->bIsWaiting, true, __ATOMIC_SEQ_CST);
+    while ( (!r->bStop) &&
+            (__atomic_load_n (&r->ulHead, __ATOMIC_SEQ_CST) ==
+             __atomic_load_n (&r->ulTail, __ATOMIC_SEQ_CST))) {
+
+      pthread_cond_wait (&r->xReady, &r->xMutex);
+    }
+    __atomic_store_n (&r->bIsWaiting, false, __ATOMIC_SEQ_CST);
+    if (r->bStop &&
+        (__atomic_load_n (&r->ulHead, __ATOMIC_SEQ_CST) ==
+         __atomic_load_n (&r->ulTail, __ATOMIC_SEQ_CST))) {
+
+      pthread_mutex_unlock (&r->xMutex);
+      break;
+    }
+    pthread_mutex_unlock (&r->xMutex);
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+static void
+vRingWake (xRing * r, bool bStop) {
+
+  pthread_mutex_lock (&r->xMutex);
+  r->bStop |= bStop;
+  pthread_cond_signal (&r->xReady);
+  pthread_mutex_unlock (&r->xMutex);
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+xRing *
+xRingNew (int iSlots, size_t ulSlotSize, eRingPolicy ePolicy,
+          vRingConsumer vConsumer, void * pvUser) {
+  sigset_t xAll, xOld;
+  xRing * r;
+  int iRet;
+
+  if (iSlots < 2) {
+    return NULL;
+  }
+  r = calloc (1, sizeof (xRing));
+  if (r == NULL) {
+    return NULL;
+  }
+  r->pucSlots = calloc (iSlots, ulSlotSize);
+  r->pucCopy = malloc (ulSlotSize);
+  if ( (r->pucSlots == NULL) || (r->pucCopy == NULL)) {
+
+    free (r->pucSlots);
+    free (r->pucCopy);
+    free (r);
+    return NULL;
+  }
+  r->ulSlots = iSlots;
+  r->ulSlotSize = ulSlotSize;
+  r->ePolicy = ePolicy;
+  r->vConsumer = vConsumer;
+  r->pvUser = pvUser;
+  pthread_mutex_init (&r->xMutex, NULL);
+  pthread_cond_init (&r->xReady, NULL);
+
+  // les signaux (Ctrl+C) restent traités par le thread principal
+  sigfillset (&xAll);
+  pthread_sigmask (SIG_SETMASK, &xAll, &xOld);
+  iRet = pthread_create (&r->xThread, NULL, pvRingThread, r);
+  pthread_sigmask (SIG_SETMASK, &xOld, NULL);
+  if (iRet != 0) {
+
+    pthread_cond_destroy (&r->xReady);
+    pthread_mutex_destroy (&r->xMutex);
+    free (r->pucSlots);
+    free (r->pucCopy);
+    free (r);
+    return NULL;
+  }
+  return r;
+}
+
+// -----------------------------------------------------------------------------
+// Indique si toutes les entrées sont occupées, en attente ou en cours de
+// copie
+static bool
+bRingIsFull (xRing * r) {
+
+  return r->ulTail - __atomic_load_n (&r->ulDone, __ATOMIC_SEQ_CST) >=
+         r->ulSlots;
+}
+
+// -----------------------------------------------------------------------------
+void *
+pvRingAcquire (xRing * r) {
+  uint32_t ulIndex;
+  bool bIsDropped = false;
+
+  if (bRingIsFull (r)) {
+
+    r->ullOverflows++;
+    if (r->ePolicy == eRingCount) {
+      return NULL;
+    }
+    if (r->ePolicy == eRingDropOldest) {
+
+      // l'entrée abandonnée ne sera pas traitée
+      bIsDropped = bRingClaim (r, &ulIndex);
+    }
+    do {
+      uint32_t ulDone = __atomic_load_n (&r->ulDone, __ATOMIC_SEQ_CST);
+
+      if (bIsDropped) {
+
+        // le consommateur n'avance ulDone que sur les entrées qu'il a copiées,
+        // celle qui vient d'être abandonnée est libérée ici dès qu'il a fini
+        // la copie de la précédente. Au pire, la copie en cours est attendue.
+        if ( (ulDone == ulIndex) &&
+             __atomic_compare_exchange_n (&r->ulDone, &ulDone, ulIndex + 1,
+                                          false, __ATOMIC_SEQ_CST,
+                                          __ATOMIC_SEQ_CST)) {
+          continue;
+        }
+        sched_yield();
+      }
+      else {
+
+        vTimeSleepUntilUs (ullTimeNowUs() + RING_BLOCK_DELAY);
+      }
+    }
+    while (bRingIsFull (r));
+  }
+  return r->pucSlots + (r->ulTail % r->ulSlots) * r->ulSlotSize;
+}
+
+// -----------------------------------------------------------------------------
+void
+vRingCommit (xRing * r) {
+
+  __atomic_store_n (&r->ulTail, r->ulTail + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n (&r->bIsWaiting, __ATOMIC_SEQ_CST)) {
+
+    vRingWake (r, false);
+  }
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullRingOverflows (const xRing * r) {
+
+  return r->ullOverflows;
+}
+
+// -----------------------------------------------------------------------------
+void
+vRingDelete (xRing * r) {
+
+  if (r) {
+
+    vRingWake (r, true);
+    pthread_join (r->xThread, NULL);
+    pthread_cond_destroy (&r->xReady);
+    pthread_mutex_destroy (&r->xMutex);
+    free (r->pucSlots);
+    free (r->pucCopy);
+    free (r);
+  }
+}
+
+#endif /* MBPOLL_PTHREAD defined */
+/* ========================================================================== */
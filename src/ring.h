@@ -0,0 +1,93 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_RING_H_
+#define _MBPOLL_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* constants ================================================================ */
+/**
+ * Comportement du producteur quand la file est pleine
+ */
+typedef enum {
+  eRingBlock, /**< attente d'une place libre */
+  eRingDropOldest, /**< la plus ancienne entrée en attente est abandonnée */
+  eRingCount, /**< la nouvelle entrée est abandonnée */
+} eRingPolicy;
+
+/* structures =============================================================== */
+/**
+ * File circulaire à un producteur et un consommateur (opaque)
+ *
+ * Les entrées sont de taille fixe et allouées à la création. Le producteur
+ * les remplit sur place, un thread dédié les traite dans l'ordre. Les
+ * indices de lecture et d'écriture sont partagés sans verrou, le thread
+ * consommateur ne s'endort que si la file est vide.
+ * Le consommateur copie chaque entrée avant de la traiter et publie la fin
+ * de la copie, sa place n'est réutilisée qu'ensuite. Le producteur n'attend
+ * donc jamais la fin d'un traitement, au plus celle d'une copie : avec
+ * eRingDropOldest, la place de l'entrée abandonnée est aussitôt réutilisée.
+ */
+typedef struct xRing xRing;
+
+/**
+ * Traitement d'une entrée par le thread consommateur
+ */
+typedef void (*vRingConsumer) (void * pvSlot, void * pvUser);
+
+/* internal public functions ================================================ */
+
+/**
+ * Création d'une file et démarrage de son thread consommateur
+ *
+ * Les signaux sont bloqués dans le thread consommateur.
+ *
+ * @param iSlots nombre d'entrées (au moins 2)
+ * @param ulSlotSize taille d'une entrée en octets
+ * @return la file, NULL si erreur
+ */
+xRing * xRingNew (int iSlots, size_t ulSlotSize, eRingPolicy ePolicy,
+                  vRingConsumer vConsumer, void * pvUser);
+
+/**
+ * Entrée à remplir par le producteur
+ *
+ * Si la file est pleine, la politique choisie à la création s'applique et
+ * le débordement est compté.
+ *
+ * @return l'entrée, NULL si elle doit être abandonnée (eRingCount)
+ */
+void * pvRingAcquire (xRing * xRing);
+
+/**
+ * Publication de l'entrée obtenue par pvRingAcquire()
+ */
+void vRingCommit (xRing * xRing);
+
+/**
+ * Nombre de débordements : entrées abandonnées ou attentes du producteur
+ */
+uint64_t ullRingOverflows (const xRing * xRing);
+
+/**
+ * Arrêt du thread consommateur, après le traitement des entrées en attente,
+ * et libération de la file
+ */
+void vRingDelete (xRing * xRing);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_RING_H_ */
@@ -0,0 +1,85 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rto.h"
+
+/* constants ================================================================ */
+// au-delà, le timeout a de toute façon atteint sa borne maximale
+#define RTO_BACKOFF_MAX 16
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vRtoInit (xRto * e, uint64_t ullMin, uint64_t ullMax) {
+
+  e->ullSrtt = 0;
+  e->ullRttVar = 0;
+  e->ullMin = ullMin;
+  e->ullMax = ullMax;
+  e->iBackoff = 0;
+  e->bHasSample = false;
+}
+
+// -----------------------------------------------------------------------------
+void
+vRtoSample (xRto * e, uint64_t ullRtt) {
+
+  if (e->bHasSample) {
+    uint64_t ullDelta = (e->ullSrtt > ullRtt) ?
+                        e->ullSrtt - ullRtt : ullRtt - e->ullSrtt;
+
+    // gains de 1/4 et 1/8, comme TCP
+    e->ullRttVar = (3 * e->ullRttVar + ullDelta) / 4;
+    e->ullSrtt = (7 * e->ullSrtt + ullRtt) / 8;
+  }
+  else {
+
+    e->ullSrtt = ullRtt;
+    e->ullRttVar = ullRtt / 2;
+    e->bHasSample = true;
+  }
+  e->iBackoff = 0;
+}
+
+// -----------------------------------------------------------------------------
+void
+vRtoTimeout (xRto * e) {
+
+  if (e->iBackoff < RTO_BACKOFF_MAX) {
+    e->iBackoff++;
+  }
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullRtoValue (const xRto * e) {
+  uint64_t ullRto;
+
+  if (!e->bHasSample) {
+    return e->ullMax;
+  }
+
+  ullRto = (e->ullSrtt + 4 * e->ullRttVar) << e->iBackoff;
+  if (ullRto < e->ullMin) {
+    ullRto = e->ullMin;
+  }
+  if (ullRto > e->ullMax) {
+    ullRto = e->ullMax;
+  }
+  return ullRto;
+}
+
+/* ========================================================================== */
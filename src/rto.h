@@ -0,0 +1,65 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_RTO_H_
+#define _MBPOLL_RTO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* structures =============================================================== */
+/**
+ * Estimateur de timeout de réponse
+ *
+ * Même principe que le RTO de TCP (RFC 6298) : moyenne glissante du temps
+ * de réponse (SRTT) et de sa variation (RTTVAR), le timeout vaut
+ * SRTT + 4 * RTTVAR. Il double à chaque timeout consécutif et reste toujours
+ * dans les bornes fixées. Tous les temps sont en microsecondes.
+ */
+typedef struct xRto {
+  uint64_t ullSrtt; /**< temps de réponse lissé */
+  uint64_t ullRttVar; /**< variation lissée du temps de réponse */
+  uint64_t ullMin; /**< timeout minimal */
+  uint64_t ullMax; /**< timeout maximal, utilisé avant la première mesure */
+  int iBackoff; /**< nombre de timeouts consécutifs */
+  bool bHasSample; /**< vrai si au moins une mesure a été faite */
+} xRto;
+
+/* internal public functions ================================================ */
+
+/**
+ * Initialisation d'un estimateur
+ */
+void vRtoInit (xRto * xEst, uint64_t ullMin, uint64_t ullMax);
+
+/**
+ * Prise en compte d'un temps de réponse mesuré
+ *
+ * Une réponse d'exception est une réponse valide et doit être mesurée.
+ */
+void vRtoSample (xRto * xEst, uint64_t ullRtt);
+
+/**
+ * Prise en compte d'un timeout, le timeout suivant est doublé
+ */
+void vRtoTimeout (xRto * xEst);
+
+/**
+ * Timeout à appliquer à la prochaine requête
+ */
+uint64_t ullRtoValue (const xRto * xEst);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_RTO_H_ */
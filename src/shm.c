@@ -0,0 +1,222 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "shm.h"
+#ifdef MBPOLL_SHM
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bits.h"
+
+/* macros =================================================================== */
+#define ALIGN8(n) ( ( (n) + 7) & ~ (size_t) 7)
+
+/* structures =============================================================== */
+struct xShm {
+  char * sName;
+  uint8_t * pucBase;
+  size_t ulSize;
+  xShmHeader * xHdr;
+};
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static inline xShmSlot *
+xSlot (const xShm * x, int iSlave) {
+
+  return (xShmSlot *) (x->pucBase + x->xHdr->ulSlotOffset +
+                       (size_t) iSlave * x->xHdr->ulSlotSize);
+}
+
+// -----------------------------------------------------------------------------
+// Indique si le segment existant sName a été laissé par un processus qui
+// n'existe plus, il peut alors être remplacé
+static bool
+bIsStale (const char * sName) {
+  struct stat xStat;
+  xShmHeader * xHdr;
+  bool bStale = false;
+  int iFd = shm_open (sName, O_RDONLY, 0);
+
+  if (iFd < 0) {
+    // supprimé entre-temps
+    return errno == ENOENT;
+  }
+  // un segment trop petit est en cours de création
+  if ( (fstat (iFd, &xStat) == 0) &&
+       (xStat.st_size >= (off_t) sizeof (xShmHeader))) {
+
+    xHdr = mmap (NULL, sizeof (xShmHeader), PROT_READ, MAP_SHARED, iFd, 0);
+    if (xHdr != MAP_FAILED) {
+
+      bStale = (xHdr->ulPid != 0) && (kill ( (pid_t) xHdr->ulPid, 0) != 0) &&
+               (errno == ESRCH);
+      munmap (xHdr, sizeof (xShmHeader));
+    }
+  }
+  close (iFd);
+  return bStale;
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+xShm *
+xShmCreate (const char * sName, const xShmHeader * h,
+            const int * piRef, const int * piSlave) {
+  xShmHeader xHdr = *h;
+  xShm * x;
+  int i, iFd, iError;
+
+  x = calloc (1, sizeof (xShm));
+  if (x == NULL) {
+    return NULL;
+  }
+  x->sName = malloc (strlen (sName) + 2);
+  if (x->sName == NULL) {
+
+    free (x);
+    return NULL;
+  }
+  strcpy (x->sName, (sName[0] == '/') ? "" : "/");
+  strcat (x->sName, sName);
+
+  // organisation du segment
+  xHdr.ulMagic = 0;
+  xHdr.ulVersion = SHM_VERSION;
+  xHdr.ulPid = (uint32_t) getpid();
+  xHdr.ulBlockBytes = ALIGN8 (BITS_SIZE (xHdr.ulBlockSize * xHdr.ulElemBits));
+  xHdr.ulRefOffset = sizeof (xShmHeader);
+  xHdr.ulSlotOffset = ALIGN8 (xHdr.ulRefOffset + xHdr.ulRefCount * 4);
+  xHdr.ulErrorOffset = sizeof (xShmSlot);
+  xHdr.ulDataOffset = ALIGN8 (xHdr.ulErrorOffset + xHdr.ulRefCount * 4);
+  xHdr.ulSlotSize = xHdr.ulDataOffset + xHdr.ulRefCount * xHdr.ulBlockBytes;
+  xHdr.ulReserved = 0;
+  x->ulSize = xHdr.ulSlotOffset + (size_t) xHdr.ulSlaveCount * xHdr.ulSlotSize;
+
+  // un segment laissé par une instance arrêtée est remplacé, celui d'une
+  // instance active n'est jamais modifié
+  iFd = shm_open (x->sName, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if ( (iFd < 0) && (errno == EEXIST)) {
+
+    if (!bIsStale (x->sName)) {
+
+      errno = EEXIST;
+      goto error;
+    }
+    shm_unlink (x->sName);
+    iFd = shm_open (x->sName, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (iFd < 0) {
+    goto error;
+  }
+  if (ftruncate (iFd, x->ulSize) != 0) {
+
+    iError = errno;
+    close (iFd);
+    shm_unlink (x->sName);
+    errno = iError;
+    goto error;
+  }
+  x->pucBase = mmap (NULL, x->ulSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     iFd, 0);
+  iError = errno;
+  close (iFd);
+  if (x->pucBase == MAP_FAILED) {
+
+    shm_unlink (x->sName);
+    errno = iError;
+    goto error;
+  }
+
+  // le segment est à zéro après ftruncate()
+  x->xHdr = (xShmHeader *) x->pucBase;
+  *x->xHdr = xHdr;
+  for (i = 0; i < (int) xHdr.ulRefCount; i++) {
+
+    ( (int32_t *) (x->pucBase + xHdr.ulRefOffset)) [i] = piRef[i];
+  }
+  for (i = 0; i < (int) xHdr.ulSlaveCount; i++) {
+
+    xSlot (x, i)->ulAddr = piSlave[i];
+  }
+  // le segment est prêt
+  __atomic_store_n (&x->xHdr->ulMagic, SHM_MAGIC, __ATOMIC_RELEASE);
+  return x;
+
+error:
+  iError = errno;
+  free (x->sName);
+  free (x);
+  errno = iError;
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+void
+vShmBegin (xShm * x, int iSlave, uint64_t ullTime, uint64_t ullCycle) {
+  xShmSlot * xSlt = xSlot (x, iSlave);
+
+  // ulSeq impair : les lecteurs ignorent ce qu'ils lisent jusqu'à vShmEnd()
+  __atomic_store_n (&xSlt->ulSeq, xSlt->ulSeq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  xSlt->ullTime = ullTime;
+  xSlt->ullCycle = ullCycle;
+}
+
+// -----------------------------------------------------------------------------
+void
+vShmUpdate (xShm * x, int iSlave, int iRef, int iError,
+            const void * pvBlock) {
+  const xShmHeader * h = x->xHdr;
+  uint8_t * pucSlot = (uint8_t *) xSlot (x, iSlave);
+
+  ( (int32_t *) (pucSlot + h->ulErrorOffset)) [iRef] = iError;
+  if (iError == 0) {
+
+    memcpy (pucSlot + h->ulDataOffset + (size_t) iRef * h->ulBlockBytes,
+            pvBlock, BITS_SIZE (h->ulBlockSize * h->ulElemBits));
+  }
+}
+
+// -----------------------------------------------------------------------------
+void
+vShmEnd (xShm * x, int iSlave) {
+  xShmSlot * xSlt = xSlot (x, iSlave);
+
+  __atomic_store_n (&xSlt->ulSeq, xSlt->ulSeq + 1, __ATOMIC_RELEASE);
+}
+
+// -----------------------------------------------------------------------------
+void
+vShmDelete (xShm * x) {
+
+  if (x) {
+
+    munmap (x->pucBase, x->ulSize);
+    shm_unlink (x->sName);
+    free (x->sName);
+    free (x);
+  }
+}
+
+#endif /* MBPOLL_SHM defined */
+/* ========================================================================== */
@@ -0,0 +1,163 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_SHM_H_
+#define _MBPOLL_SHM_H_
+
+#include <stdint.h>
+
+/*
+ * Image des registres en mémoire partagée (--shm)
+ *
+ * mbpoll publie les dernières valeurs lues dans un segment de mémoire
+ * partagée POSIX, que d'autres programmes de la même machine peuvent lire
+ * sans interroger les esclaves. Ce fichier décrit l'organisation du segment,
+ * il peut être inclus tel quel par les lecteurs.
+ *
+ * Le segment contient une entête xShmHeader, la table des références de
+ * départ (ulRefCount entiers de 32 bits, à partir de ulRefOffset), puis un
+ * emplacement de ulSlotSize octets par esclave, à partir de ulSlotOffset,
+ * dans l'ordre de la liste des esclaves. Un emplacement commence par un
+ * xShmSlot, suivi des codes d'erreur (ulRefCount entiers signés de 32 bits,
+ * à ulErrorOffset) et des blocs de données (ulRefCount blocs de
+ * ulBlockBytes octets, à ulDataOffset), un par référence de départ.
+ * Tous les champs sont dans l'ordre des octets de l'hôte et alignés sur
+ * leur taille.
+ *
+ * Un bloc contient les bits compactés (le bit 0 de l'octet 0 est la
+ * référence de départ) ou les registres de 16 bits tels qu'ils ont été lus.
+ * Les valeurs de 32 et 64 bits (ulValueWords registres) ne sont pas
+ * décodées, ulOrder donne l'ordre de leurs octets : 0 abcd, 1 cdab, 2 badc,
+ * 3 dcba. Quand une lecture échoue, son code d'erreur (errno, codes
+ * libmodbus pour les exceptions) est non nul et le bloc garde les dernières
+ * valeurs lues.
+ *
+ * Chaque emplacement est protégé par un verrou de séquence (seqlock) :
+ * ulSeq est impair pendant une mise à jour. Un lecteur obtient une copie
+ * cohérente, ou lit sur place sans copie, de la façon suivante :
+ *
+ *   do {
+ *     s1 = __atomic_load_n (&slot->ulSeq, __ATOMIC_ACQUIRE);
+ *     ... lecture des erreurs et des blocs ...
+ *     __atomic_thread_fence (__ATOMIC_ACQUIRE);
+ *     s2 = __atomic_load_n (&slot->ulSeq, __ATOMIC_RELAXED);
+ *   } while ((s1 & 1) || (s1 != s2));
+ *
+ * ulMagic est écrit en dernier à la création : un lecteur qui trouve une
+ * autre valeur doit réessayer plus tard. Le segment est supprimé à la sortie
+ * de mbpoll, ulPid permet de vérifier que l'écrivain est toujours actif : un
+ * segment dont l'écrivain est actif n'est jamais remplacé par un autre mbpoll.
+ */
+
+/* constants ================================================================ */
+/**
+ * Signature du segment, "MBPS"
+ */
+#define SHM_MAGIC 0x5350424DUL
+
+/**
+ * Version de l'organisation du segment
+ */
+#define SHM_VERSION 1
+
+/* structures =============================================================== */
+/**
+ * Entête du segment
+ */
+typedef struct xShmHeader {
+  uint32_t ulMagic; /**< SHM_MAGIC quand le segment est prêt */
+  uint32_t ulVersion; /**< SHM_VERSION */
+  uint32_t ulPid; /**< identifiant du processus mbpoll */
+  uint32_t ulFunction; /**< code fonction ModBus (1 à 4) */
+  uint32_t ulElemBits; /**< taille d'un élément en bits (1 ou 16) */
+  uint32_t ulValueWords; /**< nombre de registres par valeur (1, 2 ou 4) */
+  uint32_t ulOrder; /**< ordre des octets des valeurs de 32 et 64 bits */
+  uint32_t ulPollRate; /**< période de scrutation en ms */
+  uint32_t ulBlockSize; /**< nombre d'éléments d'un bloc */
+  uint32_t ulBlockBytes; /**< taille d'un bloc en octets, multiple de 8 */
+  uint32_t ulRefCount; /**< nombre de références de départ */
+  uint32_t ulSlaveCount; /**< nombre d'esclaves */
+  uint32_t ulRefOffset; /**< position de la table des références */
+  uint32_t ulSlotOffset; /**< position du premier emplacement */
+  uint32_t ulSlotSize; /**< taille d'un emplacement en octets */
+  uint32_t ulErrorOffset; /**< position des erreurs dans un emplacement */
+  uint32_t ulDataOffset; /**< position des blocs dans un emplacement */
+  uint32_t ulReserved;
+} xShmHeader;
+
+/**
+ * Début de l'emplacement d'un esclave
+ */
+typedef struct xShmSlot {
+  uint32_t ulSeq; /**< compteur du verrou de séquence, impair pendant l'écriture */
+  uint32_t ulAddr; /**< adresse de l'esclave */
+  uint64_t ullTime; /**< heure de la dernière scrutation, en µs (UTC) */
+  uint64_t ullCycle; /**< numéro du cycle de la dernière scrutation */
+} xShmSlot;
+
+/* internal public functions ================================================ */
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+#define MBPOLL_SHM
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Segment ouvert en écriture (opaque)
+ */
+typedef struct xShm xShm;
+
+/**
+ * Création du segment
+ *
+ * Les champs de l'entête qui décrivent la scrutation sont fournis par
+ * xHdr, les positions et les tailles sont calculées ici.
+ *
+ * @param sName nom du segment, "/" est ajouté au début s'il manque
+ * @param piRef références de départ
+ * @param piSlave adresses des esclaves
+ * @return le segment, NULL si erreur (errno est positionné, EEXIST si un
+ * processus actif utilise déjà ce nom)
+ */
+xShm * xShmCreate (const char * sName, const xShmHeader * xHdr,
+                   const int * piRef, const int * piSlave);
+
+/**
+ * Début de la mise à jour de l'emplacement d'un esclave
+ */
+void vShmBegin (xShm * xShm, int iSlave, uint64_t ullTime, uint64_t ullCycle);
+
+/**
+ * Mise à jour d'une référence de départ, entre vShmBegin() et vShmEnd()
+ *
+ * @param iError 0 si succès, errno sinon, le bloc n'est alors pas copié
+ * @param pvBlock bloc lu
+ */
+void vShmUpdate (xShm * xShm, int iSlave, int iRef, int iError,
+                 const void * pvBlock);
+
+/**
+ * Fin de la mise à jour de l'emplacement d'un esclave
+ */
+void vShmEnd (xShm * xShm, int iSlave);
+
+/**
+ * Suppression du segment
+ */
+void vShmDelete (xShm * xShm);
+
+#endif /* MBPOLL_SHM defined */
+
+/* ========================================================================== */
+#endif /* _MBPOLL_SHM_H_ */
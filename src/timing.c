@@ -0,0 +1,97 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <time.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "timing.h"
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullTimeNowUs (void) {
+#ifdef _WIN32
+  static LARGE_INTEGER xFreq;
+  LARGE_INTEGER xNow;
+
+  if (xFreq.QuadPart == 0) {
+    QueryPerformanceFrequency (&xFreq);
+  }
+  QueryPerformanceCounter (&xNow);
+  return (uint64_t) (xNow.QuadPart / xFreq.QuadPart) * 1000000ULL +
+         (uint64_t) (xNow.QuadPart % xFreq.QuadPart) * 1000000ULL /
+         xFreq.QuadPart;
+#else
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000ULL + (uint64_t) t.tv_nsec / 1000ULL;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullTimeRealUs (void) {
+#ifdef _WIN32
+  FILETIME xFt;
+  ULARGE_INTEGER xNow;
+
+  // intervalles de 100 ns depuis le 1er janvier 1601
+  GetSystemTimeAsFileTime (&xFt);
+  xNow.LowPart = xFt.dwLowDateTime;
+  xNow.HighPart = xFt.dwHighDateTime;
+  return (xNow.QuadPart - 116444736000000000ULL) / 10ULL;
+#else
+  struct timespec t;
+
+  clock_gettime (CLOCK_REALTIME, &t);
+  return (uint64_t) t.tv_sec * 1000000ULL + (uint64_t) t.tv_nsec / 1000ULL;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+void
+vTimeSleepUntilUs (uint64_t ullDeadline) {
+#if defined (__linux__) || defined (__FreeBSD__)
+  struct timespec t;
+
+  t.tv_sec = ullDeadline / 1000000ULL;
+  t.tv_nsec = (ullDeadline % 1000000ULL) * 1000UL;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR)
+    ;
+#else
+  uint64_t ullNow = ullTimeNowUs ();
+
+  // pas de réveil absolu, l'attente relative est calculée au dernier moment
+  if (ullDeadline > ullNow) {
+    uint64_t ullDelay = ullDeadline - ullNow;
+#ifdef _WIN32
+    Sleep ( (DWORD) ( (ullDelay + 999) / 1000));
+#else
+    struct timespec t;
+
+    t.tv_sec = ullDelay / 1000000ULL;
+    t.tv_nsec = (ullDelay % 1000000ULL) * 1000UL;
+    while ( (nanosleep (&t, &t) != 0) && (errno == EINTR))
+      ;
+#endif
+  }
+#endif
+}
+
+/* ========================================================================== */
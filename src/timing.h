@@ -0,0 +1,49 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_TIMING_H_
+#define _MBPOLL_TIMING_H_
+
+#include <stdint.h>
+
+/* internal public functions ================================================ */
+
+/**
+ * Temps écoulé en microsecondes depuis une origine arbitraire
+ *
+ * L'horloge est monotone, elle n'est pas affectée par les réglages de
+ * l'heure système.
+ */
+uint64_t ullTimeNowUs (void);
+
+/**
+ * Heure système en microsecondes depuis le 1er janvier 1970 (UTC)
+ *
+ * Sert à horodater les résultats, pas à mesurer des durées.
+ */
+uint64_t ullTimeRealUs (void);
+
+/**
+ * Attente jusqu'à une échéance absolue
+ *
+ * L'échéance est exprimée dans la même base de temps que ullTimeNowUs(),
+ * le retour est immédiat si elle est déjà passée. Contrairement à une
+ * attente relative, le temps passé entre le calcul de l'échéance et l'appel
+ * ne décale pas le réveil.
+ */
+void vTimeSleepUntilUs (uint64_t ullDeadline);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_TIMING_H_ */
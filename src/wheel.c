@@ -0,0 +1,147 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include "wheel.h"
+
+/* macros =================================================================== */
+#define BUCKET(w,t) (&(w)->xBuckets[(t) & (WHEEL_SIZE - 1)])
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+void
+vWheelInit (xWheel * w, uint64_t ullTick, uint64_t ullNow) {
+  int i;
+
+  for (i = 0; i < WHEEL_SIZE; i++) {
+
+    w->xBuckets[i].xNext = w->xBuckets[i].xPrev = &w->xBuckets[i];
+  }
+  w->ullTick = ullTick;
+  w->ullPos = ullNow / ullTick;
+  w->iCount = 0;
+}
+
+// -----------------------------------------------------------------------------
+void
+vWheelAdd (xWheel * w, xWheelTimer * t, uint64_t ullDeadline) {
+  uint64_t ullTick = ullDeadline / w->ullTick;
+  xWheelTimer * xHead;
+
+  // une échéance déjà passée est traitée au prochain examen
+  xHead = BUCKET (w, (ullTick < w->ullPos) ? w->ullPos : ullTick);
+  t->ullDeadline = ullDeadline;
+  t->xNext = xHead;
+  t->xPrev = xHead->xPrev;
+  xHead->xPrev->xNext = t;
+  xHead->xPrev = t;
+  w->iCount++;
+}
+
+// -----------------------------------------------------------------------------
+void
+vWheelRemove (xWheel * w, xWheelTimer * t) {
+
+  t->xPrev->xNext = t->xNext;
+  t->xNext->xPrev = t->xPrev;
+  t->xNext = t->xPrev = NULL;
+  w->iCount--;
+}
+
+// -----------------------------------------------------------------------------
+xWheelTimer *
+xWheelExpire (xWheel * w, uint64_t ullNow) {
+  uint64_t ullEnd = ullNow / w->ullTick;
+
+  if (w->iCount == 0) {
+
+    // rien à examiner, la roue avance directement
+    if (ullEnd > w->ullPos) {
+      w->ullPos = ullEnd;
+    }
+    return NULL;
+  }
+
+  for (;;) {
+    xWheelTimer * xHead = BUCKET (w, w->ullPos);
+    xWheelTimer * t;
+
+    for (t = xHead->xNext; t != xHead; t = t->xNext) {
+
+      if (t->ullDeadline <= ullNow) {
+
+        vWheelRemove (w, t);
+        return t;
+      }
+    }
+    if (w->ullPos >= ullEnd) {
+      return NULL;
+    }
+    // après une longue attente, chaque case n'est examinée qu'une fois
+    if (ullEnd - w->ullPos > WHEEL_SIZE) {
+
+      w->ullPos = ullEnd - WHEEL_SIZE;
+    }
+    w->ullPos++;
+  }
+}
+
+// -----------------------------------------------------------------------------
+uint64_t
+ullWheelNext (const xWheel * w) {
+  uint64_t ullNext = UINT64_MAX;
+  uint64_t ullPos;
+  int i;
+
+  if (w->iCount == 0) {
+    return UINT64_MAX;
+  }
+
+  // la première case qui contient une échéance de son propre tour donne
+  // la prochaine échéance, les cases précédentes sont vides pour ce tour
+  for (i = 0, ullPos = w->ullPos; i < WHEEL_SIZE; i++, ullPos++) {
+    const xWheelTimer * xHead = BUCKET (w, ullPos);
+    const xWheelTimer * t;
+
+    for (t = xHead->xNext; t != xHead; t = t->xNext) {
+
+      if ( (t->ullDeadline / w->ullTick <= ullPos) &&
+           (t->ullDeadline < ullNext)) {
+
+        ullNext = t->ullDeadline;
+      }
+    }
+    if (ullNext != UINT64_MAX) {
+      return ullNext;
+    }
+  }
+
+  // toutes les échéances sont au-delà d'un tour
+  for (i = 0; i < WHEEL_SIZE; i++) {
+    const xWheelTimer * xHead = &w->xBuckets[i];
+    const xWheelTimer * t;
+
+    for (t = xHead->xNext; t != xHead; t = t->xNext) {
+
+      if (t->ullDeadline < ullNext) {
+        ullNext = t->ullDeadline;
+      }
+    }
+  }
+  return ullNext;
+}
+
+/* ========================================================================== */
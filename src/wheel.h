@@ -0,0 +1,91 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_WHEEL_H_
+#define _MBPOLL_WHEEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* constants ================================================================ */
+/**
+ * Nombre de cases de la roue, une puissance de 2
+ */
+#define WHEEL_SIZE 1024
+
+/* structures =============================================================== */
+/**
+ * Echéance, à inclure dans la structure de celui qui l'arme
+ */
+typedef struct xWheelTimer {
+  struct xWheelTimer * xNext;
+  struct xWheelTimer * xPrev;
+  uint64_t ullDeadline; /**< échéance en µs (horloge de ullTimeNowUs()) */
+} xWheelTimer;
+
+/**
+ * Roue d'échéances (hashed timing wheel)
+ *
+ * Une échéance est rangée dans la case de son tick (ullTick µs), modulo
+ * WHEEL_SIZE : l'armement et l'annulation se font en temps constant, quel
+ * que soit le nombre d'échéances. Une case peut contenir des échéances des
+ * tours suivants, elles y restent jusqu'à leur tour.
+ */
+typedef struct xWheel {
+  xWheelTimer xBuckets[WHEEL_SIZE]; // têtes de liste circulaire
+  uint64_t ullTick; // durée d'une case en µs
+  uint64_t ullPos; // tick de la prochaine case à examiner
+  int iCount; // nombre d'échéances armées
+} xWheel;
+
+/* internal public functions ================================================ */
+
+/**
+ * Initialisation d'une roue vide
+ *
+ * @param ullTick durée d'une case en µs
+ * @param ullNow heure courante en µs
+ */
+void vWheelInit (xWheel * xWheel, uint64_t ullTick, uint64_t ullNow);
+
+/**
+ * Armement d'une échéance, qui ne doit pas être déjà armée
+ */
+void vWheelAdd (xWheel * xWheel, xWheelTimer * xTimer, uint64_t ullDeadline);
+
+/**
+ * Annulation d'une échéance armée
+ */
+void vWheelRemove (xWheel * xWheel, xWheelTimer * xTimer);
+
+/**
+ * Echéance expirée suivante
+ *
+ * L'échéance retournée est désarmée. A appeler jusqu'à ce qu'elle retourne
+ * NULL pour traiter toutes les échéances atteintes.
+ *
+ * @return une échéance antérieure ou égale à ullNow, NULL s'il n'y en a plus
+ */
+xWheelTimer * xWheelExpire (xWheel * xWheel, uint64_t ullNow);
+
+/**
+ * Heure de la prochaine échéance
+ *
+ * @return l'échéance la plus proche, UINT64_MAX si aucune n'est armée
+ */
+uint64_t ullWheelNext (const xWheel * xWheel);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_WHEEL_H_ */
@@ -0,0 +1,178 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef MBPOLL_PTHREAD
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+#include "workers.h"
+
+/* structures =============================================================== */
+typedef struct xWorkerThread {
+  pthread_t xThread;
+  void * pvWorker;
+  xWorkerPool * xPool;
+} xWorkerThread;
+
+struct xWorkerPool {
+  int iCount;
+  xWorkerThread * xThreads;
+  pthread_mutex_t xMutex;
+  pthread_cond_t xStart;
+  pthread_cond_t xDone;
+  // Lot en cours, protégé par xMutex
+  vWorkerJob vJob;
+  void * pvUser;
+  int iJobCount;
+  int iNext;
+  int iPending;
+  bool bStop;
+};
+
+/* private functions ======================================================== */
+
+// -----------------------------------------------------------------------------
+static void *
+pvWorkerThread (void * pvArg) {
+  xWorkerThread * t = (xWorkerThread *) pvArg;
+  xWorkerPool * p = t->xPool;
+
+  pthread_mutex_lock (&p->xMutex);
+  for (;;) {
+    int i;
+
+    while ( (!p->bStop) && (p->iNext >= p->iJobCount)) {
+
+      pthread_cond_wait (&p->xStart, &p->xMutex);
+    }
+    if (p->bStop) {
+      break;
+    }
+
+    i = p->iNext++;
+    pthread_mutex_unlock (&p->xMutex);
+    p->vJob (t->pvWorker, i, p->pvUser);
+    pthread_mutex_lock (&p->xMutex);
+
+    if (--p->iPending == 0) {
+
+      pthread_cond_signal (&p->xDone);
+    }
+  }
+  pthread_mutex_unlock (&p->xMutex);
+  return NULL;
+}
+
+/* internal public functions ================================================ */
+
+// -----------------------------------------------------------------------------
+xWorkerPool *
+xWorkerPoolNew (int iCount, void ** ppvWorker) {
+  xWorkerPool * p;
+  sigset_t xAll, xOld;
+  int i;
+
+  p = calloc (1, sizeof (xWorkerPool));
+  if (p == NULL) {
+    return NULL;
+  }
+  p->xThreads = calloc (iCount, sizeof (xWorkerThread));
+  if (p->xThreads == NULL) {
+    free (p);
+    return NULL;
+  }
+  pthread_mutex_init (&p->xMutex, NULL);
+  pthread_cond_init (&p->xStart, NULL);
+  pthread_cond_init (&p->xDone, NULL);
+
+  // les signaux (Ctrl+C) restent traités par le thread principal
+  sigfillset (&xAll);
+  pthread_sigmask (SIG_SETMASK, &xAll, &xOld);
+
+  for (i = 0; i < iCount; i++) {
+    xWorkerThread * t = &p->xThreads[i];
+
+    t->pvWorker = ppvWorker[i];
+    t->xPool = p;
+    if (pthread_create (&t->xThread, NULL, pvWorkerThread, t) != 0) {
+
+      pthread_sigmask (SIG_SETMASK, &xOld, NULL);
+      vWorkerPoolDelete (p);
+      return NULL;
+    }
+    p->iCount++;
+  }
+  pthread_sigmask (SIG_SETMASK, &xOld, NULL);
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+int
+iWorkerPoolRun (xWorkerPool * p, int iJobCount, vWorkerJob vJob,
+                void * pvUser) {
+
+  if ( (p == NULL) || (p->iCount == 0)) {
+    return -1;
+  }
+  if (iJobCount <= 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock (&p->xMutex);
+  p->vJob = vJob;
+  p->pvUser = pvUser;
+  p->iNext = 0;
+  p->iPending = iJobCount;
+  p->iJobCount = iJobCount;
+  pthread_cond_broadcast (&p->xStart);
+
+  while (p->iPending > 0) {
+
+    pthread_cond_wait (&p->xDone, &p->xMutex);
+  }
+  p->iJobCount = 0;
+  p->iNext = 0;
+  pthread_mutex_unlock (&p->xMutex);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+void
+vWorkerPoolDelete (xWorkerPool * p) {
+
+  if (p) {
+    int i;
+
+    pthread_mutex_lock (&p->xMutex);
+    p->bStop = true;
+    pthread_cond_broadcast (&p->xStart);
+    pthread_mutex_unlock (&p->xMutex);
+
+    for (i = 0; i < p->iCount; i++) {
+
+      pthread_join (p->xThreads[i].xThread, NULL);
+    }
+    pthread_cond_destroy (&p->xDone);
+    pthread_cond_destroy (&p->xStart);
+    pthread_mutex_destroy (&p->xMutex);
+    free (p->xThreads);
+    free (p);
+  }
+}
+
+// -----------------------------------------------------------------------------
+#endif /* MBPOLL_PTHREAD defined */
+/* ========================================================================== */
@@ -0,0 +1,65 @@
+/* Copyright (c) 2015-2023 Pascal JEAN, All rights reserved.
+ *
+ * mbpoll is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mbpoll is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mbpoll.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MBPOLL_WORKERS_H_
+#define _MBPOLL_WORKERS_H_
+
+/* structures =============================================================== */
+/**
+ * Groupe de threads de travail (opaque)
+ *
+ * Chaque thread possède son propre contexte (par exemple une connexion
+ * modbus), les tâches d'un lot sont distribuées au premier thread libre.
+ */
+typedef struct xWorkerPool xWorkerPool;
+
+/**
+ * Tâche exécutée par un thread de travail
+ *
+ * @param pvWorker contexte propre au thread qui exécute la tâche
+ * @param iIndex index de la tâche dans le lot [0, iJobCount[
+ * @param pvUser paramètre passé à iWorkerPoolRun()
+ */
+typedef void (*vWorkerJob) (void * pvWorker, int iIndex, void * pvUser);
+
+/* internal public functions ================================================ */
+
+/**
+ * Création d'un groupe de threads
+ *
+ * @param iCount nombre de threads
+ * @param ppvWorker tableau de iCount contextes, un par thread
+ * @return le groupe, NULL si erreur
+ */
+xWorkerPool * xWorkerPoolNew (int iCount, void ** ppvWorker);
+
+/**
+ * Exécution d'un lot de tâches
+ *
+ * Les tâches sont distribuées aux threads dans l'ordre croissant des index,
+ * la fonction retourne lorsque toutes les tâches sont terminées.
+ *
+ * @return 0, -1 si erreur
+ */
+int iWorkerPoolRun (xWorkerPool * xPool, int iJobCount, vWorkerJob vJob,
+                    void * pvUser);
+
+/**
+ * Arrêt des threads et libération du groupe
+ */
+void vWorkerPoolDelete (xWorkerPool * xPool);
+
+/* ========================================================================== */
+#endif /* _MBPOLL_WORKERS_H_ */